@@ -0,0 +1,197 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "include/ffmovie/movie.h"
+
+/**
+ * Mixes trackCount WAV tracks with volume ramps through FFAudioMixer and through the plain scalar
+ * loop it replaces, and prints the time per chunk and the real-time factor of both.
+ * Usage: AudioMixerBench [trackCount] [seconds] [workDirectory]
+ */
+
+using namespace ffmovie;
+
+#define SAMPLE_RATE 44100
+#define CHANNELS 2
+#define CHUNK_SAMPLES 1024
+#define TRACK_FILE_COUNT 8
+
+static void WriteLE(FILE* file, uint32_t value, int bytes) {
+  for (int i = 0; i < bytes; i++) {
+    fputc(static_cast<int>((value >> (i * 8)) & 0xFF), file);
+  }
+}
+
+static std::vector<int16_t> MakeTone(int frameCount, double frequency) {
+  std::vector<int16_t> samples(static_cast<size_t>(frameCount) * CHANNELS);
+  for (int i = 0; i < frameCount; i++) {
+    auto value = static_cast<int16_t>(8000 * sin(2 * M_PI * frequency * i / SAMPLE_RATE));
+    for (int channel = 0; channel < CHANNELS; channel++) {
+      samples[i * CHANNELS + channel] = value;
+    }
+  }
+  return samples;
+}
+
+static bool WriteWAV(const std::string& path, const std::vector<int16_t>& samples) {
+  auto file = fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  auto dataSize = static_cast<uint32_t>(samples.size() * sizeof(int16_t));
+  fwrite("RIFF", 1, 4, file);
+  WriteLE(file, 36 + dataSize, 4);
+  fwrite("WAVEfmt ", 1, 8, file);
+  WriteLE(file, 16, 4);
+  WriteLE(file, 1, 2);
+  WriteLE(file, CHANNELS, 2);
+  WriteLE(file, SAMPLE_RATE, 4);
+  WriteLE(file, SAMPLE_RATE * CHANNELS * 2, 4);
+  WriteLE(file, CHANNELS * 2, 2);
+  WriteLE(file, 16, 2);
+  fwrite("data", 1, 4, file);
+  WriteLE(file, dataSize, 4);
+  fwrite(samples.data(), 1, dataSize, file);
+  fclose(file);
+  return true;
+}
+
+/**
+ * A fade in, a dip in the middle and a fade out, so chunks get split at the range boundaries.
+ */
+static std::vector<VolumeRange> MakeVolumeRanges(int64_t duration, int track) {
+  auto offset = track * 10000LL;
+  return {VolumeRange({0, 2000000 + offset}, 0.0f, 1.0f),
+          VolumeRange({duration / 2, duration / 2 + 500000}, 1.0f, 0.3f),
+          VolumeRange({duration / 2 + 500000, duration / 2 + 1000000}, 0.3f, 1.0f),
+          VolumeRange({duration - 2000000 - offset, duration}, 1.0f, 0.0f)};
+}
+
+static float GetVolume(const std::vector<VolumeRange>& ranges, int64_t time) {
+  for (auto& range : ranges) {
+    if (time >= range.timeRange.start && time < range.timeRange.end) {
+      auto progress = static_cast<float>(time - range.timeRange.start) /
+                      static_cast<float>(range.timeRange.end - range.timeRange.start);
+      return range.startVolume + (range.endVolume - range.startVolume) * progress;
+    }
+  }
+  return 1.0f;
+}
+
+/**
+ * The scalar mix of the tracks already in memory, one volume lookup per sample frame.
+ */
+static double MixScalar(const std::vector<std::vector<int16_t>*>& tracks,
+                        const std::vector<std::vector<VolumeRange>>& ranges, int frameCount) {
+  std::vector<float> accumulator(CHUNK_SAMPLES * CHANNELS);
+  std::vector<int16_t> output(CHUNK_SAMPLES * CHANNELS);
+  double checksum = 0;
+  for (int start = 0; start < frameCount; start += CHUNK_SAMPLES) {
+    auto count = std::min(CHUNK_SAMPLES, frameCount - start);
+    std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+    for (size_t track = 0; track < tracks.size(); track++) {
+      auto samples = tracks[track]->data() + static_cast<size_t>(start) * CHANNELS;
+      for (int i = 0; i < count; i++) {
+        auto time = static_cast<int64_t>(start + i) * 1000000 / SAMPLE_RATE;
+        auto volume = GetVolume(ranges[track], time);
+        for (int channel = 0; channel < CHANNELS; channel++) {
+          accumulator[i * CHANNELS + channel] += samples[i * CHANNELS + channel] * volume;
+        }
+      }
+    }
+    for (int i = 0; i < count * CHANNELS; i++) {
+      auto value = std::max(-32768.0f, std::min(32767.0f, accumulator[i]));
+      output[i] = static_cast<int16_t>(value);
+    }
+    checksum += output[0];
+  }
+  return checksum;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+  int trackCount = argc > 1 ? atoi(argv[1]) : 64;
+  int seconds = argc > 2 ? atoi(argv[2]) : 60;
+  std::string directory = argc > 3 ? argv[3] : ".";
+  auto frameCount = seconds * SAMPLE_RATE;
+  auto duration = static_cast<int64_t>(seconds) * 1000000;
+
+  std::vector<std::vector<int16_t>> tones = {};
+  std::vector<std::string> paths = {};
+  for (int i = 0; i < TRACK_FILE_COUNT; i++) {
+    tones.push_back(MakeTone(frameCount, 220.0 * (i + 1)));
+    paths.push_back(directory + "/mixer_bench_" + std::to_string(i) + ".wav");
+    if (!WriteWAV(paths.back(), tones.back())) {
+      printf("Can not write %s\n", paths.back().c_str());
+      return 1;
+    }
+  }
+
+  auto config = std::make_shared<AudioOutputConfig>();
+  config->sampleRate = SAMPLE_RATE;
+  config->channels = CHANNELS;
+  config->outputSamplesCount = CHUNK_SAMPLES;
+  auto mixer = FFAudioMixer::Make(config, AudioSampleFormat::S16);
+  std::vector<std::unique_ptr<FFPCMAudioReader>> readers = {};
+  std::vector<std::vector<int16_t>*> trackSamples = {};
+  std::vector<std::vector<VolumeRange>> trackRanges = {};
+  for (int track = 0; track < trackCount; track++) {
+    auto reader = FFPCMAudioReader::Make(paths[track % TRACK_FILE_COUNT], config);
+    if (reader == nullptr) {
+      printf("Can not open %s\n", paths[track % TRACK_FILE_COUNT].c_str());
+      return 1;
+    }
+    trackRanges.push_back(MakeVolumeRanges(duration, track));
+    trackSamples.push_back(&tones[track % TRACK_FILE_COUNT]);
+    mixer->addTrack(reader.get(), trackRanges.back());
+    readers.push_back(std::move(reader));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int chunkCount = 0;
+  while (!mixer->readNextChunk().empty()) {
+    chunkCount++;
+  }
+  auto mixerTime = Seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  auto checksum = MixScalar(trackSamples, trackRanges, frameCount);
+  auto scalarTime = Seconds(start);
+
+  printf("%d tracks, %d s of %d Hz stereo, %d chunks of %d samples\n", trackCount, seconds,
+         SAMPLE_RATE, chunkCount, CHUNK_SAMPLES);
+  printf("| mixer | us per chunk | x real time |\n");
+  printf("|---|---|---|\n");
+  printf("| FFAudioMixer | %.1f | %.0f |\n", mixerTime * 1e6 / chunkCount, seconds / mixerTime);
+  printf("| scalar loop | %.1f | %.0f |\n", scalarTime * 1e6 / chunkCount, seconds / scalarTime);
+  printf("(checksum %.0f)\n", checksum);
+  for (auto& path : paths) {
+    remove(path.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,261 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libswresample/swresample.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include "audio/process/PolyphaseResampler.h"
+
+/**
+ * Compares PolyphaseResampler at each quality with swresample, for the rate pairs the polyphase
+ * path covers. Speed is measured on stereo float planes in chunks of 1024 samples, quality as the
+ * worst SNR over a few tones, where the noise is whatever is left once the best fitting sine at the
+ * tone frequency is removed from the output.
+ * Usage: ResamplerBench [seconds]
+ */
+
+using namespace ffmovie;
+
+#define CHUNK_SAMPLES 1024
+// Throughput is the fastest of this many rounds, which filters out the other load on the machine.
+#define SPEED_ROUNDS 5
+// Output samples skipped at both ends of the SNR window, so the filter delay does not count.
+#define EDGE_SAMPLES 4096
+
+// Resamples the planes chunk by chunk, appends the output planes to output if it is not nullptr,
+// and returns the number of samples output per channel, or -1 if the resampler is unavailable.
+using ResampleFunction =
+    std::function<int(const std::vector<std::vector<float>>& input, int inputRate, int outputRate,
+                      std::vector<std::vector<float>>* output)>;
+
+static std::vector<std::vector<float>> MakePlanes(int channels, int frameCount, int sampleRate,
+                                                  const std::vector<double>& frequencies) {
+  std::vector<std::vector<float>> planes(channels, std::vector<float>(frameCount));
+  for (int i = 0; i < frameCount; i++) {
+    double value = 0;
+    for (auto frequency : frequencies) {
+      value += sin(2 * M_PI * frequency * i / sampleRate);
+    }
+    value *= 0.5 / frequencies.size();
+    for (auto& plane : planes) {
+      plane[i] = static_cast<float>(value);
+    }
+  }
+  return planes;
+}
+
+static int ResamplePolyphase(const std::vector<std::vector<float>>& input, int inputRate,
+                             int outputRate, std::vector<std::vector<float>>* output,
+                             ResampleQuality quality) {
+  auto channels = static_cast<int>(input.size());
+  auto frameCount = static_cast<int>(input[0].size());
+  auto resampler = PolyphaseResampler::Make(inputRate, outputRate, channels, quality);
+  if (resampler == nullptr) {
+    return -1;
+  }
+  int totalCount = 0;
+  std::vector<std::vector<float>> buffers(
+      channels, std::vector<float>(resampler->maxOutputCount(CHUNK_SAMPLES)));
+  std::vector<const float*> src(channels);
+  std::vector<float*> dst(channels);
+  for (int channel = 0; channel < channels; channel++) {
+    dst[channel] = buffers[channel].data();
+  }
+  auto append = [&](int count) {
+    totalCount += count;
+    if (output != nullptr) {
+      output->resize(channels);
+      for (int channel = 0; channel < channels; channel++) {
+        (*output)[channel].insert((*output)[channel].end(), dst[channel], dst[channel] + count);
+      }
+    }
+  };
+  for (int start = 0; start < frameCount; start += CHUNK_SAMPLES) {
+    auto count = std::min(CHUNK_SAMPLES, frameCount - start);
+    for (int channel = 0; channel < channels; channel++) {
+      src[channel] = input[channel].data() + start;
+    }
+    append(resampler->process(src.data(), count, dst.data()));
+  }
+  append(resampler->flush(dst.data()));
+  return totalCount;
+}
+
+static int ResampleSwr(const std::vector<std::vector<float>>& input, int inputRate,
+                       int outputRate, std::vector<std::vector<float>>* output) {
+  auto channels = static_cast<int>(input.size());
+  auto frameCount = static_cast<int>(input[0].size());
+  auto layout = channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
+  // The same default options AudioFormatConverter falls back to.
+  auto context = swr_alloc_set_opts(nullptr, layout, AV_SAMPLE_FMT_FLTP, outputRate, layout,
+                                    AV_SAMPLE_FMT_FLTP, inputRate, 0, nullptr);
+  if (context == nullptr || swr_init(context) < 0) {
+    swr_free(&context);
+    return -1;
+  }
+  auto capacity = static_cast<int>(
+      av_rescale_rnd(CHUNK_SAMPLES, outputRate, inputRate, AV_ROUND_UP) + 256);
+  int totalCount = 0;
+  std::vector<std::vector<float>> buffers(channels, std::vector<float>(capacity));
+  std::vector<const uint8_t*> src(channels);
+  std::vector<uint8_t*> dst(channels);
+  for (int channel = 0; channel < channels; channel++) {
+    dst[channel] = reinterpret_cast<uint8_t*>(buffers[channel].data());
+  }
+  auto append = [&](int count) {
+    if (count <= 0) {
+      return;
+    }
+    totalCount += count;
+    if (output != nullptr) {
+      output->resize(channels);
+      for (int channel = 0; channel < channels; channel++) {
+        (*output)[channel].insert((*output)[channel].end(), buffers[channel].begin(),
+                                  buffers[channel].begin() + count);
+      }
+    }
+  };
+  for (int start = 0; start < frameCount; start += CHUNK_SAMPLES) {
+    auto count = std::min(CHUNK_SAMPLES, frameCount - start);
+    for (int channel = 0; channel < channels; channel++) {
+      src[channel] = reinterpret_cast<const uint8_t*>(input[channel].data() + start);
+    }
+    append(swr_convert(context, dst.data(), capacity, src.data(), count));
+  }
+  int count = 0;
+  while ((count = swr_convert(context, dst.data(), capacity, nullptr, 0)) > 0) {
+    append(count);
+  }
+  swr_free(&context);
+  return totalCount;
+}
+
+/**
+ * Fits a * sin + b * cos at the frequency to the samples in the least-squares sense and returns
+ * the ratio of the fitted sine to the residual in dB.
+ */
+static double MeasureSNR(const std::vector<float>& samples, double frequency, int sampleRate) {
+  auto end = static_cast<int>(samples.size()) - EDGE_SAMPLES;
+  double ss = 0, sc = 0, cc = 0, ys = 0, yc = 0;
+  for (int i = EDGE_SAMPLES; i < end; i++) {
+    auto s = sin(2 * M_PI * frequency * i / sampleRate);
+    auto c = cos(2 * M_PI * frequency * i / sampleRate);
+    ss += s * s;
+    sc += s * c;
+    cc += c * c;
+    ys += samples[i] * s;
+    yc += samples[i] * c;
+  }
+  auto determinant = ss * cc - sc * sc;
+  auto a = (ys * cc - yc * sc) / determinant;
+  auto b = (yc * ss - ys * sc) / determinant;
+  double signal = 0, noise = 0;
+  for (int i = EDGE_SAMPLES; i < end; i++) {
+    auto fit = a * sin(2 * M_PI * frequency * i / sampleRate) +
+               b * cos(2 * M_PI * frequency * i / sampleRate);
+    signal += fit * fit;
+    noise += (samples[i] - fit) * (samples[i] - fit);
+  }
+  return 10 * log10(signal / std::max(noise, 1e-30));
+}
+
+struct Resampler {
+  const char* name;
+  ResampleFunction resample;
+};
+
+/**
+ * Times the resamplers of a rate pair in rounds, every round running each of them once, so they
+ * all see the same load on the machine. Throughput is the fastest round of each.
+ */
+static void Run(const std::vector<Resampler>& resamplers, int inputRate, int outputRate,
+                int seconds) {
+  auto input = MakePlanes(2, inputRate * seconds, inputRate, {440.0, 3000.0, 9000.0});
+  std::vector<double> times(resamplers.size(), 0.0);
+  std::vector<int> outputCounts(resamplers.size(), 0);
+  for (int round = 0; round < SPEED_ROUNDS; round++) {
+    for (size_t index = 0; index < resamplers.size(); index++) {
+      auto start = std::chrono::steady_clock::now();
+      outputCounts[index] = resamplers[index].resample(input, inputRate, outputRate, nullptr);
+      auto time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      times[index] = round == 0 ? time : std::min(times[index], time);
+    }
+  }
+  for (size_t index = 0; index < resamplers.size(); index++) {
+    auto& resampler = resamplers[index];
+    if (outputCounts[index] <= 0) {
+      printf("| %d -> %d | %s | unavailable | | |\n", inputRate, outputRate, resampler.name);
+      continue;
+    }
+    // In-band tones up to 0.8 of the lower Nyquist frequency.
+    auto maxFrequency = 0.4 * std::min(inputRate, outputRate);
+    auto worstSNR = 1000.0;
+    for (auto frequency : {1000.0, 0.3 * maxFrequency, 0.6 * maxFrequency, maxFrequency}) {
+      auto tone = MakePlanes(1, inputRate * 2, inputRate, {frequency});
+      std::vector<std::vector<float>> toneOutput = {};
+      resampler.resample(tone, inputRate, outputRate, &toneOutput);
+      worstSNR = std::min(worstSNR, MeasureSNR(toneOutput[0], frequency, outputRate));
+    }
+    auto framesPerSecond = inputRate * seconds / times[index];
+    printf("| %d -> %d | %s | %.1f | %.0f | %.1f |\n", inputRate, outputRate, resampler.name,
+           framesPerSecond / 1e6, seconds / times[index], worstSNR);
+  }
+}
+
+int main(int argc, char** argv) {
+  int seconds = argc > 1 ? atoi(argv[1]) : 10;
+  const int ratePairs[][2] = {{44100, 48000}, {48000, 44100}, {22050, 44100}};
+  const struct {
+    const char* name;
+    ResampleQuality quality;
+  } tiers[] = {{"polyphase Low", ResampleQuality::Low},
+               {"polyphase Medium", ResampleQuality::Medium},
+               {"polyphase High", ResampleQuality::High}};
+  printf("%d s of stereo float planes per run, in chunks of %d samples, fastest of %d rounds\n",
+         seconds, CHUNK_SAMPLES, SPEED_ROUNDS);
+  printf("| rates | resampler | M frames/s | x real time | worst SNR (dB) |\n");
+  printf("|---|---|---|---|---|\n");
+  std::vector<Resampler> resamplers = {};
+  for (auto& tier : tiers) {
+    auto quality = tier.quality;
+    resamplers.push_back({tier.name, [quality](const std::vector<std::vector<float>>& input,
+                                               int inputRate, int outputRate,
+                                               std::vector<std::vector<float>>* output) {
+                            return ResamplePolyphase(input, inputRate, outputRate, output,
+                                                     quality);
+                          }});
+  }
+  resamplers.push_back({"swresample", ResampleSwr});
+  for (auto& rates : ratePairs) {
+    Run(resamplers, rates[0], rates[1], seconds);
+  }
+  return 0;
+}
@@ -0,0 +1,189 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavcodec/avcodec.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "include/ffmovie/movie.h"
+
+/**
+ * Encodes the same synthetic clip with FFVideoEncoder at every VideoPreset and with every
+ * VideoRateControl, and prints the encoding speed and the output size of each run as a table.
+ * The presets and CRF only exist in libx264, which scripts/build_ffmpeg_*.sh do not enable, so the
+ * H.264 encoder FFmpeg resolves is printed first.
+ * Usage: VideoEncoderBench [frameCount] [width] [height]
+ */
+
+using namespace ffmovie;
+
+#define FRAME_RATE 30
+#define BENCH_BITRATE 4000000
+#define BENCH_QUALITY 23
+
+/**
+ * A moving gradient with a drifting grid and fixed grain, so the clip has motion, edges and
+ * texture without depending on any media file.
+ */
+static void DrawFrame(int index, int width, int height, std::vector<uint8_t>* pixels) {
+  auto y = pixels->data();
+  auto u = y + width * height;
+  auto v = u + (width / 2) * (height / 2);
+  uint32_t seed = 12345;
+  for (int row = 0; row < height; row++) {
+    for (int column = 0; column < width; column++) {
+      seed = seed * 1664525 + 1013904223;
+      auto grain = static_cast<int>(seed >> 28) - 8;
+      auto grid = ((column + index * 4) / 64 + (row + index * 2) / 64) % 2 == 0 ? 40 : 0;
+      auto value = (column + row + index * 3) % 256 / 2 + grid + grain + 40;
+      y[row * width + column] = static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+    }
+  }
+  for (int row = 0; row < height / 2; row++) {
+    for (int column = 0; column < width / 2; column++) {
+      u[row * (width / 2) + column] = static_cast<uint8_t>(128 + (column + index) % 64 - 32);
+      v[row * (width / 2) + column] = static_cast<uint8_t>(128 + (row - index) % 64 - 32);
+    }
+  }
+}
+
+static const char* GetPresetName(VideoPreset preset) {
+  static const char* names[] = {"UltraFast", "SuperFast", "VeryFast", "Faster",  "Fast",
+                                "Medium",    "Slow",      "Slower",   "VerySlow"};
+  return names[static_cast<int>(preset)];
+}
+
+static std::string GetRateControlName(VideoRateControl rateControl) {
+  switch (rateControl) {
+    case VideoRateControl::CRF:
+      return "CRF " + std::to_string(BENCH_QUALITY);
+    case VideoRateControl::CQP:
+      return "CQP " + std::to_string(BENCH_QUALITY);
+    default:
+      return std::to_string(BENCH_BITRATE / 1000) + " kbps";
+  }
+}
+
+/**
+ * Takes every packet the encoder has ready and returns false on an error.
+ */
+static bool DrainPackets(FFVideoEncoder* encoder, bool endOfStream, int64_t* byteCount) {
+  while (true) {
+    void* packet = nullptr;
+    auto result = encoder->onEncodeData(&packet);
+    if (result == CodingResult::CodingSuccess) {
+      *byteCount += static_cast<AVPacket*>(packet)->size;
+      continue;
+    }
+    if (result == CodingResult::TryAgainLater && endOfStream) {
+      continue;
+    }
+    return result != CodingResult::CodingError;
+  }
+}
+
+static void Run(const VideoExportConfig& config, int frameCount) {
+  auto encoder = FFVideoEncoder::Make(config);
+  if (!encoder->initEncoder()) {
+    std::vector<std::string> messages = {};
+    encoder->collectErrorMsgs(&messages);
+    printf("| %s | %s | failed: %s | | |\n", GetPresetName(config.preset),
+           GetRateControlName(config.rateControl).c_str(),
+           messages.empty() ? "" : messages.back().c_str());
+    return;
+  }
+  std::vector<uint8_t> pixels(config.width * config.height * 3 / 2);
+  VideoFramePixels frame = {};
+  frame.format = VideoPixelFormat::I420;
+  frame.width = config.width;
+  frame.height = config.height;
+  frame.planes[0] = pixels.data();
+  frame.planes[1] = pixels.data() + config.width * config.height;
+  frame.planes[2] = frame.planes[1] + (config.width / 2) * (config.height / 2);
+  frame.rowBytes[0] = config.width;
+  frame.rowBytes[1] = config.width / 2;
+  frame.rowBytes[2] = config.width / 2;
+  int64_t byteCount = 0;
+  double encodeTime = 0;
+  bool succeeded = true;
+  for (int i = 0; i < frameCount && succeeded; i++) {
+    // Drawing is left out of the time.
+    DrawFrame(i, config.width, config.height, &pixels);
+    auto start = std::chrono::steady_clock::now();
+    succeeded = encoder->onSendData(frame, i) != CodingResult::CodingError &&
+                DrainPackets(encoder.get(), false, &byteCount);
+    encodeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+  auto start = std::chrono::steady_clock::now();
+  succeeded = succeeded && encoder->onEndOfStream() != CodingResult::CodingError &&
+              DrainPackets(encoder.get(), true, &byteCount);
+  encodeTime += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  if (!succeeded) {
+    printf("| %s | %s | encoding failed | | |\n", GetPresetName(config.preset),
+           GetRateControlName(config.rateControl).c_str());
+    return;
+  }
+  auto kilobitsPerSecond = byteCount * 8.0 * FRAME_RATE / frameCount / 1000;
+  printf("| %s | %s | %.1f | %.0f | %.0f |\n", GetPresetName(config.preset),
+         GetRateControlName(config.rateControl).c_str(), frameCount / encodeTime,
+         byteCount / 1024.0, kilobitsPerSecond);
+}
+
+int main(int argc, char** argv) {
+  VideoExportConfig config = {};
+  int frameCount = argc > 1 ? atoi(argv[1]) : 300;
+  config.width = argc > 2 ? atoi(argv[2]) : 1280;
+  config.height = argc > 3 ? atoi(argv[3]) : 720;
+  config.frameRate = FRAME_RATE;
+  config.videoBitrate = BENCH_BITRATE;
+  config.quality = BENCH_QUALITY;
+  config.profile = VideoProfile::High;
+  auto codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+  auto encoderName = codec != nullptr ? codec->name : "none";
+  printf("%d frames of %dx%d at %d fps, high profile, H.264 encoder: %s\n", frameCount,
+         config.width, config.height, FRAME_RATE, encoderName);
+  if (strcmp(encoderName, "libx264") != 0) {
+    printf("The presets only apply to libx264, expect the same row for each of them.\n");
+  }
+  printf("| preset | rate control | encode fps | size (KiB) | kbps |\n");
+  printf("|---|---|---|---|---|\n");
+  for (int preset = 0; preset <= static_cast<int>(VideoPreset::VerySlow); preset++) {
+    config.preset = static_cast<VideoPreset>(preset);
+    config.rateControl = VideoRateControl::CRF;
+    Run(config, frameCount);
+  }
+  config.preset = VideoPreset::Medium;
+  for (auto rateControl : {VideoRateControl::Bitrate, VideoRateControl::CQP}) {
+    config.rateControl = rateControl;
+    Run(config, frameCount);
+  }
+  return 0;
+}
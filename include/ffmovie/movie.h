@@ -17,8 +17,10 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #pragma once
-#include <unordered_map>
+#include <atomic>
 #include <functional>
+#include <future>
+#include <unordered_map>
 #include "pag/decoder.h"
 
 #if defined(_WIN32)
@@ -67,6 +69,44 @@ struct FFMOVIE_API TimeRange {
   }
 };
 
+/**
+ * A volume that changes linearly from startVolume to endVolume over the time range.
+ */
+struct FFMOVIE_API VolumeRange {
+  VolumeRange() = default;
+
+  VolumeRange(const TimeRange timeRange, float startVolume, float endVolume)
+      : timeRange(timeRange), startVolume(startVolume), endVolume(endVolume) {
+  }
+
+  TimeRange timeRange{-1, -1};
+  float startVolume = 1.0f;
+  float endVolume = 1.0f;
+};
+
+/**
+ * A token to cancel asynchronous operations, such as the MakeAsync() factories. Cancelling aborts
+ * the pending I/O of an operation that is running and skips one that has not started yet, in both
+ * cases the operation returns nullptr.
+ */
+class FFMOVIE_API CancelToken {
+ public:
+  static std::shared_ptr<CancelToken> Make() {
+    return std::make_shared<CancelToken>();
+  }
+
+  void cancel() {
+    cancelled = true;
+  }
+
+  bool isCancelled() const {
+    return cancelled;
+  }
+
+ private:
+  std::atomic<bool> cancelled{false};
+};
+
 /**
  * A container for data of bytes.
  */
@@ -133,6 +173,60 @@ class FFMOVIE_API ByteData {
   const std::function<void(uint8_t*)> _releaseCallback;
 };
 
+/**
+ * A decoded video frame in I420 format that owns its pixels.
+ */
+class FFMOVIE_API VideoFrame {
+ public:
+  /**
+   * Creates a VideoFrame with uninitialized pixels of the specified size.
+   */
+  static std::shared_ptr<VideoFrame> Make(int width, int height);
+
+  /**
+   * The presentation time of the frame, in microseconds.
+   */
+  int64_t timestamp = -1;
+  int width = 0;
+  int height = 0;
+  /**
+   * The Y, U and V planes, which point into the pixels owned by this frame.
+   */
+  pag::YUVBuffer buffer = {};
+
+  /**
+   * Returns the byte size of all the planes.
+   */
+  size_t byteSize() const {
+    return pixels ? pixels->length() : 0;
+  }
+
+ private:
+  std::unique_ptr<ByteData> pixels = nullptr;
+};
+
+enum class FFMOVIE_API AudioSampleFormat {
+  /**
+   * Interleaved signed 16-bit samples.
+   */
+  S16,
+  /**
+   * Interleaved 32-bit float samples in [-1, 1].
+   */
+  F32,
+};
+
+/**
+ * The quality of sample-rate conversion. Low and Medium resample with swresample, which is as fast
+ * as the built-in polyphase resampler at those tiers and cleaner. High uses the built-in resampler
+ * with 64-tap filters, which is about 10 dB cleaner than swresample at half of its speed.
+ */
+enum class FFMOVIE_API ResampleQuality {
+  Low,
+  Medium,
+  High,
+};
+
 struct FFMOVIE_API AudioOutputConfig {
   // 采样率，默认 44.1kHZ
   int sampleRate = 44100;
@@ -140,6 +234,8 @@ struct FFMOVIE_API AudioOutputConfig {
   int outputSamplesCount = 1024;
   // 双声道
   int channels = 2;
+  // 采样率转换的质量
+  ResampleQuality resampleQuality = ResampleQuality::Medium;
 };
 
 enum class FFMOVIE_API NALUType {
@@ -149,6 +245,50 @@ enum class FFMOVIE_API NALUType {
 
 enum class FFMOVIE_API VideoProfile { BASELINE = 0, High };
 
+/**
+ * The speed presets of x264, each one is slower than the previous one and gives a smaller file at
+ * the same quality.
+ */
+enum class FFMOVIE_API VideoPreset {
+  UltraFast,
+  SuperFast,
+  VeryFast,
+  Faster,
+  Fast,
+  Medium,
+  Slow,
+  Slower,
+  VerySlow,
+};
+
+/**
+ * The x264 tunings for the kind of content being encoded.
+ */
+enum class FFMOVIE_API VideoTune {
+  None,
+  Film,
+  Animation,
+  Grain,
+  StillImage,
+  FastDecode,
+  ZeroLatency,
+};
+
+enum class FFMOVIE_API VideoRateControl {
+  /**
+   * Average bitrate, targets videoBitrate.
+   */
+  Bitrate,
+  /**
+   * Constant rate factor, a constant perceived quality given by quality.
+   */
+  CRF,
+  /**
+   * Constant quantizer given by quality.
+   */
+  CQP,
+};
+
 struct FFMOVIE_API VideoExportConfig {
 
   int width = 1280;
@@ -156,12 +296,37 @@ struct FFMOVIE_API VideoExportConfig {
   int frameRate = 30;
   int videoBitrate = 8000000;
   VideoProfile profile = VideoProfile::BASELINE;
+  // 编码速度预设，只对 libx264 生效，预览导出可以用 UltraFast。scripts 下的 FFmpeg 编译脚本没有启用
+  // libx264，需要自行链接
+  VideoPreset preset = VideoPreset::Medium;
+  // 只对 libx264 生效
+  VideoTune tune = VideoTune::None;
+  VideoRateControl rateControl = VideoRateControl::Bitrate;
+  // CRF 或 CQP 的值，越小质量越高，H.264 的范围是 0~51
+  int quality = 23;
+  // VBV 的最大码率(bps)和缓冲区大小(bits)，0 表示不限制
+  int maxBitrate = 0;
+  int bufferSize = 0;
+  // 关键帧间隔，单位是帧
+  int gopSize = 120;
+  // BASELINE 不支持 B 帧，会被忽略
+  int maxBFrames = 0;
+  // 码率控制的前瞻帧数，-1 表示用编码器的默认值
+  int lookaheadFrames = -1;
+  // 编码线程数，0 表示由编码器决定
+  int threadCount = 5;
+  // 实时导出的目标帧率，编码跟不上时自动提高量化参数或降低码率，以画质换取有限的速度。只调码率
+  // 控制，不调 subme、rc-lookahead 等分析参数，所以不保证能达到该帧率。0 表示不启用
+  float targetFrameRate = 0;
 };
 
 struct FFMOVIE_API AudioExportConfig {
   int sampleRate = 44100;
   int channels = 2;
   int audioBitrate = 128000;
+  // 把音频切成多段，在多个编码器上并行编码，适合长音频导出。编码器不支持该采样率、需要重采样时，
+  // 退回单个编码器顺序编码
+  bool parallelEncoding = false;
 };
 
 #define KEY_MIME "mime"
@@ -265,11 +430,40 @@ class FFMOVIE_API FFAudioDemuxer : public FFMediaDemuxer {
  public:
   static std::unique_ptr<FFAudioDemuxer> Make(const std::string& path);
   static std::unique_ptr<FFAudioDemuxer> Make(uint8_t* data, size_t length);
+  /**
+   * Runs Make() on the shared executor of the library, so opening many files overlaps the probing
+   * and stream-info analysis of all of them.
+   */
+  static std::future<std::unique_ptr<FFAudioDemuxer>> MakeAsync(
+      const std::string& path, std::shared_ptr<CancelToken> cancelToken = nullptr);
+  /**
+   * Runs Make() on the shared executor of the library. The data must stay valid until the
+   * returned demuxer is released.
+   */
+  static std::future<std::unique_ptr<FFAudioDemuxer>> MakeAsync(
+      uint8_t* data, size_t length, std::shared_ptr<CancelToken> cancelToken = nullptr);
+
+  /**
+   * Starts building a seek index in the background if the input is a raw MP3 or ADTS AAC stream,
+   * which FFmpeg can only seek by estimating from the bitrate. Seeks use the part of the index that
+   * is ready, so they land on exact frames and take O(log n) once the index is complete. Returns
+   * false if the input is not such a stream.
+   * @param indexPath The file to load the index from and to save it to, for example next to the
+   * audio file, or empty to keep the index in memory only.
+   */
+  virtual bool startIndexing(const std::string& indexPath) = 0;
 };
 
 class FFMOVIE_API FFVideoDemuxer : public FFMediaDemuxer {
  public:
   static std::unique_ptr<FFVideoDemuxer> Make(const std::string& path, NALUType startCodeType);
+  /**
+   * Runs Make() on the shared executor of the library, so opening many files overlaps the probing
+   * and stream-info analysis of all of them.
+   */
+  static std::future<std::unique_ptr<FFVideoDemuxer>> MakeAsync(
+      const std::string& path, NALUType startCodeType,
+      std::shared_ptr<CancelToken> cancelToken = nullptr);
 
   virtual int64_t getSampleTimeAt(int64_t targetTime) = 0;
 
@@ -278,6 +472,161 @@ class FFMOVIE_API FFVideoDemuxer : public FFMediaDemuxer {
   virtual void reset() = 0;
 };
 
+/**
+ * FFFrameExtractor decodes many frames of one video in a single pass. The requested timestamps are
+ * grouped by GOP, each GOP is sought once and decoded forward, and every frame is emitted as soon
+ * as the decoder passes it.
+ */
+class FFMOVIE_API FFFrameExtractor {
+ public:
+  /**
+   * Called with each requested timestamp and the frame displayed at that time. The frame is nullptr
+   * if the timestamp is out of the video range or the frame could not be decoded. Calls are
+   * serialized, but may come from worker threads.
+   */
+  using FrameCallback = std::function<void(int64_t timestamp, std::shared_ptr<VideoFrame> frame)>;
+
+  static std::unique_ptr<FFFrameExtractor> Make(const std::string& path);
+
+  virtual ~FFFrameExtractor() = default;
+
+  /**
+   * Extracts the frames at the given timestamps in microseconds, which may be unsorted and contain
+   * duplicates. The GOP groups are spread across threadCount worker threads, each of which opens
+   * its own demuxer and decoder. Returns false if any GOP failed to decode.
+   */
+  virtual bool extract(const std::vector<int64_t>& timestamps, const FrameCallback& callback,
+                       int threadCount = 1) = 0;
+};
+
+/**
+ * FFReverseVideoReader serves frames for backward playback and scrubbing. Instead of a seek and a
+ * decode per frame, it decodes a whole GOP forward into a frame cache, returns it in any order, and
+ * prefetches the previous GOP on a background thread.
+ */
+class FFMOVIE_API FFReverseVideoReader {
+ public:
+  /**
+   * Creates a reader for the video at the path.
+   * @param maxCacheBytes The memory cap of the cached frames, shared by the current GOP and the
+   * prefetched one. GOPs that do not fit are split into segments at checkpoints counted from the
+   * keyframe, and each segment is decoded from the keyframe on its own.
+   */
+  static std::unique_ptr<FFReverseVideoReader> Make(const std::string& path,
+                                                    size_t maxCacheBytes = 256 * 1024 * 1024);
+
+  virtual ~FFReverseVideoReader() = default;
+
+  /**
+   * Returns the frame displayed at targetTime in microseconds, or nullptr if targetTime is out of
+   * the video range or the frame could not be decoded. The returned frame stays valid as long as it
+   * is held.
+   */
+  virtual std::shared_ptr<VideoFrame> readFrameAt(int64_t targetTime) = 0;
+};
+
+/**
+ * FFLoopVideoReader plays a video in a seamless loop. The first frames of the video are decoded
+ * once and kept, and a second decoder is kept primed right after them, so wrapping around to the
+ * start serves cached frames and continues decoding without a seek.
+ */
+class FFMOVIE_API FFLoopVideoReader {
+ public:
+  /**
+   * Creates a loop reader for the video at the path.
+   * @param maxHeadBytes The memory cap of the frames kept from the start of the video, which are at
+   * most the frames of the first GOP.
+   */
+  static std::unique_ptr<FFLoopVideoReader> Make(const std::string& path,
+                                                 size_t maxHeadBytes = 64 * 1024 * 1024);
+
+  virtual ~FFLoopVideoReader() = default;
+
+  /**
+   * Returns the duration of one loop in microseconds.
+   */
+  virtual int64_t duration() const = 0;
+
+  /**
+   * Returns the frame displayed at targetTime in microseconds on the looped timeline, where
+   * targetTime may exceed the duration of the video. Returns nullptr if the frame could not be
+   * decoded.
+   */
+  virtual std::shared_ptr<VideoFrame> readFrameAt(int64_t targetTime) = 0;
+};
+
+/**
+ * A clip on a sequence timeline.
+ */
+struct FFMOVIE_API VideoClip {
+  std::string path;
+  /**
+   * The range of the source video to play, in microseconds.
+   */
+  TimeRange sourceRange = {0, 0};
+};
+
+/**
+ * FFVideoSequencePlayer plays an ordered list of clips back to back. A configurable lead time
+ * before each cut, the next clip is opened, sought to its in point and its first frame decoded on a
+ * background thread, so the cut costs no extra latency.
+ */
+class FFMOVIE_API FFVideoSequencePlayer {
+ public:
+  /**
+   * Creates a player for the clips, which are placed back to back on the timeline.
+   * @param leadTime How long before a cut the next clip starts to be prepared, in microseconds.
+   */
+  static std::unique_ptr<FFVideoSequencePlayer> Make(std::vector<VideoClip> clips,
+                                                     int64_t leadTime = 1000000);
+
+  virtual ~FFVideoSequencePlayer() = default;
+
+  /**
+   * Returns the total duration of all the clips in microseconds.
+   */
+  virtual int64_t duration() const = 0;
+
+  /**
+   * Returns the frame displayed at timelineTime in microseconds, or nullptr if timelineTime is out
+   * of the timeline or the frame could not be decoded.
+   */
+  virtual std::shared_ptr<VideoFrame> readFrameAt(int64_t timelineTime) = 0;
+};
+
+/**
+ * FFTimeRemapVideoReader serves frames for remapped time, such as speed ramps, freeze frames and
+ * ping-pong, where the source times are not monotonic or not uniform. Given the source times of an
+ * upcoming window, it decodes the frames of each GOP in one forward pass, keeps the frames that
+ * are requested again, and prefetches ahead of the playhead on a background thread.
+ */
+class FFMOVIE_API FFTimeRemapVideoReader {
+ public:
+  /**
+   * Creates a reader for the video at the path. The cache holds at most maxCacheFrames frames and
+   * at most maxCacheBytes bytes of pixels, whichever is smaller.
+   */
+  static std::unique_ptr<FFTimeRemapVideoReader> Make(const std::string& path,
+                                                      int maxCacheFrames = 30,
+                                                      size_t maxCacheBytes = 128 * 1024 * 1024);
+
+  virtual ~FFTimeRemapVideoReader() = default;
+
+  /**
+   * Sets the source times in microseconds that are going to be requested next, in request order,
+   * for example the time-map curve sampled at every output frame of the upcoming window. The
+   * previous window is discarded.
+   */
+  virtual void setTimeMap(const std::vector<int64_t>& sourceTimes) = 0;
+
+  /**
+   * Returns the frame displayed at sourceTime in microseconds, or nullptr if sourceTime is out of
+   * the video range or the frame could not be decoded. Requests do not have to follow the time map,
+   * but only those that do benefit from the cache and the prefetching.
+   */
+  virtual std::shared_ptr<VideoFrame> readFrameAt(int64_t sourceTime) = 0;
+};
+
 class FFMOVIE_API FFMediaDecoder {
  public:
   static std::vector<std::string> SupportDecoders();
@@ -297,8 +646,374 @@ class FFMOVIE_API FFAudioDecoder : public FFMediaDecoder {
  public:
   static std::unique_ptr<FFAudioDecoder> Make(FFMediaDemuxer* demuxer,
                                               std::shared_ptr<AudioOutputConfig> config);
+  /**
+   * Runs Make() on the shared executor of the library. The demuxer must not be used by anyone
+   * else until the returned future is ready.
+   */
+  static std::future<std::unique_ptr<FFAudioDecoder>> MakeAsync(
+      FFMediaDemuxer* demuxer, std::shared_ptr<AudioOutputConfig> config,
+      std::shared_ptr<CancelToken> cancelToken = nullptr);
   virtual SampleData onRenderFrame() = 0;
   virtual int64_t currentPresentationTime() = 0;
+  /**
+   * Seeks the demuxer passed to Make() and the decoder so that the next rendered chunk starts
+   * exactly at targetTime in microseconds. The demuxer is sought early enough for the codec to
+   * pre-roll, and the samples before targetTime are decoded and discarded. Afterwards, keep feeding
+   * the samples of the demuxer from its current position as usual.
+   */
+  virtual bool seekTo(int64_t targetTime) = 0;
+  /**
+   * Feeds the samples of the demuxer passed to Make() to the decoder until the next chunk is
+   * decoded, and returns it like onRenderFrame() does. Every chunk holds outputSamplesCount
+   * samples except the last one, whose length only covers the samples left at the end of stream.
+   * Returns an empty SampleData after it. Use it instead of driving the demuxer and the decoder by
+   * hand.
+   */
+  virtual SampleData readNextChunk() = 0;
+  /**
+   * Returns true if the last empty SampleData of readNextChunk() was the end of stream, false if it
+   * stopped on a decoding error.
+   */
+  virtual bool reachedEndOfStream() const = 0;
+  /**
+   * Decodes the samples in [startTime, endTime) in microseconds into one contiguous buffer of
+   * interleaved samples in the format, feeding the demuxer passed to Make() internally. The size
+   * of the buffer is computed up front from the output config, and the part after the end of
+   * stream is silent. If mappedFilePath is not empty, the buffer is a memory mapping of a file
+   * created at that path, so ranges larger than the memory can be decoded. Call seekTo() before
+   * reading chunks again. Returns nullptr if the range is empty or the seek fails.
+   */
+  virtual std::unique_ptr<ByteData> decodeRange(int64_t startTime, int64_t endTime,
+                                                AudioSampleFormat format = AudioSampleFormat::S16,
+                                                const std::string& mappedFilePath = "") = 0;
+};
+
+/**
+ * FFPCMAudioReader reads uncompressed WAV files without going through the demuxer and the decoder.
+ * The data chunk is memory mapped and served in chunks of exactly outputSamplesCount samples,
+ * converting only if the format of the file differs from the output, and seeking is O(1).
+ */
+class FFMOVIE_API FFPCMAudioReader {
+ public:
+  /**
+   * Returns nullptr if the file at the path is not a WAV file of 8, 16, 24 or 32-bit integer or
+   * 32-bit float PCM, or has more than two channels in any layout other than 5.1, use
+   * FFAudioDemuxer and FFAudioDecoder for it instead. 5.1 files are downmixed with the center and
+   * surround channels at -3dB.
+   */
+  static std::unique_ptr<FFPCMAudioReader> Make(const std::string& path,
+                                                std::shared_ptr<AudioOutputConfig> config);
+
+  virtual ~FFPCMAudioReader() = default;
+
+  /**
+   * Returns the duration of the audio in microseconds.
+   */
+  virtual int64_t duration() const = 0;
+
+  /**
+   * Moves to the sample at targetTime in microseconds.
+   */
+  virtual bool seekTo(int64_t targetTime) = 0;
+
+  /**
+   * Returns the next outputSamplesCount samples in the output format, or an empty SampleData at
+   * the end. The last chunk is padded with silence. The data stays valid until the next call.
+   */
+  virtual SampleData readNextChunk() = 0;
+
+  /**
+   * Returns the time in microseconds of the chunk returned by the last readNextChunk().
+   */
+  virtual int64_t currentPresentationTime() = 0;
+};
+
+/**
+ * The minimum, the maximum and the RMS of the samples of all the channels in a waveform bucket.
+ */
+struct FFMOVIE_API AudioPeak {
+  int16_t min = 0;
+  int16_t max = 0;
+  int16_t rms = 0;
+};
+
+/**
+ * FFAudioPeaks holds the waveform of an audio file at several zoom levels for drawing it. Level 0
+ * has samplesPerBucket(0) samples per channel in each bucket, and every next level is 4 times
+ * coarser.
+ */
+class FFMOVIE_API FFAudioPeaks {
+ public:
+  /**
+   * Decodes the first audio track of the file at path and reduces it to peaks in a streaming
+   * loop, the PCM of the whole file is never kept. If the input seeks exactly, that is it is a
+   * container or a raw MP3 or ADTS stream whose index was saved to indexPath by
+   * FFAudioDemuxer::startIndexing(), segments of the file are decoded in parallel on the shared
+   * executor. Returns nullptr if the file can not be decoded.
+   */
+  static std::shared_ptr<FFAudioPeaks> Make(const std::string& path, int samplesPerBucket = 256,
+                                            int levelCount = 4,
+                                            const std::string& indexPath = "");
+
+  /**
+   * Loads the peaks saved by save() for the audio file at path. Returns nullptr if the file is not
+   * a valid peak file, or if the size or the modification time of the audio file changed since the
+   * peaks were made.
+   */
+  static std::shared_ptr<FFAudioPeaks> Load(const std::string& peakPath, const std::string& path);
+
+  /**
+   * Writes the peaks to a compact binary file, so they are computed only once per asset. The size
+   * and the modification time of the audio file are saved with them.
+   */
+  bool save(const std::string& peakPath) const;
+
+  int sampleRate() const {
+    return _sampleRate;
+  }
+
+  /**
+   * Returns the number of samples per channel of the audio.
+   */
+  int64_t sampleCount() const {
+    return _sampleCount;
+  }
+
+  int levelCount() const {
+    return static_cast<int>(levels.size());
+  }
+
+  int samplesPerBucket(int level) const;
+
+  /**
+   * Returns the buckets of the level, the last one may cover fewer samples.
+   */
+  const std::vector<AudioPeak>& peaks(int level) const {
+    return levels[level];
+  }
+
+ private:
+  int _sampleRate = 0;
+  int64_t _sampleCount = 0;
+  int baseSamplesPerBucket = 0;
+  // The size and the modification time of the audio file when the peaks were made.
+  int64_t sourceSize = 0;
+  int64_t sourceModifiedTime = 0;
+  std::vector<std::vector<AudioPeak>> levels = {};
+
+  FFAudioPeaks() = default;
+  void buildLevels(int levelCount);
+};
+
+/**
+ * FFAudioLoudness measures the loudness of an audio file as EBU R128 does, so tracks can be
+ * normalized to a target loudness before export. The file is decoded once, and the K-weighting
+ * filters and the true peak interpolator run on the decoded chunks as they stream by. Layouts with
+ * more than two channels are measured on the stereo downmix of the decoder.
+ */
+class FFMOVIE_API FFAudioLoudness {
+ public:
+  /**
+   * Measures the first audio track of the file at path. If cachePath is not empty, the result
+   * saved there by an earlier call for the same file is returned instead of decoding, and a new
+   * result is saved there once the whole file was decoded. Returns nullptr if the file can not be
+   * decoded.
+   */
+  static std::shared_ptr<FFAudioLoudness> Make(const std::string& path,
+                                               const std::string& cachePath = "");
+
+  /**
+   * Measures several files in parallel on the shared executor, the results are in the order of
+   * paths. cachePaths is either empty or has one path per file, which may be empty.
+   */
+  static std::vector<std::shared_ptr<FFAudioLoudness>> Make(
+      const std::vector<std::string>& paths, const std::vector<std::string>& cachePaths = {});
+
+  /**
+   * Loads the result saved by save() for the audio file at path. Returns nullptr if the file is not
+   * a valid loudness file, or if the size or the modification time of the audio file changed since
+   * it was measured.
+   */
+  static std::shared_ptr<FFAudioLoudness> Load(const std::string& loudnessPath,
+                                               const std::string& path);
+
+  /**
+   * Writes the result with the size and the modification time of the measured audio file.
+   */
+  bool save(const std::string& loudnessPath) const;
+
+  /**
+   * Returns the gated loudness of the whole file in LUFS, or -HUGE_VAL if the file is silent.
+   */
+  double integratedLoudness() const {
+    return _integratedLoudness;
+  }
+
+  /**
+   * Returns the loudness in LUFS of every 3 seconds window, one every 100 milliseconds. The first
+   * window ends at 3 seconds, so it is empty for shorter files.
+   */
+  const std::vector<float>& shortTermLoudness() const {
+    return _shortTermLoudness;
+  }
+
+  /**
+   * Returns the maximum short-term loudness in LUFS, or -HUGE_VAL if there is none.
+   */
+  double maxShortTermLoudness() const;
+
+  /**
+   * Returns the true peak in dBTP.
+   */
+  double truePeak() const {
+    return _truePeak;
+  }
+
+  /**
+   * Returns the gain in dB that brings the integrated loudness to targetLoudness, lowered if needed
+   * so the true peak stays under maxTruePeak. Returns 0 for silent files.
+   */
+  double gainToTarget(double targetLoudness, double maxTruePeak = -1.0) const;
+
+ private:
+  double _integratedLoudness = 0;
+  double _truePeak = 0;
+  // The size and the modification time of the audio file when it was measured.
+  int64_t sourceSize = 0;
+  int64_t sourceModifiedTime = 0;
+  std::vector<float> _shortTermLoudness = {};
+
+  FFAudioLoudness() = default;
+};
+
+/**
+ * FFAudioRenderQueue decodes ahead of an audio output callback. A worker thread fills a lock-free
+ * ring of chunks from the decoder, so the real-time thread never waits on I/O or codec work.
+ */
+class FFMOVIE_API FFAudioRenderQueue {
+ public:
+  /**
+   * Starts decoding on a worker thread. The decoder must have been created with the same config,
+   * must outlive the queue and must not be used by anyone else until the queue is released.
+   * @param chunkCount The number of chunks of outputSamplesCount samples decoded ahead.
+   */
+  static std::unique_ptr<FFAudioRenderQueue> Make(FFAudioDecoder* decoder,
+                                                  std::shared_ptr<AudioOutputConfig> config,
+                                                  int chunkCount = 8);
+
+  virtual ~FFAudioRenderQueue() = default;
+
+  /**
+   * Copies frameCount samples per channel of the output format into output, without locking or
+   * allocating, so it can be called from the real-time audio thread. Missing samples are filled
+   * with silence, which counts as an underrun unless the queue is still filling after Make() or
+   * seekTo(), or the end of stream is reached. Returns the number of decoded samples copied.
+   */
+  virtual int read(void* output, int frameCount) = 0;
+
+  /**
+   * Drops the queued chunks and seeks the decoder to targetTime in microseconds on the worker
+   * thread. Must not be called from the real-time thread.
+   */
+  virtual void seekTo(int64_t targetTime) = 0;
+
+  /**
+   * Returns the time in microseconds of the next sample read() outputs.
+   */
+  virtual int64_t currentPresentationTime() = 0;
+
+  /**
+   * Returns the number of read() calls that ran out of decoded samples.
+   */
+  virtual int64_t underrunCount() = 0;
+
+  /**
+   * Returns true once read() has output all the samples before the end of stream.
+   */
+  virtual bool isEnded() = 0;
+};
+
+/**
+ * FFAudioCache keeps the decoded PCM of audio files on disk, so the same music beds and sound
+ * effects are decoded only once across render jobs. The cached files are keyed by the size and a
+ * hash of sampled blocks of the content of the audio file and by the output config, and served by
+ * FFPCMAudioReader.
+ */
+class FFMOVIE_API FFAudioCache {
+ public:
+  /**
+   * Creates a cache that stores its files in the directory, which must exist. Once the files take
+   * more than maxSize bytes, the least recently used ones are deleted. A cache can be used by many
+   * threads, but only one cache should use a directory at a time.
+   */
+  static std::shared_ptr<FFAudioCache> Make(const std::string& directory, int64_t maxSize);
+
+  virtual ~FFAudioCache() = default;
+
+  /**
+   * Returns a reader of the audio file at path in the sample rate and the channels of the config.
+   * The first call for a file and a config decodes the whole file with FFAudioDecoder into the
+   * cache, later calls memory map the cached file. Returns nullptr if the file can not be decoded.
+   */
+  virtual std::unique_ptr<FFPCMAudioReader> open(const std::string& path,
+                                                 std::shared_ptr<AudioOutputConfig> config) = 0;
+
+  /**
+   * Returns the total size in bytes of the cached files.
+   */
+  virtual int64_t size() = 0;
+
+  /**
+   * Deletes all the cached files. Readers already returned keep working on POSIX systems.
+   */
+  virtual void clear() = 0;
+};
+
+/**
+ * FFAudioMixer mixes the chunks of many audio tracks into one, applying the volume ramps of each
+ * track. Tracks are summed into a float accumulator with SIMD kernels and the output is saturated,
+ * nothing is allocated per chunk.
+ */
+class FFMOVIE_API FFAudioMixer {
+ public:
+  /**
+   * Creates a mixer that outputs chunks with the sample rate, the channels and the size of the
+   * config, in the outputFormat. The tracks must be decoded with the same config.
+   */
+  static std::unique_ptr<FFAudioMixer> Make(
+      std::shared_ptr<AudioOutputConfig> config,
+      AudioSampleFormat outputFormat = AudioSampleFormat::S16);
+
+  virtual ~FFAudioMixer() = default;
+
+  /**
+   * Adds a track that pulls its chunks from the decoder, which must outlive the track. Returns
+   * the ID of the track.
+   * @param volumeRanges The volume ramps of the track, on the time of its own chunks. They must not
+   * overlap, and the volume is 1 outside of them.
+   */
+  virtual int addTrack(FFAudioDecoder* decoder, std::vector<VolumeRange> volumeRanges = {}) = 0;
+
+  /**
+   * Adds a track that pulls its chunks from the reader, which must outlive the track.
+   */
+  virtual int addTrack(FFPCMAudioReader* reader, std::vector<VolumeRange> volumeRanges = {}) = 0;
+
+  virtual void removeTrack(int trackID) = 0;
+
+  virtual void setVolumeRanges(int trackID, std::vector<VolumeRange> volumeRanges) = 0;
+
+  /**
+   * Mixes the next chunk of every track, tracks that ended are silent. Returns an empty SampleData
+   * once all the tracks ended. The data stays valid until the next call.
+   */
+  virtual SampleData readNextChunk() = 0;
+
+  /**
+   * Returns the time in microseconds of the chunk returned by the last readNextChunk(), which is
+   * the earliest chunk time of the mixed tracks.
+   */
+  virtual int64_t currentPresentationTime() = 0;
 };
 
 enum class FFMOVIE_API CodingResult {
@@ -349,11 +1064,162 @@ class FFMOVIE_API FFAudioEncoder : public FFEncoder {
   virtual CodingResult onSendData(uint8_t* data, int64_t length, int sampleCount) = 0;
 };
 
+/**
+ * The layouts of the frames the video encoder takes.
+ */
+enum class FFMOVIE_API VideoPixelFormat {
+  /**
+   * The Y, U and V planes, the chroma planes subsampled by 2 in both directions. The encoder takes
+   * it without any conversion.
+   */
+  I420,
+  /**
+   * The Y plane and one interleaved UV plane, subsampled like I420.
+   */
+  NV12,
+  /**
+   * One plane of 4 bytes per pixel in R, G, B, A memory order.
+   */
+  RGBA,
+  /**
+   * One plane of 4 bytes per pixel in B, G, R, A memory order.
+   */
+  BGRA,
+};
+
+/**
+ * A pooled frame of the video encoder that the caller renders into, handed out by
+ * FFVideoEncoder::dequeueInputBuffer().
+ */
+struct FFMOVIE_API VideoInputBuffer {
+  /**
+   * Identifies the buffer to the encoder.
+   */
+  int index = -1;
+  VideoPixelFormat format = VideoPixelFormat::I420;
+  int width = 0;
+  int height = 0;
+  int planeCount = 0;
+  /**
+   * The planes in the order of the format, the unused ones are nullptr.
+   */
+  uint8_t* planes[3] = {};
+  /**
+   * The stride of each plane in bytes, a multiple of 32. Every row starts 16-byte aligned.
+   */
+  int rowBytes[3] = {};
+};
+
+/**
+ * The pixels of a frame passed to FFVideoEncoder::onSendData(), in any VideoPixelFormat.
+ */
+struct FFMOVIE_API VideoFramePixels {
+  VideoPixelFormat format = VideoPixelFormat::RGBA;
+  int width = 0;
+  int height = 0;
+  /**
+   * The planes in the order of the format, the unused ones are nullptr.
+   */
+  const uint8_t* planes[3] = {};
+  int rowBytes[3] = {};
+  /**
+   * Keeps the planes alive until the encoder releases it, which may be after onSendData() returned,
+   * a decoded VideoFrame can be passed here for example. If it is nullptr, onSendData() is done
+   * with the planes before it returns, at the cost of a copy for I420 and of the overlap between
+   * the conversion and the encoding for the other formats.
+   */
+  std::shared_ptr<void> owner = nullptr;
+};
+
+enum class FFMOVIE_API SpeedDecision {
+  Hold,
+  /**
+   * Moved to a faster level. The levels raise the quantizer or lower the bitrate, so they trade
+   * quality for less entropy coding and output, which makes the codec only modestly faster. A level
+   * that did not shorten the frame time is undone with a SlowDown.
+   */
+  SpeedUp,
+  /**
+   * Moved back to a slower level of better quality.
+   */
+  SlowDown,
+};
+
+/**
+ * The measurements and the decision of the speed controller of an FFVideoEncoder exporting with a
+ * target frame rate.
+ */
+struct FFMOVIE_API VideoEncoderStats {
+  /**
+   * The frames sent to the codec so far.
+   */
+  int64_t frameCount = 0;
+  /**
+   * The mean time the codec spent per frame since the previous stats, in microseconds.
+   */
+  int64_t frameTime = 0;
+  /**
+   * The time per frame the target frame rate allows, in microseconds.
+   */
+  int64_t frameBudget = 0;
+  /**
+   * The frames waiting to be sent or inside the codec without a packet out yet.
+   */
+  int queueDepth = 0;
+  /**
+   * 0 runs with the settings of the VideoExportConfig, each level above is faster.
+   */
+  int speedLevel = 0;
+  /**
+   * The rate control value of the level, the CRF, the QP, or the bitrate in bps, depending on
+   * VideoExportConfig::rateControl.
+   */
+  int64_t rateControlValue = 0;
+  SpeedDecision decision = SpeedDecision::Hold;
+};
+
 class FFMOVIE_API FFVideoEncoder : public FFEncoder {
  public:
   static std::unique_ptr<FFVideoEncoder> Make(const VideoExportConfig& config);
   virtual CodingResult onSendData(std::unique_ptr<ByteData> rgbaData, int width, int height,
                                   int rowBytes, int64_t pts) = 0;
+
+  /**
+   * Encodes the pixels as the frame at pts, in the time base of the frame rate. I420 pixels with an
+   * owner are passed to the codec without any copy, the other formats are converted to I420 with
+   * the matching libyuv kernel. The pixels must have the size of the encoder, which is even for
+   * I420 and NV12, the frame is rejected otherwise.
+   */
+  virtual CodingResult onSendData(const VideoFramePixels& pixels, int64_t pts) = 0;
+
+  /**
+   * Returns the format the encoder takes without converting it, rendering into buffers of this
+   * format costs no conversion at all.
+   */
+  virtual VideoPixelFormat preferredInputFormat() = 0;
+
+  /**
+   * Hands out a pooled buffer of the size of the export in the format, for the caller to render
+   * the next frame into. Buffers are recycled once the encoder is done with them, so no frame is
+   * allocated or copied per frame. Returns false if the buffer can not be allocated. Must be
+   * called after initEncoder().
+   */
+  virtual bool dequeueInputBuffer(VideoPixelFormat format, VideoInputBuffer* buffer) = 0;
+
+  /**
+   * Encodes the buffer returned by dequeueInputBuffer() as the frame at pts, in the time base of
+   * the frame rate as in onSendData(). The buffer belongs to the encoder again and must not be
+   * touched afterwards.
+   */
+  virtual CodingResult queueInputBuffer(const VideoInputBuffer& buffer, int64_t pts) = 0;
+
+  using StatsCallback = std::function<void(const VideoEncoderStats& stats)>;
+
+  /**
+   * Sets the callback receiving the speed controller stats every few frames, on the thread that
+   * sends the frames. Only called if VideoExportConfig::targetFrameRate is set.
+   */
+  virtual void setStatsCallback(StatsCallback callback) = 0;
 };
 
 }  // namespace ffmovie
\ No newline at end of file
@@ -0,0 +1,46 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ffmovie/movie.h"
+
+namespace ffmovie {
+std::shared_ptr<VideoFrame> VideoFrame::Make(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    return nullptr;
+  }
+  auto chromaWidth = (width + 1) / 2;
+  auto chromaHeight = (height + 1) / 2;
+  auto lumaSize = static_cast<size_t>(width) * height;
+  auto chromaSize = static_cast<size_t>(chromaWidth) * chromaHeight;
+  auto pixels = ByteData::Make(lumaSize + chromaSize * 2);
+  if (pixels->length() == 0) {
+    return nullptr;
+  }
+  auto frame = std::make_shared<VideoFrame>();
+  frame->width = width;
+  frame->height = height;
+  frame->buffer.data[0] = pixels->data();
+  frame->buffer.data[1] = pixels->data() + lumaSize;
+  frame->buffer.data[2] = pixels->data() + lumaSize + chromaSize;
+  frame->buffer.lineSize[0] = width;
+  frame->buffer.lineSize[1] = chromaWidth;
+  frame->buffer.lineSize[2] = chromaWidth;
+  frame->pixels = std::move(pixels);
+  return frame;
+}
+}  // namespace ffmovie
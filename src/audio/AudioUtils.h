@@ -32,18 +32,6 @@ extern "C" {
 #include "ffmovie/movie.h"
 
 namespace ffmovie {
-struct VolumeRange {
-  VolumeRange() = default;
-
-  VolumeRange(const TimeRange timeRange, float startVolume, float endVolume)
-      : timeRange(timeRange), startVolume(startVolume), endVolume(endVolume) {
-  }
-
-  TimeRange timeRange{-1, -1};
-  float startVolume = 1.0f;
-  float endVolume = 1.0f;
-};
-
 struct PCMOutputConfig {
   // 采样率，默认 44.1kHZ
   int sampleRate = 44100;
@@ -54,6 +42,7 @@ struct PCMOutputConfig {
   int channels = 2;
   // 立体声
   uint64_t channelLayout = AV_CH_LAYOUT_STEREO;
+  ResampleQuality resampleQuality = ResampleQuality::Medium;
 };
 
 inline int64_t SampleLengthToCount(int64_t length, PCMOutputConfig* config) {
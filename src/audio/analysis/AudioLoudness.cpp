@@ -0,0 +1,181 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "audio/analysis/AudioSource.h"
+#include "audio/analysis/LoudnessMeter.h"
+#include "utils/Executor.h"
+#include "utils/FileInfo.h"
+
+namespace ffmovie {
+#define LOUDNESS_DECODE_CHUNK_SAMPLES 4096
+#define LOUDNESS_FILE_VERSION 2
+
+static const char LoudnessFileMagic[4] = {'F', 'F', 'L', 'N'};
+
+std::shared_ptr<FFAudioLoudness> FFAudioLoudness::Make(const std::string& path,
+                                                       const std::string& cachePath) {
+  if (!cachePath.empty()) {
+    auto cached = Load(cachePath, path);
+    if (cached != nullptr) {
+      return cached;
+    }
+  }
+  // Taken before decoding, so a file changed meanwhile does not match the saved result.
+  FileInfo fileInfo = {};
+  if (!GetFileInfo(path, &fileInfo)) {
+    return nullptr;
+  }
+  AudioSourceInfo info = {};
+  auto demuxer = OpenAudioSource(path, "", &info);
+  if (demuxer == nullptr) {
+    return nullptr;
+  }
+  auto meter = LoudnessMeter::Make(info.sampleRate, info.channels);
+  auto decoder = MakeSourceDecoder(demuxer.get(), info, LOUDNESS_DECODE_CHUNK_SAMPLES);
+  if (meter == nullptr || decoder == nullptr) {
+    return nullptr;
+  }
+  while (true) {
+    auto chunk = decoder->readNextChunk();
+    if (chunk.empty()) {
+      break;
+    }
+    auto count = static_cast<size_t>(chunk.length) / (info.channels * 2);
+    meter->process(reinterpret_cast<const int16_t*>(chunk.data), count);
+  }
+  auto loudness = std::shared_ptr<FFAudioLoudness>(new FFAudioLoudness());
+  loudness->_integratedLoudness = meter->integratedLoudness();
+  auto truePeak = meter->truePeak();
+  loudness->_truePeak = truePeak > 0 ? 20.0 * std::log10(truePeak) : -HUGE_VAL;
+  loudness->_shortTermLoudness = meter->shortTermLoudness();
+  loudness->sourceSize = fileInfo.size;
+  loudness->sourceModifiedTime = fileInfo.modifiedTime;
+  // A result cut short by a decoding error is still returned, but never cached.
+  if (!cachePath.empty() && decoder->reachedEndOfStream()) {
+    loudness->save(cachePath);
+  }
+  return loudness;
+}
+
+std::vector<std::shared_ptr<FFAudioLoudness>> FFAudioLoudness::Make(
+    const std::vector<std::string>& paths, const std::vector<std::string>& cachePaths) {
+  std::vector<std::shared_ptr<FFAudioLoudness>> results(paths.size());
+  if (paths.empty() || (!cachePaths.empty() && cachePaths.size() != paths.size())) {
+    return results;
+  }
+  auto measure = [&](size_t index) {
+    results[index] = Make(paths[index], cachePaths.empty() ? "" : cachePaths[index]);
+  };
+  std::vector<std::future<void>> tasks = {};
+  for (size_t index = 1; index < paths.size(); index++) {
+    auto task = [&measure, index]() { measure(index); };
+    tasks.push_back(Executor::Shared()->submit(task));
+  }
+  // The first file is measured on the calling thread, which would otherwise only wait.
+  measure(0);
+  for (auto& task : tasks) {
+    task.wait();
+  }
+  return results;
+}
+
+double FFAudioLoudness::maxShortTermLoudness() const {
+  if (_shortTermLoudness.empty()) {
+    return -HUGE_VAL;
+  }
+  return *std::max_element(_shortTermLoudness.begin(), _shortTermLoudness.end());
+}
+
+double FFAudioLoudness::gainToTarget(double targetLoudness, double maxTruePeak) const {
+  if (!std::isfinite(_integratedLoudness)) {
+    return 0;
+  }
+  auto gain = targetLoudness - _integratedLoudness;
+  if (std::isfinite(_truePeak) && _truePeak + gain > maxTruePeak) {
+    gain = maxTruePeak - _truePeak;
+  }
+  return gain;
+}
+
+bool FFAudioLoudness::save(const std::string& loudnessPath) const {
+  auto file = fopen(loudnessPath.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  int32_t version = LOUDNESS_FILE_VERSION;
+  uint64_t count = _shortTermLoudness.size();
+  auto written =
+      fwrite(LoudnessFileMagic, 1, sizeof(LoudnessFileMagic), file) == sizeof(LoudnessFileMagic) &&
+      fwrite(&version, sizeof(version), 1, file) == 1 &&
+      fwrite(&sourceSize, sizeof(sourceSize), 1, file) == 1 &&
+      fwrite(&sourceModifiedTime, sizeof(sourceModifiedTime), 1, file) == 1 &&
+      fwrite(&_integratedLoudness, sizeof(_integratedLoudness), 1, file) == 1 &&
+      fwrite(&_truePeak, sizeof(_truePeak), 1, file) == 1 &&
+      fwrite(&count, sizeof(count), 1, file) == 1 &&
+      fwrite(_shortTermLoudness.data(), sizeof(float), count, file) == count;
+  written = fclose(file) == 0 && written;
+  if (!written) {
+    remove(loudnessPath.c_str());
+  }
+  return written;
+}
+
+std::shared_ptr<FFAudioLoudness> FFAudioLoudness::Load(const std::string& loudnessPath,
+                                                       const std::string& path) {
+  FileInfo fileInfo = {};
+  if (!GetFileInfo(path, &fileInfo)) {
+    return nullptr;
+  }
+  auto file = fopen(loudnessPath.c_str(), "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  auto loudness = std::shared_ptr<FFAudioLoudness>(new FFAudioLoudness());
+  char magic[4] = {};
+  int32_t version = 0;
+  uint64_t count = 0;
+  auto valid = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+               memcmp(magic, LoudnessFileMagic, sizeof(magic)) == 0 &&
+               fread(&version, sizeof(version), 1, file) == 1 &&
+               version == LOUDNESS_FILE_VERSION &&
+               fread(&loudness->sourceSize, sizeof(int64_t), 1, file) == 1 &&
+               loudness->sourceSize == fileInfo.size &&
+               fread(&loudness->sourceModifiedTime, sizeof(int64_t), 1, file) == 1 &&
+               loudness->sourceModifiedTime == fileInfo.modifiedTime &&
+               fread(&loudness->_integratedLoudness, sizeof(double), 1, file) == 1 &&
+               fread(&loudness->_truePeak, sizeof(double), 1, file) == 1 &&
+               fread(&count, sizeof(count), 1, file) == 1;
+  if (valid) {
+    // Rejects corrupted counts before allocating for them.
+    auto position = ftell(file);
+    valid = fseek(file, 0, SEEK_END) == 0 &&
+            static_cast<uint64_t>(ftell(file) - position) == count * sizeof(float) &&
+            fseek(file, position, SEEK_SET) == 0;
+  }
+  if (valid) {
+    loudness->_shortTermLoudness.resize(count);
+    valid = fread(loudness->_shortTermLoudness.data(), sizeof(float), count, file) == count;
+  }
+  fclose(file);
+  return valid ? loudness : nullptr;
+}
+}  // namespace ffmovie
@@ -0,0 +1,273 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include "audio/AudioUtils.h"
+#include "audio/analysis/AudioSource.h"
+#include "audio/process/AudioKernels.h"
+#include "utils/Executor.h"
+#include "utils/FileInfo.h"
+
+namespace ffmovie {
+#define PEAK_LEVEL_ZOOM 4
+#define PEAK_DECODE_CHUNK_SAMPLES 4096
+// In seconds, shorter segments are not worth opening one more decoder for.
+#define MIN_PEAK_SEGMENT_DURATION 10
+#define PEAK_FILE_VERSION 2
+
+static const char PeakFileMagic[4] = {'F', 'F', 'P', 'K'};
+
+struct PeakBucket {
+  int16_t min = INT16_MAX;
+  int16_t max = INT16_MIN;
+  uint64_t sumSquares = 0;
+  int64_t sampleCount = 0;
+};
+
+static AudioPeak ToAudioPeak(const PeakBucket& bucket) {
+  if (bucket.sampleCount == 0) {
+    return {};
+  }
+  auto rms = std::sqrt(static_cast<double>(bucket.sumSquares) / bucket.sampleCount);
+  return {bucket.min, bucket.max, static_cast<int16_t>(std::min(rms, 32767.0))};
+}
+
+/**
+ * Decodes frameCount samples per channel from startFrame, or up to the end of stream if frameCount
+ * is negative, and reduces them to buckets of samplesPerBucket samples per channel. Returns the
+ * number of samples per channel decoded, or -1 if the file can not be decoded.
+ */
+static int64_t DecodePeaks(const std::string& path, const std::string& indexPath,
+                           const AudioSourceInfo& info, int64_t startFrame, int64_t frameCount,
+                           int samplesPerBucket, std::vector<AudioPeak>* peaks) {
+  auto demuxer = OpenAudioSource(path, indexPath, nullptr);
+  if (demuxer == nullptr) {
+    return -1;
+  }
+  auto decoder = MakeSourceDecoder(demuxer.get(), info, PEAK_DECODE_CHUNK_SAMPLES);
+  if (decoder == nullptr) {
+    return -1;
+  }
+  if (startFrame > 0 &&
+      !decoder->seekTo(av_rescale(startFrame, AV_TIME_BASE, info.sampleRate))) {
+    return -1;
+  }
+  auto bucketSize = static_cast<int64_t>(samplesPerBucket) * info.channels;
+  auto maxFrameCount = frameCount >= 0 ? frameCount : INT64_MAX;
+  PeakBucket bucket = {};
+  int64_t decodedCount = 0;
+  while (decodedCount < maxFrameCount) {
+    auto chunk = decoder->readNextChunk();
+    if (chunk.empty()) {
+      break;
+    }
+    auto chunkFrameCount = std::min(static_cast<int64_t>(chunk.length) / (info.channels * 2),
+                                    maxFrameCount - decodedCount);
+    auto samples = reinterpret_cast<const int16_t*>(chunk.data);
+    auto remaining = chunkFrameCount * info.channels;
+    while (remaining > 0) {
+      auto count = std::min(remaining, bucketSize - bucket.sampleCount);
+      ReducePeakS16(samples, static_cast<size_t>(count), &bucket.min, &bucket.max,
+                    &bucket.sumSquares);
+      bucket.sampleCount += count;
+      samples += count;
+      remaining -= count;
+      if (bucket.sampleCount == bucketSize) {
+        peaks->push_back(ToAudioPeak(bucket));
+        bucket = {};
+      }
+    }
+    decodedCount += chunkFrameCount;
+  }
+  if (bucket.sampleCount > 0) {
+    peaks->push_back(ToAudioPeak(bucket));
+  }
+  return decodedCount;
+}
+
+std::shared_ptr<FFAudioPeaks> FFAudioPeaks::Make(const std::string& path, int samplesPerBucket,
+                                                 int levelCount, const std::string& indexPath) {
+  if (samplesPerBucket <= 0 || levelCount <= 0) {
+    return nullptr;
+  }
+  // Taken before decoding, so a file changed meanwhile does not match the saved peaks.
+  FileInfo fileInfo = {};
+  if (!GetFileInfo(path, &fileInfo)) {
+    return nullptr;
+  }
+  AudioSourceInfo info = {};
+  if (OpenAudioSource(path, indexPath, &info) == nullptr) {
+    return nullptr;
+  }
+  int64_t segmentCount = 1;
+  if (info.hasPacketIndex && info.frameCount > 0) {
+    auto maxSegmentCount =
+        info.frameCount / (static_cast<int64_t>(info.sampleRate) * MIN_PEAK_SEGMENT_DURATION);
+    segmentCount = std::max(
+        std::min(maxSegmentCount, static_cast<int64_t>(Executor::Shared()->threadCount())),
+        static_cast<int64_t>(1));
+  }
+  // Segments start on bucket boundaries, so their buckets line up once concatenated.
+  auto bucketCount = (info.frameCount + samplesPerBucket - 1) / samplesPerBucket;
+  auto segmentFrameCount =
+      (bucketCount + segmentCount - 1) / segmentCount * static_cast<int64_t>(samplesPerBucket);
+  std::vector<std::vector<AudioPeak>> segmentPeaks(static_cast<size_t>(segmentCount));
+  std::vector<int64_t> decodedCounts(static_cast<size_t>(segmentCount), 0);
+  auto decodeSegment = [&](int64_t index) {
+    auto startFrame = index * segmentFrameCount;
+    // The last segment runs to the end of stream, the duration may be an estimate.
+    auto frameCount = index + 1 < segmentCount ? segmentFrameCount : -1;
+    decodedCounts[index] = DecodePeaks(path, indexPath, info, startFrame, frameCount,
+                                       samplesPerBucket, &segmentPeaks[index]);
+  };
+  std::vector<std::future<void>> tasks = {};
+  for (int64_t index = 1; index < segmentCount; index++) {
+    auto task = [&decodeSegment, index]() { decodeSegment(index); };
+    tasks.push_back(Executor::Shared()->submit(task));
+  }
+  // The first segment runs on the calling thread, which would otherwise only wait.
+  decodeSegment(0);
+  for (auto& task : tasks) {
+    task.wait();
+  }
+  auto peaks = std::shared_ptr<FFAudioPeaks>(new FFAudioPeaks());
+  peaks->_sampleRate = info.sampleRate;
+  peaks->baseSamplesPerBucket = samplesPerBucket;
+  peaks->sourceSize = fileInfo.size;
+  peaks->sourceModifiedTime = fileInfo.modifiedTime;
+  peaks->levels.resize(1);
+  for (int64_t index = 0; index < segmentCount; index++) {
+    if (decodedCounts[index] < 0) {
+      return nullptr;
+    }
+    peaks->_sampleCount += decodedCounts[index];
+    auto& source = segmentPeaks[index];
+    peaks->levels[0].insert(peaks->levels[0].end(), source.begin(), source.end());
+  }
+  peaks->buildLevels(levelCount);
+  return peaks;
+}
+
+void FFAudioPeaks::buildLevels(int levelCount) {
+  levels.resize(static_cast<size_t>(levelCount));
+  for (size_t level = 1; level < levels.size(); level++) {
+    auto& source = levels[level - 1];
+    auto& target = levels[level];
+    target.clear();
+    target.reserve((source.size() + PEAK_LEVEL_ZOOM - 1) / PEAK_LEVEL_ZOOM);
+    for (size_t start = 0; start < source.size(); start += PEAK_LEVEL_ZOOM) {
+      auto end = std::min(start + PEAK_LEVEL_ZOOM, source.size());
+      AudioPeak peak = source[start];
+      double sumSquares = 0;
+      for (auto i = start; i < end; i++) {
+        peak.min = std::min(peak.min, source[i].min);
+        peak.max = std::max(peak.max, source[i].max);
+        sumSquares += static_cast<double>(source[i].rms) * source[i].rms;
+      }
+      peak.rms = static_cast<int16_t>(std::sqrt(sumSquares / static_cast<double>(end - start)));
+      target.push_back(peak);
+    }
+  }
+}
+
+int FFAudioPeaks::samplesPerBucket(int level) const {
+  auto result = baseSamplesPerBucket;
+  for (int i = 0; i < level; i++) {
+    result *= PEAK_LEVEL_ZOOM;
+  }
+  return result;
+}
+
+bool FFAudioPeaks::save(const std::string& peakPath) const {
+  auto file = fopen(peakPath.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  int32_t version = PEAK_FILE_VERSION;
+  int32_t sampleRate = _sampleRate;
+  int32_t bucketSize = baseSamplesPerBucket;
+  int32_t count = levelCount();
+  auto written = fwrite(PeakFileMagic, 1, sizeof(PeakFileMagic), file) == sizeof(PeakFileMagic) &&
+                 fwrite(&version, sizeof(version), 1, file) == 1 &&
+                 fwrite(&sourceSize, sizeof(sourceSize), 1, file) == 1 &&
+                 fwrite(&sourceModifiedTime, sizeof(sourceModifiedTime), 1, file) == 1 &&
+                 fwrite(&sampleRate, sizeof(sampleRate), 1, file) == 1 &&
+                 fwrite(&_sampleCount, sizeof(_sampleCount), 1, file) == 1 &&
+                 fwrite(&bucketSize, sizeof(bucketSize), 1, file) == 1 &&
+                 fwrite(&count, sizeof(count), 1, file) == 1;
+  for (auto& level : levels) {
+    uint64_t peakCount = level.size();
+    written = written && fwrite(&peakCount, sizeof(peakCount), 1, file) == 1 &&
+              fwrite(level.data(), sizeof(AudioPeak), level.size(), file) == level.size();
+  }
+  written = fclose(file) == 0 && written;
+  if (!written) {
+    remove(peakPath.c_str());
+  }
+  return written;
+}
+
+std::shared_ptr<FFAudioPeaks> FFAudioPeaks::Load(const std::string& peakPath,
+                                                 const std::string& path) {
+  FileInfo fileInfo = {};
+  if (!GetFileInfo(path, &fileInfo)) {
+    return nullptr;
+  }
+  auto file = fopen(peakPath.c_str(), "rb");
+  if (file == nullptr) {
+    return nullptr;
+  }
+  auto peaks = std::shared_ptr<FFAudioPeaks>(new FFAudioPeaks());
+  char magic[4] = {};
+  int32_t version = 0;
+  int32_t sampleRate = 0;
+  int32_t bucketSize = 0;
+  int32_t count = 0;
+  auto valid = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+               memcmp(magic, PeakFileMagic, sizeof(magic)) == 0 &&
+               fread(&version, sizeof(version), 1, file) == 1 && version == PEAK_FILE_VERSION &&
+               fread(&peaks->sourceSize, sizeof(peaks->sourceSize), 1, file) == 1 &&
+               peaks->sourceSize == fileInfo.size &&
+               fread(&peaks->sourceModifiedTime, sizeof(peaks->sourceModifiedTime), 1, file) == 1 &&
+               peaks->sourceModifiedTime == fileInfo.modifiedTime &&
+               fread(&sampleRate, sizeof(sampleRate), 1, file) == 1 && sampleRate > 0 &&
+               fread(&peaks->_sampleCount, sizeof(peaks->_sampleCount), 1, file) == 1 &&
+               peaks->_sampleCount >= 0 && fread(&bucketSize, sizeof(bucketSize), 1, file) == 1 &&
+               bucketSize > 0 && fread(&count, sizeof(count), 1, file) == 1 && count > 0;
+  if (valid) {
+    peaks->_sampleRate = sampleRate;
+    peaks->baseSamplesPerBucket = bucketSize;
+    peaks->levels.resize(static_cast<size_t>(count));
+  }
+  for (int level = 0; valid && level < count; level++) {
+    // Rejects corrupted counts before allocating for them.
+    auto maxPeakCount = static_cast<uint64_t>(peaks->_sampleCount / bucketSize + 1);
+    uint64_t peakCount = 0;
+    valid = fread(&peakCount, sizeof(peakCount), 1, file) == 1 && peakCount <= maxPeakCount;
+    if (valid) {
+      auto& target = peaks->levels[level];
+      target.resize(peakCount);
+      valid = fread(target.data(), sizeof(AudioPeak), peakCount, file) == peakCount;
+    }
+  }
+  fclose(file);
+  return valid ? peaks : nullptr;
+}
+}  // namespace ffmovie
@@ -0,0 +1,67 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AudioSource.h"
+#include "audio/AudioUtils.h"
+#include "audio/demux/FFmpegAudioDemuxer.h"
+
+namespace ffmovie {
+std::unique_ptr<FFAudioDemuxer> OpenAudioSource(const std::string& path,
+                                                const std::string& indexPath,
+                                                AudioSourceInfo* info) {
+  auto demuxer = FFAudioDemuxer::Make(path);
+  if (demuxer == nullptr) {
+    return nullptr;
+  }
+  for (int i = 0; i < demuxer->getTrackCount(); i++) {
+    // Only the audio tracks have a format.
+    auto format = demuxer->getTrackFormat(i);
+    if (format == nullptr) {
+      continue;
+    }
+    auto codecpar = static_cast<AVCodecParameters*>(format->getCodecPar());
+    if (codecpar == nullptr || codecpar->sample_rate <= 0) {
+      return nullptr;
+    }
+    demuxer->selectTrack(i);
+    if (!indexPath.empty()) {
+      demuxer->startIndexing(indexPath);
+    }
+    if (info != nullptr) {
+      info->sampleRate = codecpar->sample_rate;
+      info->channels = codecpar->channels >= 2 ? 2 : 1;
+      auto duration = format->getLong(KEY_DURATION);
+      info->frameCount =
+          duration > 0 ? av_rescale(duration, info->sampleRate, AV_TIME_BASE) : -1;
+      info->hasPacketIndex = static_cast<FFmpegAudioDemuxer*>(demuxer.get())->hasPacketIndex();
+    }
+    return demuxer;
+  }
+  return nullptr;
+}
+
+std::unique_ptr<FFAudioDecoder> MakeSourceDecoder(FFAudioDemuxer* demuxer,
+                                                  const AudioSourceInfo& info,
+                                                  int outputSamplesCount) {
+  auto config = std::make_shared<AudioOutputConfig>();
+  config->sampleRate = info.sampleRate;
+  config->channels = info.channels;
+  config->outputSamplesCount = outputSamplesCount;
+  return FFAudioDecoder::Make(demuxer, config);
+}
+}  // namespace ffmovie
@@ -0,0 +1,51 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "ffmovie/movie.h"
+
+namespace ffmovie {
+/**
+ * The stream properties of an audio file that the analysis passes decode with.
+ */
+struct AudioSourceInfo {
+  int sampleRate = 0;
+  // At most two, the decoder downmixes the other layouts.
+  int channels = 0;
+  // The number of samples per channel, or -1 if the duration is unknown.
+  int64_t frameCount = -1;
+  // True if seeking is sample exact, so segments of the file can be decoded in parallel.
+  bool hasPacketIndex = false;
+};
+
+/**
+ * Opens the file and selects its first audio track, filling info if it is not nullptr. If indexPath
+ * is not empty, the packet index of a raw MP3 or ADTS stream is loaded from it or built into it.
+ */
+std::unique_ptr<FFAudioDemuxer> OpenAudioSource(const std::string& path,
+                                                const std::string& indexPath,
+                                                AudioSourceInfo* info);
+
+/**
+ * Creates a decoder that outputs s16 samples in the sample rate and the channels of the info.
+ */
+std::unique_ptr<FFAudioDecoder> MakeSourceDecoder(FFAudioDemuxer* demuxer,
+                                                  const AudioSourceInfo& info,
+                                                  int outputSamplesCount);
+}  // namespace ffmovie
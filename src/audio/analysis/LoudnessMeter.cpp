@@ -0,0 +1,180 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "LoudnessMeter.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "audio/process/AudioKernels.h"
+
+namespace ffmovie {
+#define LOUDNESS_PI 3.14159265358979323846
+#define BLOCKS_PER_SECOND 10
+#define GATING_WINDOW_BLOCKS 4
+#define SHORT_TERM_WINDOW_BLOCKS 30
+#define ABSOLUTE_GATE_LOUDNESS -70.0
+#define RELATIVE_GATE_LOUDNESS -10.0
+#define TRUE_PEAK_OVERSAMPLING 4
+#define TRUE_PEAK_FILTER_TAPS 49
+
+static double EnergyToLoudness(double energy) {
+  return energy > 0 ? -0.691 + 10.0 * std::log10(energy) : -HUGE_VAL;
+}
+
+static double LoudnessToEnergy(double loudness) {
+  return std::pow(10.0, (loudness + 0.691) / 10.0);
+}
+
+/**
+ * Computes the two stages of the K-weighting filter for the sample rate, the high shelf that models
+ * the head and the high pass of the RLB curve, with the constants of the 48 kHz filter in BS.1770.
+ */
+static void MakeKWeightingFilter(int sampleRate, double* coefficients) {
+  auto k = std::tan(LOUDNESS_PI * 1681.974450955533 / sampleRate);
+  auto q = 0.7071752369554196;
+  auto vh = std::pow(10.0, 3.999843853973347 / 20.0);
+  auto vb = std::pow(vh, 0.4996667741545416);
+  auto a0 = 1.0 + k / q + k * k;
+  coefficients[0] = (vh + vb * k / q + k * k) / a0;
+  coefficients[1] = 2.0 * (k * k - vh) / a0;
+  coefficients[2] = (vh - vb * k / q + k * k) / a0;
+  coefficients[3] = 2.0 * (k * k - 1.0) / a0;
+  coefficients[4] = (1.0 - k / q + k * k) / a0;
+
+  k = std::tan(LOUDNESS_PI * 38.13547087602444 / sampleRate);
+  q = 0.5003270373238773;
+  a0 = 1.0 + k / q + k * k;
+  coefficients[5] = 1.0;
+  coefficients[6] = -2.0;
+  coefficients[7] = 1.0;
+  coefficients[8] = 2.0 * (k * k - 1.0) / a0;
+  coefficients[9] = (1.0 - k / q + k * k) / a0;
+}
+
+std::unique_ptr<LoudnessMeter> LoudnessMeter::Make(int sampleRate, int channels) {
+  if (sampleRate < BLOCKS_PER_SECOND || channels < 1 || channels > 2) {
+    return nullptr;
+  }
+  return std::unique_ptr<LoudnessMeter>(new LoudnessMeter(sampleRate, channels));
+}
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channels)
+    : channels(channels), blockSize((sampleRate + BLOCKS_PER_SECOND / 2) / BLOCKS_PER_SECOND) {
+  MakeKWeightingFilter(sampleRate, coefficients);
+  filterState.resize(static_cast<size_t>(4 * channels), 0);
+  blockSumSquares.resize(static_cast<size_t>(channels), 0);
+
+  // A Hann windowed sinc interpolator, split into one filter per output phase.
+  phaseTapCount = (TRUE_PEAK_FILTER_TAPS + TRUE_PEAK_OVERSAMPLING - 1) / TRUE_PEAK_OVERSAMPLING;
+  phaseFilters.resize(TRUE_PEAK_OVERSAMPLING, std::vector<float>(phaseTapCount, 0.0f));
+  for (int i = 0; i < TRUE_PEAK_FILTER_TAPS; i++) {
+    auto offset = i - (TRUE_PEAK_FILTER_TAPS - 1) / 2;
+    auto x = LOUDNESS_PI * offset / TRUE_PEAK_OVERSAMPLING;
+    auto sinc = offset == 0 ? 1.0 : std::sin(x) / x;
+    auto window = 0.5 * (1.0 - std::cos(2.0 * LOUDNESS_PI * i / (TRUE_PEAK_FILTER_TAPS - 1)));
+    auto& filter = phaseFilters[i % TRUE_PEAK_OVERSAMPLING];
+    filter[phaseTapCount - 1 - i / TRUE_PEAK_OVERSAMPLING] = static_cast<float>(sinc * window);
+  }
+  peakPlanes.resize(static_cast<size_t>(channels),
+                    std::vector<float>(static_cast<size_t>(phaseTapCount - 1), 0.0f));
+}
+
+void LoudnessMeter::process(const int16_t* samples, size_t frameCount) {
+  processPeaks(samples, frameCount);
+  while (frameCount > 0) {
+    auto count = std::min(frameCount, static_cast<size_t>(blockSize - blockFrameCount));
+    FilterSumSquaresS16(samples, channels, count, coefficients, 2, filterState.data(),
+                        blockSumSquares.data());
+    blockFrameCount += static_cast<int>(count);
+    samples += count * channels;
+    frameCount -= count;
+    if (blockFrameCount == blockSize) {
+      finishBlock();
+    }
+  }
+}
+
+void LoudnessMeter::finishBlock() {
+  double energy = 0;
+  for (auto& sumSquares : blockSumSquares) {
+    energy += sumSquares / blockSize;
+    sumSquares = 0;
+  }
+  blockFrameCount = 0;
+  blockEnergies.push_back(energy);
+  if (blockEnergies.size() >= SHORT_TERM_WINDOW_BLOCKS) {
+    auto begin = blockEnergies.end() - SHORT_TERM_WINDOW_BLOCKS;
+    auto windowEnergy = std::accumulate(begin, blockEnergies.end(), 0.0);
+    auto loudness = EnergyToLoudness(windowEnergy / SHORT_TERM_WINDOW_BLOCKS);
+    _shortTermLoudness.push_back(static_cast<float>(loudness));
+  }
+}
+
+void LoudnessMeter::processPeaks(const int16_t* samples, size_t frameCount) {
+  auto historyCount = static_cast<size_t>(phaseTapCount - 1);
+  float* planes[2] = {};
+  for (int channel = 0; channel < channels; channel++) {
+    peakPlanes[channel].resize(historyCount + frameCount);
+    planes[channel] = peakPlanes[channel].data() + historyCount;
+  }
+  DeinterleaveS16ToF32(samples, channels, planes, frameCount);
+  float peak = static_cast<float>(_truePeak);
+  for (auto& plane : peakPlanes) {
+    for (size_t i = 0; i < frameCount; i++) {
+      for (auto& filter : phaseFilters) {
+        auto value = DotProductF32(filter.data(), plane.data() + i, filter.size());
+        peak = std::max(peak, std::fabs(value));
+      }
+    }
+    std::copy(plane.end() - historyCount, plane.end(), plane.begin());
+    plane.resize(historyCount);
+  }
+  _truePeak = peak;
+}
+
+double LoudnessMeter::integratedLoudness() const {
+  if (blockEnergies.size() < GATING_WINDOW_BLOCKS) {
+    return -HUGE_VAL;
+  }
+  std::vector<double> windowEnergies = {};
+  windowEnergies.reserve(blockEnergies.size());
+  for (size_t i = GATING_WINDOW_BLOCKS; i <= blockEnergies.size(); i++) {
+    auto begin = blockEnergies.begin() + (i - GATING_WINDOW_BLOCKS);
+    auto energy = std::accumulate(begin, begin + GATING_WINDOW_BLOCKS, 0.0);
+    windowEnergies.push_back(energy / GATING_WINDOW_BLOCKS);
+  }
+  auto gatedMean = [&windowEnergies](double threshold) {
+    double sum = 0;
+    size_t count = 0;
+    for (auto energy : windowEnergies) {
+      if (energy > threshold) {
+        sum += energy;
+        count++;
+      }
+    }
+    return count > 0 ? sum / count : 0.0;
+  };
+  auto absoluteThreshold = LoudnessToEnergy(ABSOLUTE_GATE_LOUDNESS);
+  auto absoluteMean = gatedMean(absoluteThreshold);
+  if (absoluteMean <= 0) {
+    return -HUGE_VAL;
+  }
+  auto relativeThreshold = absoluteMean * std::pow(10.0, RELATIVE_GATE_LOUDNESS / 10.0);
+  return EnergyToLoudness(gatedMean(std::max(absoluteThreshold, relativeThreshold)));
+}
+}  // namespace ffmovie
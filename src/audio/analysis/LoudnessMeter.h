@@ -0,0 +1,83 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ffmovie {
+/**
+ * LoudnessMeter measures interleaved s16 samples as ITU-R BS.1770 and EBU R128 do, in one
+ * streaming pass. The samples are K-weighted and summed into 100 ms blocks, the integrated
+ * loudness gates the 400 ms windows over them and the short-term loudness averages 3 s windows.
+ * The true peak is found by oversampling 4 times. All the channels have a weight of 1.
+ */
+class LoudnessMeter {
+ public:
+  /**
+   * Creates a meter for mono or stereo samples, returns nullptr if the format is not supported.
+   */
+  static std::unique_ptr<LoudnessMeter> Make(int sampleRate, int channels);
+
+  void process(const int16_t* samples, size_t frameCount);
+
+  /**
+   * Returns the integrated loudness in LUFS, or -HUGE_VAL if every window is gated out.
+   */
+  double integratedLoudness() const;
+
+  /**
+   * Returns the loudness in LUFS of every 3 s window, one every 100 ms. The first window ends at
+   * 3 s, so it is empty for shorter audio.
+   */
+  const std::vector<float>& shortTermLoudness() const {
+    return _shortTermLoudness;
+  }
+
+  /**
+   * Returns the maximum of the absolute values of the oversampled signal, 1.0 is full scale.
+   */
+  double truePeak() const {
+    return _truePeak;
+  }
+
+ private:
+  int channels = 0;
+  int blockSize = 0;
+  double coefficients[10] = {};
+  std::vector<double> filterState = {};
+  std::vector<double> blockSumSquares = {};
+  int blockFrameCount = 0;
+  // The mean square of every complete 100 ms block, summed over the channels.
+  std::vector<double> blockEnergies = {};
+  std::vector<float> _shortTermLoudness = {};
+  int phaseTapCount = 0;
+  // The interpolation filter of each phase, reversed so it runs as a dot product.
+  std::vector<std::vector<float>> phaseFilters = {};
+  // Each plane starts with phaseTapCount - 1 samples of history.
+  std::vector<std::vector<float>> peakPlanes = {};
+  double _truePeak = 0;
+
+  LoudnessMeter(int sampleRate, int channels);
+  void finishBlock();
+  void processPeaks(const int16_t* samples, size_t frameCount);
+};
+}  // namespace ffmovie
@@ -0,0 +1,377 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegAudioCache.h"
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <unordered_set>
+#include <vector>
+#include "audio/AudioUtils.h"
+#include "utils/MappedFile.h"
+
+namespace ffmovie {
+#define CACHE_INDEX_FILE_NAME "ffaudiocache.index"
+#define CACHE_HASHES_FILE_NAME "ffaudiocache.hashes"
+#define CACHE_INDEX_MAX_NAME_LENGTH 255
+#define CACHE_HASHES_MAX_PATH_LENGTH 4096
+#define WAV_HEADER_SIZE 44
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+// The hex digits of the content hash the cached file names start with.
+#define HASH_NAME_LENGTH 16
+
+std::shared_ptr<FFAudioCache> FFAudioCache::Make(const std::string& directory, int64_t maxSize) {
+  if (directory.empty() || maxSize <= 0) {
+    return nullptr;
+  }
+  auto cache = std::shared_ptr<FFmpegAudioCache>(new FFmpegAudioCache(directory, maxSize));
+  cache->loadIndex();
+  return cache;
+}
+
+static uint64_t HashBytes(uint64_t hash, const uint8_t* data, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ data[i]) * FNV_PRIME;
+  }
+  return hash;
+}
+
+/**
+ * Hashes the whole content of the file at the path, returns false if it can not be read or no
+ * longer has the size of fileInfo.
+ */
+static bool HashContent(const std::string& path, const FileInfo& fileInfo, uint64_t* hash) {
+  auto mappedFile = MappedFile::Make(path);
+  if (mappedFile == nullptr || static_cast<int64_t>(mappedFile->size()) != fileInfo.size) {
+    return false;
+  }
+  *hash = HashBytes(FNV_OFFSET_BASIS, mappedFile->data(), mappedFile->size());
+  return true;
+}
+
+static void WriteLittleEndian(uint8_t* buffer, uint32_t value, int byteCount) {
+  for (int i = 0; i < byteCount; i++) {
+    buffer[i] = static_cast<uint8_t>(value >> (8 * i));
+  }
+}
+
+static bool WriteWAVHeader(FILE* file, int sampleRate, int channels, uint32_t dataSize) {
+  uint8_t header[WAV_HEADER_SIZE] = {};
+  memcpy(header, "RIFF", 4);
+  memcpy(header + 8, "WAVEfmt ", 8);
+  memcpy(header + 36, "data", 4);
+  auto blockAlign = static_cast<uint32_t>(channels * 2);
+  WriteLittleEndian(header + 4, WAV_HEADER_SIZE - 8 + dataSize, 4);
+  WriteLittleEndian(header + 16, 16, 4);
+  // PCM, 16 bits per sample.
+  WriteLittleEndian(header + 20, 1, 2);
+  WriteLittleEndian(header + 22, static_cast<uint32_t>(channels), 2);
+  WriteLittleEndian(header + 24, static_cast<uint32_t>(sampleRate), 4);
+  WriteLittleEndian(header + 28, static_cast<uint32_t>(sampleRate) * blockAlign, 4);
+  WriteLittleEndian(header + 32, blockAlign, 2);
+  WriteLittleEndian(header + 34, 16, 2);
+  WriteLittleEndian(header + 40, dataSize, 4);
+  return fseek(file, 0, SEEK_SET) == 0 &&
+         fwrite(header, 1, WAV_HEADER_SIZE, file) == WAV_HEADER_SIZE;
+}
+
+/**
+ * Decodes the first audio track of the file at path into a 16-bit WAV file at outputPath. Returns
+ * the size of the WAV file, or -1 if decoding fails.
+ */
+static int64_t DecodeToWAVFile(const std::string& path, std::shared_ptr<AudioOutputConfig> config,
+                               const std::string& outputPath) {
+  auto demuxer = FFAudioDemuxer::Make(path);
+  if (demuxer == nullptr) {
+    return -1;
+  }
+  bool hasAudioTrack = false;
+  for (int i = 0; i < demuxer->getTrackCount(); i++) {
+    // Only the audio tracks have a format.
+    auto format = demuxer->getTrackFormat(i);
+    if (format != nullptr) {
+      demuxer->selectTrack(i);
+      hasAudioTrack = true;
+      break;
+    }
+  }
+  if (!hasAudioTrack) {
+    return -1;
+  }
+  auto decoder = FFAudioDecoder::Make(demuxer.get(), config);
+  if (decoder == nullptr) {
+    return -1;
+  }
+  auto file = fopen(outputPath.c_str(), "wb");
+  if (file == nullptr) {
+    return -1;
+  }
+  auto frameSize = static_cast<int64_t>(config->channels) * 2;
+  int64_t frameCount = 0;
+  bool success = WriteWAVHeader(file, config->sampleRate, config->channels, 0);
+  while (success) {
+    auto chunk = decoder->readNextChunk();
+    if (chunk.empty()) {
+      break;
+    }
+    success = fwrite(chunk.data, 1, chunk.length, file) == chunk.length;
+    frameCount += static_cast<int64_t>(chunk.length) / frameSize;
+  }
+  auto dataSize = frameCount * frameSize;
+  success = success && frameCount > 0 && dataSize <= UINT32_MAX - WAV_HEADER_SIZE &&
+            WriteWAVHeader(file, config->sampleRate, config->channels,
+                           static_cast<uint32_t>(dataSize));
+  success = fclose(file) == 0 && success;
+  return success ? WAV_HEADER_SIZE + dataSize : -1;
+}
+
+FFmpegAudioCache::FFmpegAudioCache(std::string directory, int64_t maxSize)
+    : directory(std::move(directory)), maxSize(maxSize) {
+}
+
+FFmpegAudioCache::~FFmpegAudioCache() {
+  std::lock_guard<std::mutex> autoLock(locker);
+  saveIndex();
+}
+
+std::string FFmpegAudioCache::getFilePath(const std::string& fileName) const {
+  auto last = directory.back();
+  return last == '/' || last == '\\' ? directory + fileName : directory + "/" + fileName;
+}
+
+std::unique_ptr<FFPCMAudioReader> FFmpegAudioCache::open(
+    const std::string& path, std::shared_ptr<AudioOutputConfig> config) {
+  if (config == nullptr) {
+    return nullptr;
+  }
+  // FFPCMAudioReader outputs mono or stereo only.
+  auto outputConfig = std::make_shared<AudioOutputConfig>(*config);
+  outputConfig->channels = config->channels == 2 ? 2 : 1;
+  auto fileName = makeCacheFileName(path, *outputConfig);
+  if (fileName.empty()) {
+    return nullptr;
+  }
+  auto filePath = getFilePath(fileName);
+  bool cached = false;
+  std::string tempFilePath;
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    cached = touch(fileName);
+    tempFilePath = filePath + "." + std::to_string(tempFileCounter++) + ".tmp";
+  }
+  if (cached) {
+    auto reader = FFPCMAudioReader::Make(filePath, config);
+    if (reader != nullptr) {
+      return reader;
+    }
+    // The file was deleted or damaged outside of the cache.
+    std::lock_guard<std::mutex> autoLock(locker);
+    removeEntry(fileName);
+  }
+  // Decoding takes the most time and runs unlocked. Every decode writes its own temporary file, so
+  // two threads opening the same file only race on the final rename, which is harmless.
+  auto fileSize = DecodeToWAVFile(path, outputConfig, tempFilePath);
+  if (fileSize < 0) {
+    std::remove(tempFilePath.c_str());
+    return nullptr;
+  }
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    // rename() does not replace an existing file on Windows.
+    std::remove(filePath.c_str());
+    if (std::rename(tempFilePath.c_str(), filePath.c_str()) != 0) {
+      std::remove(tempFilePath.c_str());
+      return nullptr;
+    }
+    insert(fileName, fileSize);
+    evict(fileName);
+    saveIndex();
+  }
+  return FFPCMAudioReader::Make(filePath, config);
+}
+
+int64_t FFmpegAudioCache::size() {
+  std::lock_guard<std::mutex> autoLock(locker);
+  return totalSize;
+}
+
+void FFmpegAudioCache::clear() {
+  std::lock_guard<std::mutex> autoLock(locker);
+  for (auto& item : entries) {
+    std::remove(getFilePath(item.first).c_str());
+  }
+  entries.clear();
+  totalSize = 0;
+  saveIndex();
+}
+
+std::string FFmpegAudioCache::makeCacheFileName(const std::string& path,
+                                                const AudioOutputConfig& config) {
+  FileInfo fileInfo = {};
+  if (!GetFileInfo(path, &fileInfo)) {
+    return "";
+  }
+  uint64_t hash = 0;
+  bool hashed = false;
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    auto result = contentHashes.find(path);
+    if (result != contentHashes.end() && result->second.size == fileInfo.size &&
+        result->second.modifiedTime == fileInfo.modifiedTime) {
+      hash = result->second.hash;
+      hashed = true;
+    }
+  }
+  // Hashing reads the whole file and runs unlocked.
+  if (!hashed) {
+    if (!HashContent(path, fileInfo, &hash)) {
+      return "";
+    }
+    std::lock_guard<std::mutex> autoLock(locker);
+    contentHashes[path] = {fileInfo.size, fileInfo.modifiedTime, hash};
+  }
+  char fileName[CACHE_INDEX_MAX_NAME_LENGTH + 1] = {};
+  snprintf(fileName, sizeof(fileName), "%016" PRIx64 "-%" PRId64 "-%d-%d-%d.wav", hash,
+           fileInfo.size, config.sampleRate, config.channels,
+           static_cast<int>(config.resampleQuality));
+  return fileName;
+}
+
+bool FFmpegAudioCache::touch(const std::string& fileName) {
+  auto result = entries.find(fileName);
+  if (result == entries.end()) {
+    return false;
+  }
+  result->second.lastUse = ++useCounter;
+  return true;
+}
+
+void FFmpegAudioCache::insert(const std::string& fileName, int64_t fileSize) {
+  auto& entry = entries[fileName];
+  totalSize += fileSize - entry.size;
+  entry.size = fileSize;
+  entry.lastUse = ++useCounter;
+}
+
+void FFmpegAudioCache::removeEntry(const std::string& fileName) {
+  auto result = entries.find(fileName);
+  if (result == entries.end()) {
+    return;
+  }
+  totalSize -= result->second.size;
+  entries.erase(result);
+}
+
+void FFmpegAudioCache::evict(const std::string& keepFileName) {
+  if (totalSize <= maxSize) {
+    return;
+  }
+  std::vector<std::pair<int64_t, std::string>> candidates = {};
+  for (auto& item : entries) {
+    if (item.first != keepFileName) {
+      candidates.emplace_back(item.second.lastUse, item.first);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end());
+  for (auto& candidate : candidates) {
+    if (totalSize <= maxSize) {
+      break;
+    }
+    // A file still mapped by a reader can not be deleted on Windows, it is tried again later.
+    if (std::remove(getFilePath(candidate.second).c_str()) == 0) {
+      removeEntry(candidate.second);
+    }
+  }
+}
+
+void FFmpegAudioCache::loadIndex() {
+  auto file = fopen(getFilePath(CACHE_INDEX_FILE_NAME).c_str(), "r");
+  if (file == nullptr) {
+    return;
+  }
+  char fileName[CACHE_INDEX_MAX_NAME_LENGTH + 1] = {};
+  int64_t fileSize = 0;
+  int64_t lastUse = 0;
+  while (fscanf(file, "%255s %" SCNd64 " %" SCNd64, fileName, &fileSize, &lastUse) == 3) {
+    auto& entry = entries[fileName];
+    totalSize += fileSize - entry.size;
+    entry.size = fileSize;
+    entry.lastUse = lastUse;
+    useCounter = std::max(useCounter, lastUse);
+  }
+  fclose(file);
+  loadContentHashes();
+}
+
+void FFmpegAudioCache::loadContentHashes() {
+  auto file = fopen(getFilePath(CACHE_HASHES_FILE_NAME).c_str(), "r");
+  if (file == nullptr) {
+    return;
+  }
+  ContentHash contentHash = {};
+  char path[CACHE_HASHES_MAX_PATH_LENGTH + 1] = {};
+  // The path comes last and runs to the end of the line, it may contain spaces.
+  while (fscanf(file, "%" SCNx64 " %" SCNd64 " %" SCNd64 " ", &contentHash.hash,
+                &contentHash.size, &contentHash.modifiedTime) == 3 &&
+         fgets(path, sizeof(path), file) != nullptr) {
+    auto length = strlen(path);
+    if (length > 0 && path[length - 1] == '\n') {
+      path[length - 1] = '\0';
+    }
+    contentHashes[path] = contentHash;
+  }
+  fclose(file);
+}
+
+void FFmpegAudioCache::saveIndex() {
+  auto file = fopen(getFilePath(CACHE_INDEX_FILE_NAME).c_str(), "w");
+  if (file == nullptr) {
+    return;
+  }
+  for (auto& item : entries) {
+    fprintf(file, "%s %" PRId64 " %" PRId64 "\n", item.first.c_str(), item.second.size,
+            item.second.lastUse);
+  }
+  fclose(file);
+  saveContentHashes();
+}
+
+void FFmpegAudioCache::saveContentHashes() {
+  // Only the hashes of files still in the cache are kept, so the file does not grow forever.
+  std::unordered_set<std::string> cachedHashes = {};
+  for (auto& item : entries) {
+    cachedHashes.insert(item.first.substr(0, HASH_NAME_LENGTH));
+  }
+  auto file = fopen(getFilePath(CACHE_HASHES_FILE_NAME).c_str(), "w");
+  if (file == nullptr) {
+    return;
+  }
+  char hashName[HASH_NAME_LENGTH + 1] = {};
+  for (auto& item : contentHashes) {
+    snprintf(hashName, sizeof(hashName), "%016" PRIx64, item.second.hash);
+    if (cachedHashes.count(hashName) == 0 || item.first.find('\n') != std::string::npos) {
+      continue;
+    }
+    fprintf(file, "%016" PRIx64 " %" PRId64 " %" PRId64 " %s\n", item.second.hash,
+            item.second.size, item.second.modifiedTime, item.first.c_str());
+  }
+  fclose(file);
+}
+}  // namespace ffmovie
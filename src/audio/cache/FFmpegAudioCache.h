@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <mutex>
+#include <unordered_map>
+#include "ffmovie/movie.h"
+#include "utils/FileInfo.h"
+
+namespace ffmovie {
+class FFmpegAudioCache : public FFAudioCache {
+ public:
+  ~FFmpegAudioCache() override;
+
+  std::unique_ptr<FFPCMAudioReader> open(const std::string& path,
+                                         std::shared_ptr<AudioOutputConfig> config) override;
+
+  int64_t size() override;
+
+  void clear() override;
+
+ private:
+  struct CacheEntry {
+    int64_t size = 0;
+    // The value of useCounter when the file was last opened, the smallest is evicted first.
+    int64_t lastUse = 0;
+  };
+
+  /**
+   * The content hash of a source file, valid while the file keeps its size and modification time.
+   */
+  struct ContentHash {
+    int64_t size = 0;
+    int64_t modifiedTime = 0;
+    uint64_t hash = 0;
+  };
+
+  std::mutex locker = {};
+  std::string directory;
+  int64_t maxSize = 0;
+  int64_t totalSize = 0;
+  int64_t useCounter = 0;
+  int64_t tempFileCounter = 0;
+  std::unordered_map<std::string, CacheEntry> entries = {};
+  // Keyed by the source path.
+  std::unordered_map<std::string, ContentHash> contentHashes = {};
+
+  FFmpegAudioCache(std::string directory, int64_t maxSize);
+
+  std::string getFilePath(const std::string& fileName) const;
+
+  /**
+   * Returns the name of the cached file of the audio file for the config, which changes whenever
+   * the content or the output config changes, or an empty string if the file can not be read. The
+   * whole file is hashed the first time it is seen, and again only once its size or modification
+   * time changes.
+   */
+  std::string makeCacheFileName(const std::string& path, const AudioOutputConfig& config);
+
+  /**
+   * Marks the file as used, returns false if it is not in the cache.
+   */
+  bool touch(const std::string& fileName);
+
+  void insert(const std::string& fileName, int64_t fileSize);
+
+  void removeEntry(const std::string& fileName);
+
+  /**
+   * Deletes the least recently used files until the cache fits in maxSize, keeping keepFileName.
+   */
+  void evict(const std::string& keepFileName);
+
+  /**
+   * The index file lists the cached files with their sizes and last uses, so the LRU order
+   * survives across processes without scanning the directory.
+   */
+  void loadIndex();
+
+  void saveIndex();
+
+  /**
+   * The hashes file remembers the content hashes of the cached source files, so a new process
+   * does not read them in full again.
+   */
+  void loadContentHashes();
+
+  void saveContentHashes();
+
+  friend FFAudioCache;
+};
+}  // namespace ffmovie
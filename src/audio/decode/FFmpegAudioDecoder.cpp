@@ -17,8 +17,49 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "FFmpegAudioDecoder.h"
+#include <cstring>
+#include "audio/process/AudioKernels.h"
+#include "utils/Executor.h"
+#include "utils/MappedFile.h"
 
 namespace ffmovie {
+#define MAX_SEEK_ATTEMPTS 3
+
+/**
+ * Returns how long before a target the decoding should start for the output at the target to be
+ * exact. Frames of these codecs overlap with or reference the previous frames.
+ */
+static int64_t GetPreRollTime(AVCodecID codecID, int sampleRate) {
+  int64_t preRollSamples = 0;
+  switch (codecID) {
+    case AV_CODEC_ID_AAC:
+      // One frame for the MDCT overlap and one for the encoder priming.
+      preRollSamples = 2048;
+      break;
+    case AV_CODEC_ID_MP3:
+      // The bit reservoir may reference the main data of the previous frames.
+      preRollSamples = 1152 * 2;
+      break;
+    case AV_CODEC_ID_OPUS:
+      // 80ms as recommended by RFC 7845.
+      return 80000;
+    case AV_CODEC_ID_VORBIS:
+      preRollSamples = 4096;
+      break;
+    default:
+      // Every sample of PCM stands alone, the PCM codec IDs fill the range before the ADPCM ones.
+      if (codecID >= AV_CODEC_ID_FIRST_AUDIO && codecID < AV_CODEC_ID_ADPCM_IMA_QT) {
+        return 0;
+      }
+      preRollSamples = 1024;
+      break;
+  }
+  if (sampleRate <= 0) {
+    return 0;
+  }
+  return av_rescale(preRollSamples, AV_TIME_BASE, sampleRate);
+}
+
 std::unique_ptr<FFAudioDecoder> FFAudioDecoder::Make(FFMediaDemuxer* demuxer,
                                                      std::shared_ptr<AudioOutputConfig> config) {
   if (demuxer == nullptr || config == nullptr) {
@@ -31,6 +72,22 @@ std::unique_ptr<FFAudioDecoder> FFAudioDecoder::Make(FFMediaDemuxer* demuxer,
   return decoder;
 }
 
+std::future<std::unique_ptr<FFAudioDecoder>> FFAudioDecoder::MakeAsync(
+    FFMediaDemuxer* demuxer, std::shared_ptr<AudioOutputConfig> config,
+    std::shared_ptr<CancelToken> cancelToken) {
+  return Executor::Shared()->submit(
+      [demuxer, config, cancelToken]() -> std::unique_ptr<FFAudioDecoder> {
+        if (cancelToken && cancelToken->isCancelled()) {
+          return nullptr;
+        }
+        auto decoder = Make(demuxer, config);
+        if (cancelToken && cancelToken->isCancelled()) {
+          return nullptr;
+        }
+        return decoder;
+      });
+}
+
 FFmpegAudioDecoder::~FFmpegAudioDecoder() {
   delete converter;
   avcodec_free_context(&avCodecContext);
@@ -57,42 +114,320 @@ DecoderResult FFmpegAudioDecoder::onSendBytes(void* bytes, size_t length, int64_
 }
 
 DecoderResult FFmpegAudioDecoder::onDecodeFrame() {
-  auto result = avcodec_receive_frame(avCodecContext, frame);
-  if (result == 0 && frame->data[0] != nullptr) {
-    return DecoderResult::Success;
-  } else if (result == AVERROR(EAGAIN)) {
-    return DecoderResult::TryAgainLater;
-  } else if (result == AVERROR_EOF) {
-    return DecoderResult::EndOfStream;
-  } else {
-    return DecoderResult::Error;
+  while (fifo->size() < outputConfig->outputSamplesCount) {
+    if (codecDrained) {
+      if (fifo->size() == 0) {
+        return DecoderResult::EndOfStream;
+      }
+      // The tail of the stream is output as a shorter last chunk.
+      break;
+    }
+    auto result = avcodec_receive_frame(avCodecContext, frame);
+    if (result == 0) {
+      if (frame->data[0] != nullptr && !writeFrame()) {
+        return DecoderResult::Error;
+      }
+    } else if (result == AVERROR(EAGAIN)) {
+      return DecoderResult::TryAgainLater;
+    } else if (result == AVERROR_EOF) {
+      codecDrained = true;
+      if (converter != nullptr && !writeSamples(converter->flush())) {
+        return DecoderResult::Error;
+      }
+    } else {
+      return DecoderResult::Error;
+    }
   }
+  readChunk();
+  return DecoderResult::Success;
 }
 
 void FFmpegAudioDecoder::onFlush() {
   avcodec_flush_buffers(avCodecContext);
+  // The samples left in the FIFO and in the resampler belong to the position before the flush.
+  fifo->clear();
+  delete converter;
+  converter = nullptr;
+  codecDrained = false;
+  inputEnded = false;
+  chunkTime = -1;
 }
 
 SampleData FFmpegAudioDecoder::onRenderFrame() {
+  if (chunkTime < 0) {
+    return {};
+  }
+  return SampleData(chunk.data(), chunkLength);
+}
+
+int64_t FFmpegAudioDecoder::currentPresentationTime() {
+  return chunkTime;
+}
+
+bool FFmpegAudioDecoder::writeFrame() {
+  if (fifo->size() == 0 && frame->pts != AV_NOPTS_VALUE) {
+    fifoBaseTime = frame->pts;
+    fifoConsumedSamples = 0;
+  }
   if (IsSampleConfig(*outputConfig, *frame)) {
-    return SampleData(frame->data[0], frame->linesize[0]);
-  } else {
-    if (converter == nullptr) {
-      converter = new AudioFormatConverter(outputConfig);
+    // linesize may be padded, only nb_samples of it are valid.
+    auto length = SampleCountToLength(frame->nb_samples, outputConfig.get());
+    return writeSamples(SampleData(frame->data[0], length));
+  }
+  if (converter == nullptr) {
+    converter = new AudioFormatConverter(outputConfig);
+  }
+  return writeSamples(converter->convert(frame));
+}
+
+bool FFmpegAudioDecoder::writeSamples(const SampleData& samples) {
+  if (samples.empty()) {
+    return true;
+  }
+  auto count = SampleLengthToCount(static_cast<int64_t>(samples.length), outputConfig.get());
+  return fifo->write(samples.data, static_cast<int>(count));
+}
+
+void FFmpegAudioDecoder::readChunk() {
+  auto chunkSamples = outputConfig->outputSamplesCount;
+  chunkTime =
+      fifoBaseTime + av_rescale(fifoConsumedSamples, AV_TIME_BASE, outputConfig->sampleRate);
+  auto count = fifo->read(chunk.data(), chunkSamples);
+  chunkLength = SampleCountToLength(count, outputConfig.get());
+  fifoConsumedSamples += count;
+}
+
+bool FFmpegAudioDecoder::seekTo(int64_t targetTime) {
+  if (demuxer == nullptr) {
+    return false;
+  }
+  targetTime = std::max(targetTime, static_cast<int64_t>(0));
+  auto preRollTime = GetPreRollTime(avCodecContext->codec_id, avCodecContext->sample_rate);
+  if (!seekDemuxer(targetTime - preRollTime)) {
+    return false;
+  }
+  onFlush();
+  auto sample = demuxer->readSampleData();
+  onSendBytes(sample.data, sample.length, demuxer->getSampleTime());
+  // Decodes the pre-roll and discards everything before targetTime.
+  while (true) {
+    auto result = avcodec_receive_frame(avCodecContext, frame);
+    if (result == 0) {
+      if (frame->data[0] != nullptr && !writeFrame()) {
+        return false;
+      }
+      if (trimFifo(targetTime)) {
+        return true;
+      }
+    } else if (result == AVERROR(EAGAIN)) {
+      if (demuxer->advance()) {
+        sample = demuxer->readSampleData();
+        onSendBytes(sample.data, sample.length, demuxer->getSampleTime());
+      } else {
+        inputEnded = true;
+        onEndOfStream();
+      }
+    } else if (result == AVERROR_EOF) {
+      // targetTime is at the end of the stream, the next decode reports the end of stream.
+      codecDrained = true;
+      if (converter != nullptr) {
+        writeSamples(converter->flush());
+      }
+      trimFifo(targetTime);
+      return true;
+    } else {
+      return false;
     }
-    return converter->convert(frame);
   }
 }
 
-int64_t FFmpegAudioDecoder::currentPresentationTime() {
-  if (frame == nullptr) {
-    return -1;
+SampleData FFmpegAudioDecoder::readNextChunk() {
+  if (demuxer == nullptr) {
+    return {};
+  }
+  while (true) {
+    auto result = onDecodeFrame();
+    if (result == DecoderResult::Success) {
+      return onRenderFrame();
+    }
+    if (result != DecoderResult::TryAgainLater) {
+      return {};
+    }
+    if (demuxer->advance()) {
+      auto sample = demuxer->readSampleData();
+      onSendBytes(sample.data, sample.length, demuxer->getSampleTime());
+    } else if (!inputEnded) {
+      inputEnded = true;
+      onEndOfStream();
+    } else {
+      return {};
+    }
+  }
+}
+
+bool FFmpegAudioDecoder::reachedEndOfStream() const {
+  // The codec returned AVERROR_EOF and every sample it output was rendered.
+  return codecDrained && fifo->size() == 0;
+}
+
+static std::unique_ptr<ByteData> MakeRangeBuffer(size_t length,
+                                                 const std::string& mappedFilePath) {
+  if (mappedFilePath.empty()) {
+    auto data = ByteData::Make(length);
+    return data->length() == length ? std::move(data) : nullptr;
+  }
+  std::shared_ptr<MappedFile> mappedFile = MappedFile::MakeWritable(mappedFilePath, length);
+  if (mappedFile == nullptr) {
+    return nullptr;
+  }
+  // The release callback owns the mapping, the file is unmapped with the ByteData.
+  return ByteData::MakeAdopted(mappedFile->writableData(), length,
+                               [mappedFile](uint8_t*) mutable { mappedFile = nullptr; });
+}
+
+/**
+ * Converts the count s16 samples at the start of data to floats in place. Every float is stored at
+ * twice the offset of its source, so converting blocks from the end never overwrites samples that
+ * are not converted yet.
+ */
+static void WidenS16ToF32InPlace(uint8_t* data, size_t count) {
+  auto src = reinterpret_cast<const int16_t*>(data);
+  auto dst = reinterpret_cast<float*>(data);
+  auto end = count;
+  while (end > 1) {
+    // The output of [start, end) begins at 4 * start bytes, past the input that ends at 2 * end.
+    auto start = (end + 1) / 2;
+    ConvertS16ToF32(src + start, dst + start, end - start);
+    end = start;
+  }
+  if (end == 1) {
+    ConvertS16ToF32(src, dst, 1);
+  }
+}
+
+std::unique_ptr<ByteData> FFmpegAudioDecoder::decodeRange(int64_t startTime, int64_t endTime,
+                                                          AudioSampleFormat format,
+                                                          const std::string& mappedFilePath) {
+  if (demuxer == nullptr || endTime <= startTime) {
+    return nullptr;
+  }
+  auto frameCount = av_rescale(endTime - startTime, outputConfig->sampleRate, AV_TIME_BASE);
+  if (frameCount <= 0) {
+    return nullptr;
+  }
+  auto sampleCount = static_cast<size_t>(frameCount) * outputConfig->channels;
+  auto sampleSize = format == AudioSampleFormat::F32 ? sizeof(float) : sizeof(int16_t);
+  auto output = MakeRangeBuffer(sampleCount * sampleSize, mappedFilePath);
+  if (output == nullptr || !seekTo(startTime)) {
+    return nullptr;
+  }
+  // F32 is decoded as s16 into the first half of the buffer and widened in place at the end, so
+  // no second buffer of the whole range is needed.
+  auto written = decodeInto(output->data(), frameCount);
+  auto frameSize = static_cast<size_t>(SampleCountToLength(1, outputConfig.get()));
+  memset(output->data() + written * frameSize, 0, (frameCount - written) * frameSize);
+  if (format == AudioSampleFormat::F32) {
+    WidenS16ToF32InPlace(output->data(), sampleCount);
+  }
+  // The samples of the last frame after endTime are dropped, the FIFO no longer matches the
+  // position of the demuxer.
+  chunkTime = -1;
+  return output;
+}
+
+int64_t FFmpegAudioDecoder::decodeInto(uint8_t* output, int64_t frameCount) {
+  auto frameSize = SampleCountToLength(1, outputConfig.get());
+  // seekTo() leaves the samples it decoded after the target in the FIFO.
+  auto fifoCount = static_cast<int>(std::min<int64_t>(fifo->size(), frameCount));
+  int64_t written = fifo->read(output, fifoCount);
+  while (written < frameCount && !codecDrained) {
+    auto result = avcodec_receive_frame(avCodecContext, frame);
+    if (result == 0) {
+      if (frame->data[0] != nullptr) {
+        written += writeFrameTo(output + written * frameSize, frameCount - written);
+      }
+    } else if (result == AVERROR(EAGAIN)) {
+      if (demuxer->advance()) {
+        auto sample = demuxer->readSampleData();
+        onSendBytes(sample.data, sample.length, demuxer->getSampleTime());
+      } else if (!inputEnded) {
+        inputEnded = true;
+        onEndOfStream();
+      } else {
+        break;
+      }
+    } else if (result == AVERROR_EOF) {
+      codecDrained = true;
+      if (converter != nullptr) {
+        auto samples = converter->flush();
+        auto count = std::min(SampleLengthToCount(samples.length, outputConfig.get()),
+                              frameCount - written);
+        if (count > 0) {
+          memcpy(output + written * frameSize, samples.data, count * frameSize);
+          written += count;
+        }
+      }
+    } else {
+      break;
+    }
+  }
+  return written;
+}
+
+int FFmpegAudioDecoder::writeFrameTo(uint8_t* output, int64_t capacity) {
+  auto maxCount = static_cast<int>(std::min<int64_t>(capacity, INT32_MAX));
+  if (IsSampleConfig(*outputConfig, *frame)) {
+    auto count = std::min(frame->nb_samples, maxCount);
+    memcpy(output, frame->data[0], SampleCountToLength(count, outputConfig.get()));
+    return count;
+  }
+  if (converter == nullptr) {
+    converter = new AudioFormatConverter(outputConfig);
+  }
+  auto count = converter->convertTo(frame, output, maxCount);
+  if (count >= 0) {
+    return count;
+  }
+  // The frame needs swresample, or it is the last one and goes past the end of the range.
+  auto samples = converter->convert(frame);
+  count = static_cast<int>(
+      std::min<int64_t>(SampleLengthToCount(samples.length, outputConfig.get()), maxCount));
+  if (count > 0) {
+    memcpy(output, samples.data, SampleCountToLength(count, outputConfig.get()));
+  }
+  return count;
+}
+
+bool FFmpegAudioDecoder::seekDemuxer(int64_t seekTime) {
+  auto startTime = std::max(seekTime, static_cast<int64_t>(0));
+  for (int attempt = 0;; attempt++) {
+    if (!demuxer->seekTo(startTime) || !demuxer->advance()) {
+      return false;
+    }
+    auto overshoot = demuxer->getSampleTime() - seekTime;
+    if (overshoot <= 0 || startTime == 0 || attempt + 1 >= MAX_SEEK_ATTEMPTS) {
+      return true;
+    }
+    startTime = std::max(startTime - overshoot * 2, static_cast<int64_t>(0));
+  }
+}
+
+bool FFmpegAudioDecoder::trimFifo(int64_t targetTime) {
+  if (fifo->size() == 0) {
+    return false;
+  }
+  auto fifoStartTime =
+      fifoBaseTime + av_rescale(fifoConsumedSamples, AV_TIME_BASE, outputConfig->sampleRate);
+  if (fifoStartTime < targetTime) {
+    auto dropCount = av_rescale(targetTime - fifoStartTime, outputConfig->sampleRate, AV_TIME_BASE);
+    fifoConsumedSamples += fifo->drain(static_cast<int>(dropCount));
   }
-  return frame->pts;
+  return fifo->size() > 0;
 }
 
 bool FFmpegAudioDecoder::onConfigure(FFMediaDemuxer* demuxer,
                                      std::shared_ptr<AudioOutputConfig> config) {
+  this->demuxer = demuxer;
   auto trackIndex = demuxer->getCurrentTrackIndex();
   auto mediaFormat = demuxer->getTrackFormat(trackIndex);
   auto dec =
@@ -124,8 +459,15 @@ bool FFmpegAudioDecoder::onConfigure(FFMediaDemuxer* demuxer,
   outputConfig = std::make_shared<PCMOutputConfig>();
   outputConfig->channels = config->channels;
   outputConfig->sampleRate = config->sampleRate;
-  outputConfig->outputSamplesCount = config->outputSamplesCount;
+  outputConfig->resampleQuality = config->resampleQuality;
+  outputConfig->outputSamplesCount =
+      config->outputSamplesCount > 0 ? config->outputSamplesCount : DEFAULT_OUTPUT_SAMPLE_COUNT;
   outputConfig->channelLayout = config->channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
+  auto bytesPerSample = av_get_bytes_per_sample(static_cast<AVSampleFormat>(outputConfig->format));
+  // Room for one chunk plus a few codec frames, so the FIFO normally never grows.
+  fifo = std::make_unique<AudioFifo>(outputConfig->channels, bytesPerSample,
+                                     outputConfig->outputSamplesCount * 4);
+  chunk.resize(SampleCountToLength(outputConfig->outputSamplesCount, outputConfig.get()));
   return true;
 }
 
@@ -30,6 +30,7 @@ extern "C" {
 #endif
 
 #include "audio/AudioUtils.h"
+#include "audio/process/AudioFifo.h"
 #include "audio/process/AudioFormatConverter.h"
 #include "ffmovie/movie.h"
 
@@ -52,11 +53,64 @@ class FFmpegAudioDecoder : public FFAudioDecoder {
 
   int64_t currentPresentationTime() override;
 
+  bool seekTo(int64_t targetTime) override;
+
+  SampleData readNextChunk() override;
+
+  bool reachedEndOfStream() const override;
+
+  std::unique_ptr<ByteData> decodeRange(int64_t startTime, int64_t endTime,
+                                        AudioSampleFormat format,
+                                        const std::string& mappedFilePath) override;
+
  private:
   std::shared_ptr<PCMOutputConfig> outputConfig = nullptr;
   AudioFormatConverter* converter = nullptr;
   AVPacket* packet = nullptr;
   AVFrame* frame = nullptr;
   AVCodecContext* avCodecContext = nullptr;
+  FFMediaDemuxer* demuxer = nullptr;
+  // Decoded frames are re-chunked through the FIFO, so every render but the last one outputs
+  // exactly outputSamplesCount samples whatever the frame size of the codec is.
+  std::unique_ptr<AudioFifo> fifo = nullptr;
+  std::vector<uint8_t> chunk = {};
+  // The bytes of chunk holding decoded samples, less than its size only for the last chunk.
+  int64_t chunkLength = 0;
+  // The time of the first sample in the FIFO is fifoBaseTime plus fifoConsumedSamples, counting
+  // samples instead of adding up rounded chunk durations keeps the timestamps from drifting.
+  int64_t fifoBaseTime = 0;
+  int64_t fifoConsumedSamples = 0;
+  int64_t chunkTime = -1;
+  bool codecDrained = false;
+  bool inputEnded = false;
+
+  bool writeFrame();
+
+  bool writeSamples(const SampleData& samples);
+
+  void readChunk();
+
+  /**
+   * Decodes up to frameCount samples from the current position straight into output, bypassing
+   * the FIFO. Returns the number of samples written, which is less at the end of stream.
+   */
+  int64_t decodeInto(uint8_t* output, int64_t frameCount);
+
+  /**
+   * Writes the samples of the current frame that fit in capacity into output, returns how many.
+   */
+  int writeFrameTo(uint8_t* output, int64_t capacity);
+
+  /**
+   * Seeks the demuxer to a sample at or before seekTime and reads it, seeking further back if the
+   * demuxer lands too late, which happens on formats that seek by estimated byte offsets.
+   */
+  bool seekDemuxer(int64_t seekTime);
+
+  /**
+   * Drops the samples before targetTime from the FIFO. Returns true once the FIFO starts at
+   * targetTime or later.
+   */
+  bool trimFifo(int64_t targetTime);
 };
 }  // namespace pag
@@ -0,0 +1,278 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegPCMAudioReader.h"
+#include <algorithm>
+#include <cstring>
+#include "audio/process/AudioFormatConverter.h"
+#include "audio/process/AudioKernels.h"
+
+namespace ffmovie {
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+#define RESAMPLE_EXTRA_SAMPLES 256
+#define MAX_REMIX_CHANNELS 6
+
+static uint16_t ReadLE16(const uint8_t* data) {
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+static uint32_t ReadLE32(const uint8_t* data) {
+  return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+         (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+std::unique_ptr<FFPCMAudioReader> FFPCMAudioReader::Make(
+    const std::string& path, std::shared_ptr<AudioOutputConfig> config) {
+  if (config == nullptr) {
+    return nullptr;
+  }
+  auto file = MappedFile::Make(path);
+  if (file == nullptr) {
+    return nullptr;
+  }
+  WAVInfo info = {};
+  if (!FFmpegPCMAudioReader::ParseWAV(file->data(), file->size(), &info)) {
+    return nullptr;
+  }
+  auto outputConfig = std::make_shared<PCMOutputConfig>();
+  outputConfig->sampleRate = config->sampleRate;
+  outputConfig->channels = config->channels == 2 ? 2 : 1;
+  outputConfig->channelLayout = config->channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
+  outputConfig->outputSamplesCount =
+      config->outputSamplesCount > 0 ? config->outputSamplesCount : DEFAULT_OUTPUT_SAMPLE_COUNT;
+  auto reader = std::unique_ptr<FFmpegPCMAudioReader>(
+      new FFmpegPCMAudioReader(std::move(file), info, std::move(outputConfig)));
+  if (reader->info.sampleRate != reader->outputConfig->sampleRate && !reader->initResampler()) {
+    return nullptr;
+  }
+  return reader;
+}
+
+bool FFmpegPCMAudioReader::ParseWAV(const uint8_t* data, size_t size, WAVInfo* info) {
+  if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  bool hasFormat = false;
+  int formatTag = 0;
+  size_t offset = 12;
+  while (offset + 8 <= size) {
+    auto chunkID = data + offset;
+    size_t chunkSize = ReadLE32(data + offset + 4);
+    auto chunkData = offset + 8;
+    if (memcmp(chunkID, "fmt ", 4) == 0 && chunkSize >= 16 && chunkData + chunkSize <= size) {
+      auto format = data + chunkData;
+      formatTag = ReadLE16(format);
+      info->channels = ReadLE16(format + 2);
+      info->sampleRate = static_cast<int>(ReadLE32(format + 4));
+      info->blockAlign = ReadLE16(format + 12);
+      info->bitsPerSample = ReadLE16(format + 14);
+      if (formatTag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 40) {
+        info->channelMask = ReadLE32(format + 20);
+        // The first two bytes of the sub-format GUID are the actual format tag.
+        formatTag = ReadLE16(format + 24);
+      }
+      hasFormat = true;
+    } else if (memcmp(chunkID, "data", 4) == 0) {
+      info->dataOffset = chunkData;
+      // Streamed WAV files may leave the size unset, the data then runs to the end of the file.
+      info->dataSize = std::min(chunkSize, size - chunkData);
+      break;
+    }
+    // Chunks are padded to an even size.
+    offset = chunkData + chunkSize + (chunkSize & 1);
+  }
+  if (!hasFormat || info->dataOffset == 0 || info->channels <= 0 || info->sampleRate <= 0) {
+    return false;
+  }
+  info->isFloat = formatTag == WAVE_FORMAT_IEEE_FLOAT;
+  auto supported = info->isFloat ? info->bitsPerSample == 32
+                                 : (formatTag == WAVE_FORMAT_PCM &&
+                                    (info->bitsPerSample == 8 || info->bitsPerSample == 16 ||
+                                     info->bitsPerSample == 24 || info->bitsPerSample == 32));
+  // More than two channels are downmixed, which is only defined for 5.1.
+  float matrix[2 * MAX_REMIX_CHANNELS] = {};
+  if (info->channels > 2 && !GetRemixMatrix(info->channels, info->channelMask, 2, matrix)) {
+    return false;
+  }
+  return supported &&
+         info->blockAlign == static_cast<size_t>(info->channels * info->bitsPerSample / 8);
+}
+
+FFmpegPCMAudioReader::FFmpegPCMAudioReader(std::unique_ptr<MappedFile> file, const WAVInfo& info,
+                                           std::shared_ptr<PCMOutputConfig> outputConfig)
+    : file(std::move(file)), info(info), outputConfig(std::move(outputConfig)) {
+  frameCount = static_cast<int64_t>(info.dataSize / info.blockAlign);
+  auto chunkSamples = static_cast<size_t>(this->outputConfig->outputSamplesCount);
+  auto outputChannels = this->outputConfig->channels;
+  formatBuffer.resize(chunkSamples * info.channels);
+  channelBuffer.resize(chunkSamples * outputChannels);
+  if (info.bitsPerSample == 32 && !info.isFloat) {
+    wordBuffer.resize(chunkSamples * info.channels);
+  }
+  size_t floatSamples = info.isFloat ? chunkSamples * info.channels : 0;
+  if (info.channels > 2) {
+    GetRemixMatrix(info.channels, info.channelMask, outputChannels, remixMatrix);
+    floatSamples = chunkSamples * (info.channels + outputChannels);
+  }
+  floatBuffer.resize(floatSamples);
+  chunk.resize(SampleCountToLength(this->outputConfig->outputSamplesCount,
+                                   this->outputConfig.get()));
+}
+
+FFmpegPCMAudioReader::~FFmpegPCMAudioReader() {
+  swr_free(&swrContext);
+}
+
+bool FFmpegPCMAudioReader::initResampler() {
+  // Format and channels are converted by the kernels first, the resampler only changes the rate.
+  swrContext = swr_alloc_set_opts(nullptr, outputConfig->channelLayout, AV_SAMPLE_FMT_S16,
+                                  outputConfig->sampleRate, outputConfig->channelLayout,
+                                  AV_SAMPLE_FMT_S16, info.sampleRate, 0, nullptr);
+  if (swrContext == nullptr || swr_init(swrContext) < 0) {
+    return false;
+  }
+  auto chunkSamples = outputConfig->outputSamplesCount;
+  // One chunk of input at most, plus room for the delay of the filter.
+  resampleCapacity = static_cast<int>(
+      av_rescale_rnd(chunkSamples, outputConfig->sampleRate, info.sampleRate, AV_ROUND_UP) +
+      RESAMPLE_EXTRA_SAMPLES);
+  resampleBuffer.resize(SampleCountToLength(resampleCapacity, outputConfig.get()));
+  fifo = std::make_unique<AudioFifo>(outputConfig->channels, 2, resampleCapacity + chunkSamples);
+  return true;
+}
+
+int64_t FFmpegPCMAudioReader::duration() const {
+  return av_rescale(frameCount, AV_TIME_BASE, info.sampleRate);
+}
+
+bool FFmpegPCMAudioReader::seekTo(int64_t targetTime) {
+  auto frameIndex = av_rescale(std::max(targetTime, static_cast<int64_t>(0)), info.sampleRate,
+                               AV_TIME_BASE);
+  position = std::min(frameIndex, frameCount);
+  baseTime = std::max(targetTime, static_cast<int64_t>(0));
+  emittedSamples = 0;
+  chunkTime = -1;
+  if (swrContext != nullptr) {
+    // Re-initializing drops the samples the resampler kept from the old position.
+    fifo->clear();
+    resamplerDrained = false;
+    return swr_init(swrContext) >= 0;
+  }
+  return true;
+}
+
+const int16_t* FFmpegPCMAudioReader::convertFrames(int64_t start, size_t count) {
+  auto src = file->data() + info.dataOffset + start * info.blockAlign;
+  auto sampleCount = count * info.channels;
+  // WAV chunks are word aligned, so the 16-bit samples can be read in place. The 32-bit ones are
+  // copied out first, the data is not guaranteed to be aligned for them.
+  auto samples = reinterpret_cast<const int16_t*>(src);
+  if (info.isFloat) {
+    memcpy(floatBuffer.data(), src, sampleCount * sizeof(float));
+    ConvertF32ToS16(floatBuffer.data(), formatBuffer.data(), sampleCount);
+    samples = formatBuffer.data();
+  } else if (info.bitsPerSample == 8) {
+    ConvertU8ToS16(src, formatBuffer.data(), sampleCount);
+    samples = formatBuffer.data();
+  } else if (info.bitsPerSample == 24) {
+    ConvertS24ToS16(src, formatBuffer.data(), sampleCount);
+    samples = formatBuffer.data();
+  } else if (info.bitsPerSample == 32) {
+    memcpy(wordBuffer.data(), src, sampleCount * sizeof(int32_t));
+    ConvertS32ToS16(wordBuffer.data(), formatBuffer.data(), sampleCount);
+    samples = formatBuffer.data();
+  }
+  if (info.channels == outputConfig->channels) {
+    return samples;
+  }
+  if (info.channels > 2) {
+    // Downmixed in float planes with the same matrix as the decoded audio.
+    float* inputPlanes[MAX_REMIX_CHANNELS] = {};
+    float* outputPlanes[2] = {};
+    for (int channel = 0; channel < info.channels; channel++) {
+      inputPlanes[channel] = floatBuffer.data() + channel * count;
+    }
+    for (int channel = 0; channel < outputConfig->channels; channel++) {
+      outputPlanes[channel] = floatBuffer.data() + (info.channels + channel) * count;
+    }
+    DeinterleaveS16ToF32(samples, info.channels, inputPlanes, count);
+    RemixF32(inputPlanes, info.channels, outputPlanes, outputConfig->channels, remixMatrix, count);
+    InterleaveF32ToS16(outputPlanes, outputConfig->channels, channelBuffer.data(), count);
+  } else if (info.channels == 1) {
+    ConvertMonoToStereoS16(samples, channelBuffer.data(), count);
+  } else {
+    ConvertToMonoS16(samples, info.channels, channelBuffer.data(), count);
+  }
+  return channelBuffer.data();
+}
+
+SampleData FFmpegPCMAudioReader::readNextChunk() {
+  auto chunkSamples = outputConfig->outputSamplesCount;
+  if (swrContext == nullptr) {
+    auto count = static_cast<int>(
+        std::min(static_cast<int64_t>(chunkSamples), frameCount - position));
+    if (count <= 0) {
+      return {};
+    }
+    auto samples = convertFrames(position, static_cast<size_t>(count));
+    memcpy(chunk.data(), samples, SampleCountToLength(count, outputConfig.get()));
+    position += count;
+    return finishChunk(count);
+  }
+  auto output = resampleBuffer.data();
+  while (fifo->size() < chunkSamples && !resamplerDrained) {
+    auto count = static_cast<int>(
+        std::min(static_cast<int64_t>(chunkSamples), frameCount - position));
+    int converted = 0;
+    if (count > 0) {
+      auto input = reinterpret_cast<const uint8_t*>(convertFrames(position, count));
+      position += count;
+      converted = swr_convert(swrContext, &output, resampleCapacity, &input, count);
+    } else {
+      // Drains the samples the resampler still holds at the end of the data.
+      converted = swr_convert(swrContext, &output, resampleCapacity, nullptr, 0);
+      resamplerDrained = converted <= 0;
+    }
+    if (converted > 0) {
+      fifo->write(output, converted);
+    }
+  }
+  auto count = fifo->read(chunk.data(), chunkSamples);
+  if (count <= 0) {
+    return {};
+  }
+  return finishChunk(count);
+}
+
+SampleData FFmpegPCMAudioReader::finishChunk(int count) {
+  auto chunkSamples = outputConfig->outputSamplesCount;
+  if (count < chunkSamples) {
+    auto offset = SampleCountToLength(count, outputConfig.get());
+    memset(chunk.data() + offset, 0, chunk.size() - offset);
+  }
+  chunkTime = baseTime + av_rescale(emittedSamples, AV_TIME_BASE, outputConfig->sampleRate);
+  emittedSamples += count;
+  return SampleData(chunk.data(), static_cast<int64_t>(chunk.size()));
+}
+
+int64_t FFmpegPCMAudioReader::currentPresentationTime() {
+  return chunkTime;
+}
+}  // namespace ffmovie
@@ -0,0 +1,108 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libswresample/swresample.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include "audio/AudioUtils.h"
+#include "audio/process/AudioFifo.h"
+#include "ffmovie/movie.h"
+#include "utils/MappedFile.h"
+
+namespace ffmovie {
+/**
+ * The format of a WAV file, parsed from its fmt and data chunks.
+ */
+struct WAVInfo {
+  int channels = 0;
+  int sampleRate = 0;
+  int bitsPerSample = 0;
+  bool isFloat = false;
+  // The speaker positions of WAVE_FORMAT_EXTENSIBLE files, 0 for the default layout.
+  uint64_t channelMask = 0;
+  size_t blockAlign = 0;
+  size_t dataOffset = 0;
+  size_t dataSize = 0;
+};
+
+class FFmpegPCMAudioReader : public FFPCMAudioReader {
+ public:
+  /**
+   * Returns false if the data is not a WAV file that FFmpegPCMAudioReader supports.
+   */
+  static bool ParseWAV(const uint8_t* data, size_t size, WAVInfo* info);
+
+  ~FFmpegPCMAudioReader() override;
+
+  int64_t duration() const override;
+
+  bool seekTo(int64_t targetTime) override;
+
+  SampleData readNextChunk() override;
+
+  int64_t currentPresentationTime() override;
+
+ private:
+  std::unique_ptr<MappedFile> file = nullptr;
+  WAVInfo info = {};
+  std::shared_ptr<PCMOutputConfig> outputConfig = nullptr;
+  int64_t frameCount = 0;
+  int64_t position = 0;
+  // Conversion buffers for one chunk, allocated once.
+  std::vector<int16_t> formatBuffer = {};
+  std::vector<int16_t> channelBuffer = {};
+  std::vector<int32_t> wordBuffer = {};
+  std::vector<float> floatBuffer = {};
+  // Only used to downmix 5.1 files.
+  float remixMatrix[12] = {};
+  std::vector<uint8_t> chunk = {};
+  // Only created if the sample rate differs, the FIFO re-chunks the resampled output.
+  SwrContext* swrContext = nullptr;
+  std::vector<uint8_t> resampleBuffer = {};
+  int resampleCapacity = 0;
+  std::unique_ptr<AudioFifo> fifo = nullptr;
+  bool resamplerDrained = false;
+  int64_t baseTime = 0;
+  int64_t emittedSamples = 0;
+  int64_t chunkTime = -1;
+
+  FFmpegPCMAudioReader(std::unique_ptr<MappedFile> file, const WAVInfo& info,
+                       std::shared_ptr<PCMOutputConfig> outputConfig);
+
+  bool initResampler();
+
+  /**
+   * Converts count frames from position to signed 16-bit samples with the output channels.
+   * Returns a pointer to them, which is either the mapped file itself or one of the buffers.
+   */
+  const int16_t* convertFrames(int64_t start, size_t count);
+
+  SampleData finishChunk(int count);
+
+  friend FFPCMAudioReader;
+};
+}  // namespace ffmovie
@@ -0,0 +1,300 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AudioPacketIndexer.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "utils/Executor.h"
+
+namespace ffmovie {
+#define INDEX_ENTRY_INTERVAL 100000
+#define SCAN_BLOCK_SIZE (256 * 1024)
+// Enough for the frame header and the Xing/Info/VBRI tag of the first MP3 frame.
+#define HEADER_PEEK_SIZE 40
+#define ID3V2_HEADER_SIZE 10
+#define INDEX_FILE_VERSION 1
+
+static const char IndexFileMagic[4] = {'F', 'F', 'A', 'I'};
+
+struct FrameHeader {
+  int frameLength = 0;
+  int sampleRate = 0;
+  int sampleCount = 0;
+  // The offset of the Xing/Info tag if this is the first frame of a VBR MP3.
+  int tagOffset = 0;
+};
+
+static const int MP3SampleRates[3] = {44100, 48000, 32000};
+
+static const int MP3BitRates[5][15] = {
+    {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},  // MPEG1 Layer1
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},     // MPEG1 Layer2
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},      // MPEG1 Layer3
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},     // MPEG2 Layer1
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},          // MPEG2 Layer2/3
+};
+
+static const int ADTSSampleRates[13] = {96000, 88200, 64000, 48000, 44100, 32000, 24000,
+                                        22050, 16000, 12000, 11025, 8000,  7350};
+
+static bool ParseMP3Header(const uint8_t* data, FrameHeader* header) {
+  uint32_t bits = (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
+  if ((bits >> 21) != 0x7FF) {
+    return false;
+  }
+  auto version = (bits >> 19) & 3;  // 0: MPEG2.5, 1: reserved, 2: MPEG2, 3: MPEG1
+  auto layer = (bits >> 17) & 3;    // 1: Layer3, 2: Layer2, 3: Layer1
+  auto bitRateIndex = (bits >> 12) & 0xF;
+  auto sampleRateIndex = (bits >> 10) & 3;
+  auto padding = static_cast<int>((bits >> 9) & 1);
+  auto mono = ((bits >> 6) & 3) == 3;
+  // Free format frames can not be measured from the header.
+  if (version == 1 || layer == 0 || bitRateIndex == 0 || bitRateIndex == 15 ||
+      sampleRateIndex == 3) {
+    return false;
+  }
+  auto mpeg1 = version == 3;
+  header->sampleRate = MP3SampleRates[sampleRateIndex] >> (mpeg1 ? 0 : (version == 2 ? 1 : 2));
+  int table = mpeg1 ? static_cast<int>(3 - layer) : (layer == 3 ? 3 : 4);
+  auto bitRate = MP3BitRates[table][bitRateIndex] * 1000;
+  if (layer == 3) {
+    header->sampleCount = 384;
+    header->frameLength = (12 * bitRate / header->sampleRate + padding) * 4;
+  } else if (layer == 2 || mpeg1) {
+    header->sampleCount = 1152;
+    header->frameLength = 144 * bitRate / header->sampleRate + padding;
+  } else {
+    header->sampleCount = 576;
+    header->frameLength = 72 * bitRate / header->sampleRate + padding;
+  }
+  auto sideInfoSize = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+  header->tagOffset = layer == 1 ? 4 + sideInfoSize : 0;
+  return header->frameLength > 4;
+}
+
+static bool ParseADTSHeader(const uint8_t* data, FrameHeader* header) {
+  if (data[0] != 0xFF || (data[1] & 0xF6) != 0xF0) {
+    return false;
+  }
+  auto sampleRateIndex = (data[2] >> 2) & 0xF;
+  if (sampleRateIndex >= 13) {
+    return false;
+  }
+  header->sampleRate = ADTSSampleRates[sampleRateIndex];
+  header->frameLength = ((data[3] & 3) << 11) | (data[4] << 3) | (data[5] >> 5);
+  header->sampleCount = 1024 * ((data[6] & 3) + 1);
+  header->tagOffset = 0;
+  return header->frameLength > 7;
+}
+
+static bool ParseFrameHeader(AudioStreamType streamType, const uint8_t* data, int64_t length,
+                             FrameHeader* header) {
+  if (streamType == AudioStreamType::MP3) {
+    return length >= 4 && ParseMP3Header(data, header);
+  }
+  return length >= 7 && ParseADTSHeader(data, header);
+}
+
+/**
+ * Returns true if the first frame only carries the Xing/Info/VBRI tag of a VBR MP3, which FFmpeg
+ * does not output as a packet.
+ */
+static bool IsTagFrame(const uint8_t* data, int64_t length, const FrameHeader& header) {
+  auto matches = [data, length](int64_t offset, const char* tag) {
+    return offset + 4 <= length && memcmp(data + offset, tag, 4) == 0;
+  };
+  return matches(header.tagOffset, "Xing") || matches(header.tagOffset, "Info") ||
+         matches(36, "VBRI");
+}
+
+AudioPacketIndexer::AudioPacketIndexer(AudioStreamType streamType, int64_t fileSize,
+                                       ReadCallback readCallback, std::string indexPath)
+    : streamType(streamType), fileSize(fileSize), readCallback(std::move(readCallback)),
+      indexPath(std::move(indexPath)) {
+}
+
+AudioPacketIndexer::~AudioPacketIndexer() {
+  cancelled = true;
+  if (scanTask.valid()) {
+    scanTask.wait();
+  }
+}
+
+void AudioPacketIndexer::start() {
+  if (scanTask.valid() || loadIndex()) {
+    return;
+  }
+  scanTask = Executor::Shared()->submit([this]() { scan(); });
+}
+
+bool AudioPacketIndexer::getEntries(size_t from, std::vector<AudioIndexEntry>* result) {
+  std::lock_guard<std::mutex> autoLock(locker);
+  if (from < entries.size()) {
+    result->insert(result->end(), entries.begin() + static_cast<int64_t>(from), entries.end());
+  }
+  return finished;
+}
+
+void AudioPacketIndexer::addEntry(const AudioIndexEntry& entry) {
+  std::lock_guard<std::mutex> autoLock(locker);
+  entries.push_back(entry);
+}
+
+void AudioPacketIndexer::scan() {
+  std::vector<uint8_t> block(SCAN_BLOCK_SIZE);
+  int64_t blockOffset = 0;
+  int64_t blockLength = 0;
+  // Returns the bytes at [offset, offset + length), reading a new block only if they are not in
+  // the current one. Frames are short, so most headers come from the block already read.
+  auto fetch = [&](int64_t offset, int64_t length) -> const uint8_t* {
+    if (offset < blockOffset || offset + length > blockOffset + blockLength) {
+      blockOffset = offset;
+      blockLength = static_cast<int64_t>(readCallback(offset, block.data(), block.size()));
+      if (blockLength < length) {
+        return nullptr;
+      }
+    }
+    return block.data() + (offset - blockOffset);
+  };
+
+  int64_t offset = 0;
+  auto data = fetch(0, ID3V2_HEADER_SIZE);
+  if (data != nullptr && memcmp(data, "ID3", 3) == 0) {
+    auto tagSize = ((data[6] & 0x7F) << 21) | ((data[7] & 0x7F) << 14) |
+                   ((data[8] & 0x7F) << 7) | (data[9] & 0x7F);
+    offset = ID3V2_HEADER_SIZE + tagSize + ((data[5] & 0x10) ? ID3V2_HEADER_SIZE : 0);
+  }
+  int64_t sampleCount = 0;
+  int sampleRate = 0;
+  int64_t lastEntryTime = INT64_MIN;
+  bool synced = false;
+  bool firstFrame = true;
+  while (!cancelled && offset + 4 <= fileSize) {
+    auto peekLength = std::min(static_cast<int64_t>(HEADER_PEEK_SIZE), fileSize - offset);
+    data = fetch(offset, peekLength);
+    if (data == nullptr) {
+      break;
+    }
+    FrameHeader header = {};
+    if (!ParseFrameHeader(streamType, data, peekLength, &header) ||
+        (sampleRate != 0 && header.sampleRate != sampleRate)) {
+      // Garbage or a false sync, search for the next frame byte by byte.
+      synced = false;
+      offset++;
+      continue;
+    }
+    if (firstFrame && streamType == AudioStreamType::MP3 && IsTagFrame(data, peekLength, header)) {
+      firstFrame = false;
+      offset += header.frameLength;
+      continue;
+    }
+    if (!synced) {
+      // After losing the sync, a header only counts if the next frame starts right after it.
+      auto nextOffset = offset + header.frameLength;
+      if (nextOffset + 4 <= fileSize) {
+        auto nextLength = std::min(static_cast<int64_t>(HEADER_PEEK_SIZE), fileSize - nextOffset);
+        auto nextData = fetch(nextOffset, nextLength);
+        FrameHeader nextHeader = {};
+        if (nextData == nullptr ||
+            !ParseFrameHeader(streamType, nextData, nextLength, &nextHeader) ||
+            nextHeader.sampleRate != header.sampleRate) {
+          offset++;
+          continue;
+        }
+      }
+      synced = true;
+    }
+    firstFrame = false;
+    if (sampleRate == 0) {
+      sampleRate = header.sampleRate;
+    }
+    auto time = sampleCount * 1000000 / sampleRate;
+    if (lastEntryTime == INT64_MIN || time - lastEntryTime >= INDEX_ENTRY_INTERVAL) {
+      addEntry({time, offset});
+      lastEntryTime = time;
+    }
+    sampleCount += header.sampleCount;
+    offset += header.frameLength;
+  }
+  if (cancelled) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    finished = true;
+  }
+  saveIndex();
+}
+
+bool AudioPacketIndexer::loadIndex() {
+  if (indexPath.empty()) {
+    return false;
+  }
+  auto file = fopen(indexPath.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  char magic[4] = {};
+  int32_t version = 0;
+  int64_t indexedFileSize = 0;
+  uint64_t count = 0;
+  auto valid = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+               memcmp(magic, IndexFileMagic, sizeof(magic)) == 0 &&
+               fread(&version, sizeof(version), 1, file) == 1 && version == INDEX_FILE_VERSION &&
+               fread(&indexedFileSize, sizeof(indexedFileSize), 1, file) == 1 &&
+               indexedFileSize == fileSize && fread(&count, sizeof(count), 1, file) == 1 &&
+               count <= static_cast<uint64_t>(fileSize);
+  std::vector<AudioIndexEntry> loadedEntries = {};
+  if (valid) {
+    loadedEntries.resize(count);
+    valid = fread(loadedEntries.data(), sizeof(AudioIndexEntry), count, file) == count;
+  }
+  fclose(file);
+  if (!valid) {
+    return false;
+  }
+  std::lock_guard<std::mutex> autoLock(locker);
+  entries = std::move(loadedEntries);
+  finished = true;
+  return true;
+}
+
+void AudioPacketIndexer::saveIndex() {
+  if (indexPath.empty()) {
+    return;
+  }
+  auto file = fopen(indexPath.c_str(), "wb");
+  if (file == nullptr) {
+    return;
+  }
+  int32_t version = INDEX_FILE_VERSION;
+  uint64_t count = entries.size();
+  auto written =
+      fwrite(IndexFileMagic, 1, sizeof(IndexFileMagic), file) == sizeof(IndexFileMagic) &&
+      fwrite(&version, sizeof(version), 1, file) == 1 &&
+      fwrite(&fileSize, sizeof(fileSize), 1, file) == 1 &&
+      fwrite(&count, sizeof(count), 1, file) == 1 &&
+      fwrite(entries.data(), sizeof(AudioIndexEntry), count, file) == count;
+  fclose(file);
+  if (!written) {
+    // A truncated index would be rejected anyway, do not leave it around.
+    remove(indexPath.c_str());
+  }
+}
+}  // namespace ffmovie
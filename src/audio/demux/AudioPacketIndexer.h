@@ -0,0 +1,103 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ffmovie {
+/**
+ * A point of an audio stream where decoding can start: the time in microseconds of the frame
+ * beginning at the byte offset.
+ */
+struct AudioIndexEntry {
+  int64_t time = 0;
+  int64_t offset = 0;
+};
+
+enum class AudioStreamType {
+  MP3,
+  ADTS,
+};
+
+/**
+ * AudioPacketIndexer builds the time to byte offset table of a raw MP3 or ADTS AAC stream, which
+ * FFmpeg can only seek by estimating from the bitrate. It parses frame headers only, without
+ * decoding, on the shared executor, and the entries can be taken while it is still running. The
+ * table is compact, one entry per INDEX_ENTRY_INTERVAL of audio.
+ */
+class AudioPacketIndexer {
+ public:
+  /**
+   * Reads at most length bytes at offset of the stream, returns the number of bytes read.
+   */
+  using ReadCallback = std::function<size_t(int64_t offset, uint8_t* data, size_t length)>;
+
+  /**
+   * Creates an indexer for a stream of fileSize bytes.
+   * @param indexPath The file to load the index from if it matches the stream, and to save the
+   * finished index to. Empty to keep the index in memory only.
+   */
+  AudioPacketIndexer(AudioStreamType streamType, int64_t fileSize, ReadCallback readCallback,
+                     std::string indexPath);
+
+  /**
+   * Cancels the scanning and waits for it to stop, since it still uses the read callback.
+   */
+  ~AudioPacketIndexer();
+
+  AudioPacketIndexer(const AudioPacketIndexer&) = delete;
+
+  AudioPacketIndexer& operator=(const AudioPacketIndexer&) = delete;
+
+  /**
+   * Loads the saved index, or starts scanning in the background if there is none.
+   */
+  void start();
+
+  /**
+   * Appends the entries after the first `from` ones to entries. Returns true if the index is
+   * complete.
+   */
+  bool getEntries(size_t from, std::vector<AudioIndexEntry>* entries);
+
+ private:
+  AudioStreamType streamType = AudioStreamType::MP3;
+  int64_t fileSize = 0;
+  ReadCallback readCallback = nullptr;
+  std::string indexPath;
+  std::mutex locker = {};
+  std::vector<AudioIndexEntry> entries = {};
+  bool finished = false;
+  std::atomic<bool> cancelled{false};
+  std::future<void> scanTask = {};
+
+  void scan();
+
+  void addEntry(const AudioIndexEntry& entry);
+
+  bool loadIndex();
+
+  void saveIndex();
+};
+}  // namespace ffmovie
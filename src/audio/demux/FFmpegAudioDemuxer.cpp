@@ -17,29 +17,71 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "FFmpegAudioDemuxer.h"
+#include <cstring>
+#include "utils/Executor.h"
 #include "utils/FFmpegUtils.h"
 
 namespace ffmovie {
 
 static const AVRational TimeBaseQ = {1, AV_TIME_BASE};
 
-std::unique_ptr<FFAudioDemuxer> FFAudioDemuxer::Make(const std::string& path) {
+/**
+ * The open path shared by Make() and MakeAsync(). openInput opens the new demuxer, the token is
+ * checked before and after it so a cancelled open never returns a demuxer.
+ */
+template <typename OpenInput>
+static std::unique_ptr<FFAudioDemuxer> OpenDemuxer(CancelToken* cancelToken,
+                                                   const OpenInput& openInput) {
+  if (cancelToken != nullptr && cancelToken->isCancelled()) {
+    return nullptr;
+  }
   auto demuxer = std::unique_ptr<FFmpegAudioDemuxer>(new FFmpegAudioDemuxer());
-  if (demuxer->open(path) < 0) {
+  if (openInput(demuxer.get()) < 0) {
+    return nullptr;
+  }
+  if (cancelToken != nullptr && cancelToken->isCancelled()) {
     return nullptr;
   }
   return demuxer;
 }
 
+static std::unique_ptr<FFAudioDemuxer> OpenDemuxer(const std::string& path,
+                                                   CancelToken* cancelToken) {
+  return OpenDemuxer(cancelToken, [&](FFmpegAudioDemuxer* demuxer) {
+    return demuxer->open(path, cancelToken);
+  });
+}
+
+static std::unique_ptr<FFAudioDemuxer> OpenDemuxer(uint8_t* data, size_t length,
+                                                   CancelToken* cancelToken) {
+  return OpenDemuxer(cancelToken, [&](FFmpegAudioDemuxer* demuxer) {
+    return demuxer->open(data, length, cancelToken);
+  });
+}
+
+std::unique_ptr<FFAudioDemuxer> FFAudioDemuxer::Make(const std::string& path) {
+  return OpenDemuxer(path, nullptr);
+}
+
 std::unique_ptr<FFAudioDemuxer> FFAudioDemuxer::Make(uint8_t* data, size_t length) {
-  auto demuxer = std::unique_ptr<FFmpegAudioDemuxer>(new FFmpegAudioDemuxer());
-  if (demuxer->open(data, length) < 0) {
-    return nullptr;
-  }
-  return demuxer;
+  return OpenDemuxer(data, length, nullptr);
+}
+
+std::future<std::unique_ptr<FFAudioDemuxer>> FFAudioDemuxer::MakeAsync(
+    const std::string& path, std::shared_ptr<CancelToken> cancelToken) {
+  return Executor::Shared()->submit(
+      [path, cancelToken]() { return OpenDemuxer(path, cancelToken.get()); });
+}
+
+std::future<std::unique_ptr<FFAudioDemuxer>> FFAudioDemuxer::MakeAsync(
+    uint8_t* data, size_t length, std::shared_ptr<CancelToken> cancelToken) {
+  return Executor::Shared()->submit(
+      [data, length, cancelToken]() { return OpenDemuxer(data, length, cancelToken.get()); });
 }
 
 FFmpegAudioDemuxer::~FFmpegAudioDemuxer() {
+  // The indexer may still be reading the data.
+  indexer = nullptr;
   av_packet_unref(&avPacket);
   avformat_close_input(&fmtCtx);
   if (avioCtx) {
@@ -80,6 +122,7 @@ bool FFmpegAudioDemuxer::seekTo(int64_t timestamp) {
   if (currentStreamIndex < 0) {
     return false;
   }
+  installIndexEntries();
   auto time_base = fmtCtx->streams[currentStreamIndex]->time_base;
   auto pos = av_rescale_q(timestamp, TimeBaseQ, time_base);
   auto ret = av_seek_frame(fmtCtx, currentStreamIndex, pos, AVSEEK_FLAG_ANY | AVSEEK_FLAG_BACKWARD);
@@ -172,19 +215,28 @@ MediaFormat* FFmpegAudioDemuxer::getTrackFormatInternal(unsigned int index) {
   return trackFormat;
 }
 
-int FFmpegAudioDemuxer::open(const std::string& path) {
+int FFmpegAudioDemuxer::open(const std::string& path, CancelToken* cancelToken) {
+  filePath = path;
+  fmtCtx = avformat_alloc_context();
+  if (fmtCtx == nullptr) {
+    return -1;
+  }
+  fmtCtx->interrupt_callback = MakeInterruptCallback(cancelToken);
   auto ret = avformat_open_input(&fmtCtx, path.c_str(), nullptr, nullptr);
   if (ret < 0) {
     // LOGE("Could not open source file %s, %s\n", path, av_err2str(ret));
     return -2;
   }
-  if (avformat_find_stream_info(fmtCtx, nullptr) < 0) {
+  ret = avformat_find_stream_info(fmtCtx, nullptr);
+  // The token only guards opening, reading afterwards must not be aborted by a late cancel().
+  fmtCtx->interrupt_callback = {nullptr, nullptr};
+  if (ret < 0) {
     return -3;
   }
   return 0;
 }
 
-int FFmpegAudioDemuxer::open(uint8_t* data, size_t length) {
+int FFmpegAudioDemuxer::open(uint8_t* data, size_t length, CancelToken* cancelToken) {
   bufferData.originPtr = data;
   bufferData.fileSize = length;
   bufferData.ptr = data;
@@ -201,10 +253,13 @@ int FFmpegAudioDemuxer::open(uint8_t* data, size_t length) {
   fmtCtx = avformat_alloc_context();
   fmtCtx->pb = avioCtx;
   fmtCtx->avio_flags = AVFMT_FLAG_CUSTOM_IO;
+  fmtCtx->interrupt_callback = MakeInterruptCallback(cancelToken);
   if (avformat_open_input(&fmtCtx, "", nullptr, nullptr) < 0) {
     return -2;
   }
-  if (avformat_find_stream_info(fmtCtx, nullptr) < 0) {
+  auto ret = avformat_find_stream_info(fmtCtx, nullptr);
+  fmtCtx->interrupt_callback = {nullptr, nullptr};
+  if (ret < 0) {
     return -3;
   }
   return 0;
@@ -213,4 +268,91 @@ int FFmpegAudioDemuxer::open(uint8_t* data, size_t length) {
 int FFmpegAudioDemuxer::getCurrentTrackIndex() {
   return currentStreamIndex;
 }
+
+bool FFmpegAudioDemuxer::startIndexing(const std::string& indexPath) {
+  if (indexer != nullptr) {
+    return true;
+  }
+  if (fmtCtx == nullptr || fmtCtx->iformat == nullptr) {
+    return false;
+  }
+  // Only the raw streams lack an index, containers such as MP4 and WAV already seek exactly.
+  AudioStreamType streamType;
+  if (strcmp(fmtCtx->iformat->name, "mp3") == 0) {
+    streamType = AudioStreamType::MP3;
+  } else if (strcmp(fmtCtx->iformat->name, "aac") == 0) {
+    streamType = AudioStreamType::ADTS;
+  } else {
+    return false;
+  }
+  indexStreamIndex = av_find_best_stream(fmtCtx, AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+  auto fileSize = fmtCtx->pb != nullptr ? avio_size(fmtCtx->pb) : -1;
+  if (indexStreamIndex < 0 || fileSize <= 0) {
+    return false;
+  }
+  AudioPacketIndexer::ReadCallback readCallback = nullptr;
+  if (avioCtx != nullptr) {
+    auto data = bufferData.originPtr;
+    auto dataSize = static_cast<int64_t>(bufferData.fileSize);
+    readCallback = [data, dataSize](int64_t offset, uint8_t* buffer, size_t length) -> size_t {
+      auto count = std::min(static_cast<int64_t>(length), dataSize - offset);
+      if (count <= 0) {
+        return 0;
+      }
+      memcpy(buffer, data + offset, count);
+      return static_cast<size_t>(count);
+    };
+  } else {
+    // The indexer reads with its own file handle, the AVIOContext belongs to this thread.
+    auto file = std::shared_ptr<FILE>(fopen(filePath.c_str(), "rb"), [](FILE* handle) {
+      if (handle != nullptr) {
+        fclose(handle);
+      }
+    });
+    if (file == nullptr) {
+      return false;
+    }
+    readCallback = [file](int64_t offset, uint8_t* buffer, size_t length) -> size_t {
+      if (fseek(file.get(), static_cast<long>(offset), SEEK_SET) != 0) {
+        return 0;
+      }
+      return fread(buffer, 1, length, file.get());
+    };
+  }
+  indexer = std::make_unique<AudioPacketIndexer>(streamType, fileSize, std::move(readCallback),
+                                                 indexPath);
+  indexer->start();
+  return true;
+}
+
+bool FFmpegAudioDemuxer::hasPacketIndex() {
+  if (fmtCtx == nullptr || fmtCtx->iformat == nullptr) {
+    return false;
+  }
+  if (strcmp(fmtCtx->iformat->name, "mp3") != 0 && strcmp(fmtCtx->iformat->name, "aac") != 0) {
+    return true;
+  }
+  installIndexEntries();
+  return indexFinished;
+}
+
+void FFmpegAudioDemuxer::installIndexEntries() {
+  if (indexer == nullptr || indexFinished) {
+    return;
+  }
+  std::vector<AudioIndexEntry> entries = {};
+  indexFinished = indexer->getEntries(indexedEntryCount, &entries);
+  if (entries.empty()) {
+    return;
+  }
+  indexedEntryCount += entries.size();
+  auto stream = fmtCtx->streams[indexStreamIndex];
+  // Keeps FFmpeg from thinning out the index while reading packets.
+  auto indexSize = static_cast<unsigned int>(indexedEntryCount * sizeof(AVIndexEntry) * 2);
+  fmtCtx->max_index_size = std::max(fmtCtx->max_index_size, indexSize);
+  for (auto& entry : entries) {
+    auto timestamp = av_rescale_q(entry.time, TimeBaseQ, stream->time_base);
+    av_add_index_entry(stream, entry.offset, timestamp, 0, 0, AVINDEX_KEYFRAME);
+  }
+}
 }  // namespace ffmovie
\ No newline at end of file
@@ -28,6 +28,7 @@ extern "C" {
 }
 #endif
 
+#include "audio/demux/AudioPacketIndexer.h"
 #include "ffmovie/movie.h"
 
 namespace ffmovie {
@@ -52,9 +53,20 @@ class FFmpegAudioDemuxer : public FFAudioDemuxer {
 
   int getCurrentTrackIndex() override;
 
-  int open(const std::string& path);
+  bool startIndexing(const std::string& indexPath) override;
 
-  int open(uint8_t* data, size_t length);
+  /**
+   * Returns true if seeks land on exact packets, that is the input is a container with its own
+   * index, or a raw MP3 or ADTS stream whose index from startIndexing() is complete.
+   */
+  bool hasPacketIndex();
+
+  /**
+   * Opens the input, the blocking I/O of opening is aborted once the cancelToken is cancelled.
+   */
+  int open(const std::string& path, CancelToken* cancelToken = nullptr);
+
+  int open(uint8_t* data, size_t length, CancelToken* cancelToken = nullptr);
 
   struct BufferData {
     uint8_t* ptr = nullptr;  // 文件中对应位置指针
@@ -70,7 +82,18 @@ class FFmpegAudioDemuxer : public FFAudioDemuxer {
   AVFormatContext* fmtCtx = nullptr;
   AVPacket avPacket{};
   std::unordered_map<unsigned int, MediaFormat*> formats{};
+  std::string filePath;
+  std::unique_ptr<AudioPacketIndexer> indexer = nullptr;
+  int indexStreamIndex = -1;
+  size_t indexedEntryCount = 0;
+  bool indexFinished = false;
 
   MediaFormat* getTrackFormatInternal(unsigned int index);
+
+  /**
+   * Adds the entries the indexer found since the last call to the index of the stream, where
+   * av_seek_frame() finds them with a binary search.
+   */
+  void installIndexEntries();
 };
 }  // namespace ffmovie
@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegAudioMixer.h"
+#include <algorithm>
+#include "audio/process/AudioKernels.h"
+
+namespace ffmovie {
+std::unique_ptr<FFAudioMixer> FFAudioMixer::Make(std::shared_ptr<AudioOutputConfig> config,
+                                                 AudioSampleFormat outputFormat) {
+  if (config == nullptr || config->sampleRate <= 0) {
+    return nullptr;
+  }
+  // Matches the output of FFAudioDecoder and FFPCMAudioReader for the same config.
+  auto outputConfig = std::make_shared<PCMOutputConfig>();
+  outputConfig->sampleRate = config->sampleRate;
+  outputConfig->channels = config->channels == 2 ? 2 : 1;
+  outputConfig->channelLayout = config->channels == 2 ? AV_CH_LAYOUT_STEREO : AV_CH_LAYOUT_MONO;
+  outputConfig->outputSamplesCount =
+      config->outputSamplesCount > 0 ? config->outputSamplesCount : DEFAULT_OUTPUT_SAMPLE_COUNT;
+  return std::unique_ptr<FFmpegAudioMixer>(
+      new FFmpegAudioMixer(std::move(outputConfig), outputFormat));
+}
+
+FFmpegAudioMixer::FFmpegAudioMixer(std::shared_ptr<PCMOutputConfig> outputConfig,
+                                   AudioSampleFormat outputFormat)
+    : outputConfig(std::move(outputConfig)), outputFormat(outputFormat) {
+  auto sampleCount = static_cast<size_t>(this->outputConfig->outputSamplesCount) *
+                     this->outputConfig->channels;
+  accumulator.resize(sampleCount);
+  output.resize(sampleCount *
+                (outputFormat == AudioSampleFormat::F32 ? sizeof(float) : sizeof(int16_t)));
+}
+
+int FFmpegAudioMixer::addTrack(FFAudioDecoder* decoder, std::vector<VolumeRange> volumeRanges) {
+  if (decoder == nullptr) {
+    return -1;
+  }
+  return addTrack([decoder]() { return decoder->readNextChunk(); },
+                  [decoder]() { return decoder->currentPresentationTime(); },
+                  std::move(volumeRanges));
+}
+
+int FFmpegAudioMixer::addTrack(FFPCMAudioReader* reader, std::vector<VolumeRange> volumeRanges) {
+  if (reader == nullptr) {
+    return -1;
+  }
+  return addTrack([reader]() { return reader->readNextChunk(); },
+                  [reader]() { return reader->currentPresentationTime(); },
+                  std::move(volumeRanges));
+}
+
+int FFmpegAudioMixer::addTrack(std::function<SampleData()> readChunk,
+                               std::function<int64_t()> chunkTime,
+                               std::vector<VolumeRange> volumeRanges) {
+  Track track = {};
+  track.id = nextTrackID++;
+  track.readChunk = std::move(readChunk);
+  track.chunkTime = std::move(chunkTime);
+  tracks.push_back(std::move(track));
+  setVolumeRanges(tracks.back().id, std::move(volumeRanges));
+  return tracks.back().id;
+}
+
+void FFmpegAudioMixer::removeTrack(int trackID) {
+  tracks.erase(std::remove_if(tracks.begin(), tracks.end(),
+                              [trackID](const Track& track) { return track.id == trackID; }),
+               tracks.end());
+}
+
+void FFmpegAudioMixer::setVolumeRanges(int trackID, std::vector<VolumeRange> volumeRanges) {
+  for (auto& track : tracks) {
+    if (track.id != trackID) {
+      continue;
+    }
+    volumeRanges.erase(std::remove_if(volumeRanges.begin(), volumeRanges.end(),
+                                      [](const VolumeRange& range) {
+                                        return range.timeRange.duration() <= 0;
+                                      }),
+                       volumeRanges.end());
+    std::sort(volumeRanges.begin(), volumeRanges.end(),
+              [](const VolumeRange& left, const VolumeRange& right) {
+                return left.timeRange.start < right.timeRange.start;
+              });
+    track.volumeRanges = std::move(volumeRanges);
+    return;
+  }
+}
+
+SampleData FFmpegAudioMixer::readNextChunk() {
+  std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+  auto frameSize = static_cast<size_t>(outputConfig->channels) * sizeof(int16_t);
+  auto mixedTime = INT64_MAX;
+  for (auto& track : tracks) {
+    if (track.ended) {
+      continue;
+    }
+    auto samples = track.readChunk();
+    if (samples.empty()) {
+      track.ended = true;
+      continue;
+    }
+    auto maxFrames = static_cast<size_t>(outputConfig->outputSamplesCount);
+    auto frameCount = static_cast<int>(std::min(samples.length / frameSize, maxFrames));
+    auto trackTime = track.chunkTime();
+    mixTrack(track, reinterpret_cast<const int16_t*>(samples.data), frameCount, trackTime);
+    mixedTime = std::min(mixedTime, trackTime);
+  }
+  if (mixedTime == INT64_MAX) {
+    return {};
+  }
+  chunkTime = mixedTime;
+  if (outputFormat == AudioSampleFormat::F32) {
+    ClampF32(accumulator.data(), reinterpret_cast<float*>(output.data()), accumulator.size());
+  } else {
+    ConvertF32ToS16(accumulator.data(), reinterpret_cast<int16_t*>(output.data()),
+                    accumulator.size());
+  }
+  return SampleData(output.data(), static_cast<int64_t>(output.size()));
+}
+
+int64_t FFmpegAudioMixer::currentPresentationTime() {
+  return chunkTime;
+}
+
+void FFmpegAudioMixer::mixTrack(const Track& track, const int16_t* samples, int frameCount,
+                                int64_t startTime) {
+  auto channels = outputConfig->channels;
+  auto sampleRate = outputConfig->sampleRate;
+  auto& ranges = track.volumeRanges;
+  int frame = 0;
+  while (frame < frameCount) {
+    auto time = startTime + av_rescale(frame, AV_TIME_BASE, sampleRate);
+    // The first range that has not ended yet, which either contains time or starts after it.
+    auto range = std::find_if(ranges.begin(), ranges.end(), [time](const VolumeRange& item) {
+      return item.timeRange.end > time;
+    });
+    auto inRange = range != ranges.end() && range->timeRange.start <= time;
+    int endFrame = frameCount;
+    if (range != ranges.end()) {
+      auto segmentEnd = inRange ? range->timeRange.end : range->timeRange.start;
+      auto boundary = av_rescale_rnd(segmentEnd - startTime, sampleRate, AV_TIME_BASE,
+                                     AV_ROUND_UP);
+      endFrame = static_cast<int>(
+          std::min(static_cast<int64_t>(frameCount), std::max(boundary, frame + INT64_C(1))));
+    }
+    auto gain = 1.0f;
+    auto gainStep = 0.0f;
+    if (inRange) {
+      auto slope = (range->endVolume - range->startVolume) /
+                   static_cast<float>(range->timeRange.duration());
+      gain = range->startVolume + slope * static_cast<float>(time - range->timeRange.start);
+      gainStep = slope * static_cast<float>(AV_TIME_BASE) / static_cast<float>(sampleRate);
+    }
+    // Muted parts are skipped, which is common for tracks faded out or not started yet.
+    if (gain != 0.0f || gainStep != 0.0f) {
+      auto offset = static_cast<size_t>(frame) * channels;
+      MixS16ToF32(samples + offset, accumulator.data() + offset, endFrame - frame, channels, gain,
+                  gainStep);
+    }
+    frame = endFrame;
+  }
+}
+}  // namespace ffmovie
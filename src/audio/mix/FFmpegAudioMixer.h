@@ -0,0 +1,71 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "audio/AudioUtils.h"
+#include "ffmovie/movie.h"
+
+namespace ffmovie {
+class FFmpegAudioMixer : public FFAudioMixer {
+ public:
+  int addTrack(FFAudioDecoder* decoder, std::vector<VolumeRange> volumeRanges) override;
+
+  int addTrack(FFPCMAudioReader* reader, std::vector<VolumeRange> volumeRanges) override;
+
+  void removeTrack(int trackID) override;
+
+  void setVolumeRanges(int trackID, std::vector<VolumeRange> volumeRanges) override;
+
+  SampleData readNextChunk() override;
+
+  int64_t currentPresentationTime() override;
+
+ private:
+  struct Track {
+    int id = 0;
+    std::function<SampleData()> readChunk = nullptr;
+    std::function<int64_t()> chunkTime = nullptr;
+    // Sorted by start time.
+    std::vector<VolumeRange> volumeRanges = {};
+    bool ended = false;
+  };
+
+  std::shared_ptr<PCMOutputConfig> outputConfig = nullptr;
+  AudioSampleFormat outputFormat = AudioSampleFormat::S16;
+  std::vector<Track> tracks = {};
+  int nextTrackID = 1;
+  // Allocated once for one chunk.
+  std::vector<float> accumulator = {};
+  std::vector<uint8_t> output = {};
+  int64_t chunkTime = -1;
+
+  FFmpegAudioMixer(std::shared_ptr<PCMOutputConfig> outputConfig, AudioSampleFormat outputFormat);
+
+  int addTrack(std::function<SampleData()> readChunk, std::function<int64_t()> chunkTime,
+               std::vector<VolumeRange> volumeRanges);
+
+  /**
+   * Mixes the samples of a track into the accumulator. The chunk is split where volume ranges
+   * start or end, and each part is mixed with one linear ramp.
+   */
+  void mixTrack(const Track& track, const int16_t* samples, int frameCount, int64_t startTime);
+
+  friend FFAudioMixer;
+};
+}  // namespace ffmovie
@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AudioFifo.h"
+#include <algorithm>
+#include <cstring>
+
+namespace ffmovie {
+AudioFifo::AudioFifo(int channels, int bytesPerSample, int capacity)
+    : frameSize(static_cast<size_t>(channels) * bytesPerSample) {
+  reserve(capacity);
+}
+
+AudioFifo::~AudioFifo() {
+  free(buffer);
+}
+
+bool AudioFifo::reserve(int count) {
+  if (count <= sampleCapacity) {
+    return true;
+  }
+  auto newBuffer = static_cast<uint8_t*>(malloc(count * frameSize));
+  if (newBuffer == nullptr) {
+    return false;
+  }
+  // Unwraps the stored samples to the start of the new storage.
+  auto stored = sampleCount;
+  read(newBuffer, stored);
+  free(buffer);
+  buffer = newBuffer;
+  sampleCapacity = count;
+  readPosition = 0;
+  sampleCount = stored;
+  return true;
+}
+
+bool AudioFifo::write(const uint8_t* data, int count) {
+  if (count <= 0) {
+    return true;
+  }
+  if (sampleCount + count > sampleCapacity &&
+      !reserve(std::max(sampleCount + count, sampleCapacity * 2))) {
+    return false;
+  }
+  auto writePosition = (readPosition + sampleCount) % sampleCapacity;
+  auto firstCount = std::min(count, sampleCapacity - writePosition);
+  memcpy(buffer + writePosition * frameSize, data, firstCount * frameSize);
+  memcpy(buffer, data + firstCount * frameSize, (count - firstCount) * frameSize);
+  sampleCount += count;
+  return true;
+}
+
+int AudioFifo::read(uint8_t* data, int count) {
+  count = std::min(count, sampleCount);
+  if (count <= 0) {
+    return 0;
+  }
+  auto firstCount = std::min(count, sampleCapacity - readPosition);
+  memcpy(data, buffer + readPosition * frameSize, firstCount * frameSize);
+  memcpy(data + firstCount * frameSize, buffer, (count - firstCount) * frameSize);
+  return drain(count);
+}
+
+int AudioFifo::drain(int count) {
+  count = std::min(count, sampleCount);
+  if (count <= 0) {
+    return 0;
+  }
+  readPosition = (readPosition + count) % sampleCapacity;
+  sampleCount -= count;
+  return count;
+}
+
+void AudioFifo::clear() {
+  readPosition = 0;
+  sampleCount = 0;
+}
+}  // namespace ffmovie
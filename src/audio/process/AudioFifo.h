@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace ffmovie {
+/**
+ * AudioFifo is a ring buffer of interleaved PCM samples. The storage is allocated once and only
+ * grows if a single write does not fit, so steady-state reads and writes never allocate. All the
+ * counts are in samples per channel.
+ */
+class AudioFifo {
+ public:
+  AudioFifo(int channels, int bytesPerSample, int capacity);
+
+  ~AudioFifo();
+
+  AudioFifo(const AudioFifo&) = delete;
+
+  AudioFifo& operator=(const AudioFifo&) = delete;
+
+  /**
+   * Returns the number of samples stored.
+   */
+  int size() const {
+    return sampleCount;
+  }
+
+  int capacity() const {
+    return sampleCapacity;
+  }
+
+  /**
+   * Appends count samples, growing the storage if they do not fit. Returns false if the storage
+   * could not grow.
+   */
+  bool write(const uint8_t* data, int count);
+
+  /**
+   * Copies at most count samples into data and removes them. Returns the number of samples read.
+   */
+  int read(uint8_t* data, int count);
+
+  /**
+   * Removes at most count samples without copying them. Returns the number of samples removed.
+   */
+  int drain(int count);
+
+  void clear();
+
+ private:
+  size_t frameSize = 0;
+  uint8_t* buffer = nullptr;
+  int sampleCapacity = 0;
+  int readPosition = 0;
+  int sampleCount = 0;
+
+  bool reserve(int count);
+};
+}  // namespace ffmovie
@@ -17,9 +17,49 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "AudioFormatConverter.h"
+#include <cstring>
 #include "audio/AudioUtils.h"
+#include "audio/process/AudioKernels.h"
+#include "audio/process/PolyphaseResampler.h"
 
 namespace ffmovie {
+#define MAX_DIRECT_CHANNELS 8
+// -3dB, the ITU-R BS.775 gain for the center and surround channels in a stereo downmix.
+#define DOWNMIX_GAIN 0.70710678f
+#define DOWNMIX_NORMALIZE (1.0f / (1.0f + 2.0f * DOWNMIX_GAIN))
+
+static bool IsFiveDotOne(int channels, uint64_t channelLayout) {
+  if (channels != 6) {
+    return false;
+  }
+  return channelLayout == 0 || channelLayout == AV_CH_LAYOUT_5POINT1 ||
+         channelLayout == AV_CH_LAYOUT_5POINT1_BACK;
+}
+
+bool GetRemixMatrix(int inputChannels, uint64_t channelLayout, int outputChannels,
+                    float* matrix) {
+  if (inputChannels == 2 && outputChannels == 1) {
+    matrix[0] = 0.5f;
+    matrix[1] = 0.5f;
+    return true;
+  }
+  if (!IsFiveDotOne(inputChannels, channelLayout) || outputChannels > 2) {
+    return false;
+  }
+  // FL FR FC LFE SL(BL) SR(BR)
+  const float left[] = {1.0f, 0.0f, DOWNMIX_GAIN, 0.0f, DOWNMIX_GAIN, 0.0f};
+  const float right[] = {0.0f, 1.0f, DOWNMIX_GAIN, 0.0f, 0.0f, DOWNMIX_GAIN};
+  for (int i = 0; i < 6; i++) {
+    if (outputChannels == 2) {
+      matrix[i] = left[i] * DOWNMIX_NORMALIZE;
+      matrix[6 + i] = right[i] * DOWNMIX_NORMALIZE;
+    } else {
+      matrix[i] = (left[i] + right[i]) * 0.5f * DOWNMIX_NORMALIZE;
+    }
+  }
+  return true;
+}
+
 AudioFormatConverter::AudioFormatConverter(std::shared_ptr<PCMOutputConfig> pcmOutputConfig)
     : pcmOutputConfig(std::move(pcmOutputConfig)) {
 }
@@ -29,15 +69,7 @@ AudioFormatConverter::~AudioFormatConverter() {
   swr_free(&pSwrContext);
 }
 
-SampleData AudioFormatConverter::convert(AVFrame* frame) {
-  if (frame == nullptr) {
-    return {};
-  }
-  if (preFramePCMOutputConfig == nullptr) {
-    preFramePCMOutputConfig = std::make_shared<PCMOutputConfig>();
-  }
-  int nbSample =
-      static_cast<int>(frame->nb_samples * pcmOutputConfig->sampleRate / frame->sample_rate) + 256;
+bool AudioFormatConverter::ensureOutputBuffer(int nbSample) {
   if (nbSample > outputSamples) {
     if (pConvertBuff != nullptr) {
       av_freep(&pConvertBuff);
@@ -48,8 +80,162 @@ SampleData AudioFormatConverter::convert(AVFrame* frame) {
   if (pConvertBuff == nullptr) {
     if (av_samples_alloc(&pConvertBuff, nullptr, pcmOutputConfig->channels, outputSamples,
                          static_cast<AVSampleFormat>(pcmOutputConfig->format), 0) < 0) {
-      return {};
+      return false;
+    }
+  }
+  return true;
+}
+
+float* AudioFormatConverter::getFloatBuffer(size_t sampleCount) {
+  if (floatBuffer.size() < sampleCount) {
+    floatBuffer.resize(sampleCount);
+  }
+  return floatBuffer.data();
+}
+
+bool AudioFormatConverter::prepareResampler(int inputRate, int channels) {
+  if (resampler != nullptr && resampler->inputRate() == inputRate &&
+      resampler->channels() == channels) {
+    return true;
+  }
+  resampler = nullptr;
+  // swresample measured as fast as the Low and Medium filters with a cleaner output, only High
+  // buys something over it, see bin/ResamplerBench.cpp.
+  if (pcmOutputConfig->resampleQuality != ResampleQuality::High ||
+      inputRate == unsupportedResampleRate) {
+    return false;
+  }
+  resampler = PolyphaseResampler::Make(inputRate, pcmOutputConfig->sampleRate, channels,
+                                       pcmOutputConfig->resampleQuality);
+  if (resampler == nullptr) {
+    unsupportedResampleRate = inputRate;
+    return false;
+  }
+  return true;
+}
+
+int AudioFormatConverter::convertDirectly(AVFrame* frame, int16_t* output, int capacity) {
+  auto inputChannels = frame->channels;
+  auto outputChannels = pcmOutputConfig->channels;
+  if (pcmOutputConfig->format != AV_SAMPLE_FMT_S16 || outputChannels < 1 || outputChannels > 2 ||
+      inputChannels < 1 || inputChannels > MAX_DIRECT_CHANNELS) {
+    return -1;
+  }
+  auto format = frame->format;
+  if (format != AV_SAMPLE_FMT_S16 && format != AV_SAMPLE_FMT_S16P &&
+      format != AV_SAMPLE_FMT_FLT && format != AV_SAMPLE_FMT_FLTP) {
+    return -1;
+  }
+  float matrix[2 * MAX_DIRECT_CHANNELS] = {};
+  bool remix = inputChannels != outputChannels && !(inputChannels == 1 && outputChannels == 2);
+  if (remix && !GetRemixMatrix(inputChannels, frame->channel_layout, outputChannels, matrix)) {
+    return -1;
+  }
+  // A mono input is resampled once and duplicated to both output channels afterwards.
+  auto resampleChannels = inputChannels == 1 ? 1 : outputChannels;
+  bool resample = frame->sample_rate != pcmOutputConfig->sampleRate;
+  if (resample && !prepareResampler(frame->sample_rate, resampleChannels)) {
+    return -1;
+  }
+  auto frameCount = static_cast<size_t>(frame->nb_samples);
+  auto maxOutputCount = resample ? resampler->maxOutputCount(frame->nb_samples) : frame->nb_samples;
+  if (output == nullptr) {
+    if (!ensureOutputBuffer(maxOutputCount)) {
+      return -1;
+    }
+    output = reinterpret_cast<int16_t*>(pConvertBuff);
+  } else if (maxOutputCount > capacity) {
+    return -1;
+  }
+  if (!resample && format == AV_SAMPLE_FMT_S16) {
+    auto input = reinterpret_cast<const int16_t*>(frame->data[0]);
+    if (inputChannels == outputChannels) {
+      memcpy(output, input, frameCount * inputChannels * sizeof(int16_t));
+      return frame->nb_samples;
+    }
+    if (inputChannels == 1) {
+      ConvertMonoToStereoS16(input, output, frameCount);
+      return frame->nb_samples;
     }
+    if (inputChannels == 2) {
+      ConvertToMonoS16(input, inputChannels, output, frameCount);
+      return frame->nb_samples;
+    }
+  }
+  if (!resample && format == AV_SAMPLE_FMT_S16P && inputChannels == outputChannels) {
+    InterleaveS16(reinterpret_cast<const int16_t* const*>(frame->data), inputChannels, output,
+                  frameCount);
+    return frame->nb_samples;
+  }
+  if (!resample && format == AV_SAMPLE_FMT_FLT && inputChannels == outputChannels) {
+    ConvertF32ToS16(reinterpret_cast<const float*>(frame->data[0]), output,
+                    frameCount * inputChannels);
+    return frame->nb_samples;
+  }
+  // Everything else is brought to float planes, remixed and resampled if needed and interleaved
+  // back to s16.
+  auto scratchChannels = (format == AV_SAMPLE_FMT_FLTP ? 0 : inputChannels) +
+                         (remix ? outputChannels : 0);
+  auto resampleSize = resample ? static_cast<size_t>(resampleChannels * maxOutputCount) : 0;
+  auto scratch = getFloatBuffer(scratchChannels * frameCount + resampleSize);
+  const float* inputPlanes[MAX_DIRECT_CHANNELS] = {};
+  if (format == AV_SAMPLE_FMT_FLTP) {
+    for (int i = 0; i < inputChannels; i++) {
+      inputPlanes[i] = reinterpret_cast<const float*>(frame->data[i]);
+    }
+  } else {
+    float* planes[MAX_DIRECT_CHANNELS] = {};
+    for (int i = 0; i < inputChannels; i++) {
+      planes[i] = scratch + i * frameCount;
+      inputPlanes[i] = planes[i];
+    }
+    if (format == AV_SAMPLE_FMT_S16) {
+      DeinterleaveS16ToF32(reinterpret_cast<const int16_t*>(frame->data[0]), inputChannels,
+                           planes, frameCount);
+    } else if (format == AV_SAMPLE_FMT_FLT) {
+      DeinterleaveF32(reinterpret_cast<const float*>(frame->data[0]), inputChannels, planes,
+                      frameCount);
+    } else {
+      for (int i = 0; i < inputChannels; i++) {
+        ConvertS16ToF32(reinterpret_cast<const int16_t*>(frame->data[i]), planes[i], frameCount);
+      }
+    }
+    scratch += inputChannels * frameCount;
+  }
+  const float* outputPlanes[2] = {inputPlanes[0], inputPlanes[inputChannels == 1 ? 0 : 1]};
+  if (remix) {
+    float* planes[2] = {scratch, scratch + frameCount};
+    RemixF32(inputPlanes, inputChannels, planes, outputChannels, matrix, frameCount);
+    outputPlanes[0] = planes[0];
+    outputPlanes[1] = planes[1];
+    scratch += outputChannels * frameCount;
+  }
+  if (!resample) {
+    InterleaveF32ToS16(outputPlanes, outputChannels, output, frameCount);
+    return frame->nb_samples;
+  }
+  float* planes[2] = {scratch, scratch + (resampleChannels - 1) * maxOutputCount};
+  auto sampleCount = resampler->process(outputPlanes, frame->nb_samples, planes);
+  const float* resampledPlanes[2] = {planes[0], planes[1]};
+  InterleaveF32ToS16(resampledPlanes, outputChannels, output, static_cast<size_t>(sampleCount));
+  return sampleCount;
+}
+
+SampleData AudioFormatConverter::convert(AVFrame* frame) {
+  if (frame == nullptr) {
+    return {};
+  }
+  if (preFramePCMOutputConfig == nullptr) {
+    preFramePCMOutputConfig = std::make_shared<PCMOutputConfig>();
+  }
+  auto sampleCount = convertDirectly(frame, nullptr, 0);
+  if (sampleCount >= 0) {
+    return {pConvertBuff, SampleCountToLength(sampleCount, pcmOutputConfig.get())};
+  }
+  int nbSample =
+      static_cast<int>(frame->nb_samples * pcmOutputConfig->sampleRate / frame->sample_rate) + 256;
+  if (!ensureOutputBuffer(nbSample)) {
+    return {};
   }
   if (!IsSampleConfig(*preFramePCMOutputConfig, *frame) && pSwrContext != nullptr) {
     swr_free(&pSwrContext);
@@ -75,4 +261,40 @@ SampleData AudioFormatConverter::convert(AVFrame* frame) {
   }
   return {pConvertBuff, SampleCountToLength(newNbSamples, pcmOutputConfig.get())};
 }
+
+int AudioFormatConverter::convertTo(AVFrame* frame, uint8_t* output, int capacity) {
+  if (frame == nullptr || output == nullptr) {
+    return -1;
+  }
+  return convertDirectly(frame, reinterpret_cast<int16_t*>(output), capacity);
+}
+
+SampleData AudioFormatConverter::flush() {
+  if (resampler != nullptr) {
+    auto maxOutputCount = resampler->maxOutputCount(0);
+    if (!ensureOutputBuffer(maxOutputCount)) {
+      return {};
+    }
+    auto scratch = getFloatBuffer(static_cast<size_t>(2 * maxOutputCount));
+    float* planes[2] = {scratch, scratch + maxOutputCount};
+    auto sampleCount = resampler->flush(planes);
+    resampler->reset();
+    if (sampleCount <= 0) {
+      return {};
+    }
+    // A mono input was resampled as one plane, it is duplicated to both output channels.
+    const float* outputPlanes[2] = {planes[0], resampler->channels() == 1 ? planes[0] : planes[1]};
+    InterleaveF32ToS16(outputPlanes, pcmOutputConfig->channels,
+                       reinterpret_cast<int16_t*>(pConvertBuff), static_cast<size_t>(sampleCount));
+    return {pConvertBuff, SampleCountToLength(sampleCount, pcmOutputConfig.get())};
+  }
+  if (pSwrContext == nullptr || pConvertBuff == nullptr) {
+    return {};
+  }
+  auto newNbSamples = swr_convert(pSwrContext, &pConvertBuff, outputSamples, nullptr, 0);
+  if (newNbSamples <= 0) {
+    return {};
+  }
+  return {pConvertBuff, SampleCountToLength(newNbSamples, pcmOutputConfig.get())};
+}
 }  // namespace pag
@@ -29,10 +29,20 @@ extern "C" {
 }
 #endif
 
+#include <vector>
 #include "audio/AudioUtils.h"
+#include "audio/process/PolyphaseResampler.h"
 #include "ffmovie/movie.h"
 
 namespace ffmovie {
+/**
+ * Fills the remix matrix for the channel conversions the kernels support, stereo to mono and 5.1
+ * to stereo or mono, returns false for any other layout. A channelLayout of 0 stands for the
+ * default layout of the channel count. The center and surround channels are mixed in at -3dB and
+ * the LFE channel is dropped, as swresample does by default.
+ */
+bool GetRemixMatrix(int inputChannels, uint64_t channelLayout, int outputChannels, float* matrix);
+
 class AudioFormatConverter {
  public:
   explicit AudioFormatConverter(std::shared_ptr<PCMOutputConfig> pcmOutputConfig);
@@ -41,11 +51,37 @@ class AudioFormatConverter {
 
   SampleData convert(AVFrame* frame);
 
+  /**
+   * Converts the frame straight into output, which has room for capacity samples, without going
+   * through the internal buffer. Returns the number of samples written, or -1 if the frame needs
+   * swresample or the result might not fit, convert() must be used then.
+   */
+  int convertTo(AVFrame* frame, uint8_t* output, int capacity);
+
+  /**
+   * Returns the samples still buffered by the resampler, called once the input has ended.
+   */
+  SampleData flush();
+
  private:
   uint8_t* pConvertBuff = nullptr;
+  std::vector<float> floatBuffer = {};
+  std::unique_ptr<PolyphaseResampler> resampler = nullptr;
+  int unsupportedResampleRate = 0;
   int outputSamples = 0;
   SwrContext* pSwrContext = nullptr;
   std::shared_ptr<PCMOutputConfig> pcmOutputConfig;
   std::shared_ptr<PCMOutputConfig> preFramePCMOutputConfig;
+
+  bool ensureOutputBuffer(int nbSample);
+
+  /**
+   * Converts the frame with the SIMD kernels and the polyphase resampler into output, or into
+   * pConvertBuff if output is nullptr. Returns the number of samples written, or -1 if the
+   * conversion has to go through swresample or does not fit in capacity.
+   */
+  int convertDirectly(AVFrame* frame, int16_t* output, int capacity);
+  bool prepareResampler(int inputRate, int channels);
+  float* getFloatBuffer(size_t sampleCount);
 };
 }  // namespace ffmovie
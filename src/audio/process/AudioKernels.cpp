@@ -0,0 +1,820 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AudioKernels.h"
+#include <algorithm>
+#include <cmath>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FFMOVIE_USE_SSE2
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__) && !defined(__EMSCRIPTEN__)
+#include <immintrin.h>
+// Built for the baseline CPU, the AVX2 kernels are compiled per function and picked at runtime.
+#define FFMOVIE_DISPATCH_AVX2
+#endif
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define FFMOVIE_USE_NEON
+#endif
+
+namespace ffmovie {
+#define S16_TO_F32_SCALE (1.0f / 32768.0f)
+
+static inline int16_t SaturateToS16(int32_t value) {
+  return static_cast<int16_t>(value > INT16_MAX ? INT16_MAX
+                                                : (value < INT16_MIN ? INT16_MIN : value));
+}
+
+#if defined(FFMOVIE_DISPATCH_AVX2)
+static bool HasAVX2() {
+  static const bool Supported = __builtin_cpu_supports("avx2");
+  return Supported;
+}
+
+/**
+ * Converts 16 floats to s16 with rounding and saturation, in their order.
+ */
+__attribute__((target("avx2"))) static inline __m256i LoadF32AsS16AVX2(const float* src) {
+  auto scale = _mm256_set1_ps(32767.0f);
+  auto minValue = _mm256_set1_ps(-1.0f);
+  auto maxValue = _mm256_set1_ps(1.0f);
+  auto low = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src), minValue), maxValue);
+  auto high = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + 8), minValue), maxValue);
+  auto packed = _mm256_packs_epi32(_mm256_cvtps_epi32(_mm256_mul_ps(low, scale)),
+                                   _mm256_cvtps_epi32(_mm256_mul_ps(high, scale)));
+  // packs works per 128-bit lane, which leaves the quarters in the order low, high, low, high.
+  return _mm256_permute4x64_epi64(packed, 0xD8);
+}
+
+__attribute__((target("avx2"))) static size_t ConvertF32ToS16AVX2(const float* src,
+                                                                  int16_t* dst, size_t count) {
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), LoadF32AsS16AVX2(src + i));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t ConvertS16ToF32AVX2(const int16_t* src, float* dst,
+                                                                  size_t count) {
+  auto scale = _mm256_set1_ps(S16_TO_F32_SCALE);
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    auto samples = _mm256_cvtepi32_ps(
+        _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(samples, scale));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t InterleaveStereoF32ToS16AVX2(const float* left,
+                                                                           const float* right,
+                                                                           int16_t* dst,
+                                                                           size_t frameCount) {
+  size_t i = 0;
+  for (; i + 16 <= frameCount; i += 16) {
+    auto leftSamples = LoadF32AsS16AVX2(left + i);
+    auto rightSamples = LoadF32AsS16AVX2(right + i);
+    // unpack works per 128-bit lane too, frames 0-3 and 8-11 end up in low, 4-7 and 12-15 in high.
+    auto low = _mm256_unpacklo_epi16(leftSamples, rightSamples);
+    auto high = _mm256_unpackhi_epi16(leftSamples, rightSamples);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2),
+                        _mm256_permute2x128_si256(low, high, 0x20));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2 + 16),
+                        _mm256_permute2x128_si256(low, high, 0x31));
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) static size_t DeinterleaveStereoS16ToF32AVX2(const int16_t* src,
+                                                                             float* left,
+                                                                             float* right,
+                                                                             size_t frameCount) {
+  auto scale = _mm256_set1_ps(S16_TO_F32_SCALE);
+  size_t i = 0;
+  for (; i + 8 <= frameCount; i += 8) {
+    // Each 32-bit lane holds one frame, the left sample in its lower half.
+    auto frames = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2));
+    auto leftSamples = _mm256_srai_epi32(_mm256_slli_epi32(frames, 16), 16);
+    auto rightSamples = _mm256_srai_epi32(frames, 16);
+    _mm256_storeu_ps(left + i, _mm256_mul_ps(_mm256_cvtepi32_ps(leftSamples), scale));
+    _mm256_storeu_ps(right + i, _mm256_mul_ps(_mm256_cvtepi32_ps(rightSamples), scale));
+  }
+  return i;
+}
+#endif
+
+void ConvertU8ToS16(const uint8_t* src, int16_t* dst, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = static_cast<int16_t>((src[i] - 128) * 256);
+  }
+}
+
+void ConvertS24ToS16(const uint8_t* src, int16_t* dst, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = static_cast<int16_t>(src[i * 3 + 1] | (src[i * 3 + 2] << 8));
+  }
+}
+
+void ConvertS32ToS16(const int32_t* src, int16_t* dst, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = static_cast<int16_t>(src[i] >> 16);
+  }
+}
+
+void ConvertF32ToS16(const float* src, int16_t* dst, size_t count) {
+  size_t i = 0;
+#if defined(FFMOVIE_DISPATCH_AVX2)
+  if (HasAVX2()) {
+    i = ConvertF32ToS16AVX2(src, dst, count);
+  }
+#endif
+#if defined(FFMOVIE_USE_SSE2)
+  auto scale = _mm_set1_ps(32767.0f);
+  auto minValue = _mm_set1_ps(-1.0f);
+  auto maxValue = _mm_set1_ps(1.0f);
+  for (; i + 8 <= count; i += 8) {
+    // cvtps rounds to nearest, but turns out of range floats into INT32_MIN, so they are clamped
+    // first.
+    auto low = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), minValue), maxValue);
+    auto high = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4), minValue), maxValue);
+    auto packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(low, scale)),
+                                  _mm_cvtps_epi32(_mm_mul_ps(high, scale)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+  }
+#elif defined(FFMOVIE_USE_NEON)
+  auto scale = vdupq_n_f32(32767.0f);
+  for (; i + 8 <= count; i += 8) {
+    auto low = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + i), scale));
+    auto high = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + i + 4), scale));
+    vst1q_s16(dst + i, vcombine_s16(vqmovn_s32(low), vqmovn_s32(high)));
+  }
+#endif
+  for (; i < count; i++) {
+    auto value = src[i] > 1.0f ? 1.0f : (src[i] < -1.0f ? -1.0f : src[i]);
+    dst[i] = SaturateToS16(static_cast<int32_t>(lrintf(value * 32767.0f)));
+  }
+}
+
+void ConvertMonoToStereoS16(const int16_t* src, int16_t* dst, size_t frameCount) {
+  for (size_t i = 0; i < frameCount; i++) {
+    dst[i * 2] = src[i];
+    dst[i * 2 + 1] = src[i];
+  }
+}
+
+void ConvertToMonoS16(const int16_t* src, int srcChannels, int16_t* dst, size_t frameCount) {
+  for (size_t i = 0; i < frameCount; i++) {
+    int32_t sum = 0;
+    for (int channel = 0; channel < srcChannels; channel++) {
+      sum += src[i * srcChannels + channel];
+    }
+    dst[i] = static_cast<int16_t>(sum / srcChannels);
+  }
+}
+
+void ConvertS16ToF32(const int16_t* src, float* dst, size_t count) {
+  size_t i = 0;
+#if defined(FFMOVIE_DISPATCH_AVX2)
+  if (HasAVX2()) {
+    i = ConvertS16ToF32AVX2(src, dst, count);
+  }
+#endif
+  for (; i < count; i++) {
+    dst[i] = src[i] * S16_TO_F32_SCALE;
+  }
+}
+
+void ClampF32(const float* src, float* dst, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dst[i] = src[i] > 1.0f ? 1.0f : (src[i] < -1.0f ? -1.0f : src[i]);
+  }
+}
+
+static void MixS16ToF32Scalar(const int16_t* src, float* dst, size_t frameCount, int channels,
+                              float startGain, float gainStep) {
+  auto gain = startGain * S16_TO_F32_SCALE;
+  auto step = gainStep * S16_TO_F32_SCALE;
+  for (size_t frame = 0; frame < frameCount; frame++) {
+    for (int channel = 0; channel < channels; channel++) {
+      dst[frame * channels + channel] += src[frame * channels + channel] * gain;
+    }
+    gain += step;
+  }
+}
+
+/**
+ * The vector kernels process lanes samples at a time with one gain per lane, which only works if
+ * a vector holds whole frames. Returns the gains of the first vector in gains.
+ */
+static bool InitLaneGains(int lanes, int channels, float startGain, float gainStep,
+                          float* gains) {
+  if (channels <= 0 || lanes % channels != 0) {
+    return false;
+  }
+  for (int lane = 0; lane < lanes; lane++) {
+    gains[lane] = (startGain + gainStep * static_cast<float>(lane / channels)) * S16_TO_F32_SCALE;
+  }
+  return true;
+}
+
+#if defined(FFMOVIE_DISPATCH_AVX2)
+__attribute__((target("avx2"))) static size_t MixS16ToF32AVX2(const int16_t* src, float* dst,
+                                                              size_t count, int channels,
+                                                              float startGain, float gainStep) {
+  float gains[8] = {};
+  if (!InitLaneGains(8, channels, startGain, gainStep, gains)) {
+    return 0;
+  }
+  auto gain = _mm256_loadu_ps(gains);
+  auto step = _mm256_set1_ps(gainStep * S16_TO_F32_SCALE * static_cast<float>(8 / channels));
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    auto samples = _mm256_cvtepi32_ps(
+        _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+    auto mixed = _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(samples, gain));
+    _mm256_storeu_ps(dst + i, mixed);
+    gain = _mm256_add_ps(gain, step);
+  }
+  return i;
+}
+#endif
+
+/**
+ * Mixes the largest multiple of the vector width, returns the number of samples mixed.
+ */
+static size_t MixS16ToF32Vector(const int16_t* src, float* dst, size_t count, int channels,
+                                float startGain, float gainStep) {
+  size_t i = 0;
+#if defined(FFMOVIE_USE_SSE2)
+  float gains[4] = {};
+  if (!InitLaneGains(4, channels, startGain, gainStep, gains)) {
+    return 0;
+  }
+  auto gain = _mm_loadu_ps(gains);
+  auto step = _mm_set1_ps(gainStep * S16_TO_F32_SCALE * static_cast<float>(4 / channels));
+  for (; i + 4 <= count; i += 4) {
+    auto words = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+    // Sign-extends the 16-bit samples by moving them to the upper half and shifting back.
+    auto samples = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16));
+    auto mixed = _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(samples, gain));
+    _mm_storeu_ps(dst + i, mixed);
+    gain = _mm_add_ps(gain, step);
+  }
+#elif defined(FFMOVIE_USE_NEON)
+  float gains[4] = {};
+  if (!InitLaneGains(4, channels, startGain, gainStep, gains)) {
+    return 0;
+  }
+  auto gain = vld1q_f32(gains);
+  auto step = vdupq_n_f32(gainStep * S16_TO_F32_SCALE * static_cast<float>(4 / channels));
+  for (; i + 4 <= count; i += 4) {
+    auto samples = vcvtq_f32_s32(vmovl_s16(vld1_s16(src + i)));
+    vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), samples, gain));
+    gain = vaddq_f32(gain, step);
+  }
+#else
+  (void)src;
+  (void)dst;
+  (void)count;
+  (void)channels;
+  (void)startGain;
+  (void)gainStep;
+#endif
+  return i;
+}
+
+void MixS16ToF32(const int16_t* src, float* dst, size_t frameCount, int channels, float startGain,
+                 float gainStep) {
+  auto count = frameCount * channels;
+  size_t mixed = 0;
+#if defined(FFMOVIE_DISPATCH_AVX2)
+  if (HasAVX2()) {
+    mixed = MixS16ToF32AVX2(src, dst, count, channels, startGain, gainStep);
+  }
+#endif
+  if (mixed == 0) {
+    mixed = MixS16ToF32Vector(src, dst, count, channels, startGain, gainStep);
+  }
+  // The tail continues the ramp from the first frame after the vectorized part.
+  auto mixedFrames = mixed / channels;
+  MixS16ToF32Scalar(src + mixed, dst + mixed, frameCount - mixedFrames, channels,
+                    startGain + gainStep * static_cast<float>(mixedFrames), gainStep);
+}
+
+static inline int16_t FloatToS16(float value) {
+  value = value > 1.0f ? 1.0f : (value < -1.0f ? -1.0f : value);
+  return static_cast<int16_t>(lrintf(value * 32767.0f));
+}
+
+template <int Channels>
+static void InterleaveF32ToS16Impl(const float* const* planes, int16_t* dst, size_t frameCount) {
+  for (size_t i = 0; i < frameCount; i++) {
+    for (int channel = 0; channel < Channels; channel++) {
+      dst[i * Channels + channel] = FloatToS16(planes[channel][i]);
+    }
+  }
+}
+
+template <>
+void InterleaveF32ToS16Impl<1>(const float* const* planes, int16_t* dst, size_t frameCount) {
+  ConvertF32ToS16(planes[0], dst, frameCount);
+}
+
+template <>
+void InterleaveF32ToS16Impl<2>(const float* const* planes, int16_t* dst, size_t frameCount) {
+  auto left = planes[0];
+  auto right = planes[1];
+  size_t i = 0;
+#if defined(FFMOVIE_DISPATCH_AVX2)
+  if (HasAVX2()) {
+    i = InterleaveStereoF32ToS16AVX2(left, right, dst, frameCount);
+  }
+#endif
+#if defined(FFMOVIE_USE_SSE2)
+  auto scale = _mm_set1_ps(32767.0f);
+  auto minValue = _mm_set1_ps(-1.0f);
+  auto maxValue = _mm_set1_ps(1.0f);
+  auto load = [&](const float* src) {
+    auto low = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src), minValue), maxValue);
+    auto high = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + 4), minValue), maxValue);
+    return _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(low, scale)),
+                           _mm_cvtps_epi32(_mm_mul_ps(high, scale)));
+  };
+  for (; i + 8 <= frameCount; i += 8) {
+    auto leftSamples = load(left + i);
+    auto rightSamples = load(right + i);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2),
+                     _mm_unpacklo_epi16(leftSamples, rightSamples));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2 + 8),
+                     _mm_unpackhi_epi16(leftSamples, rightSamples));
+  }
+#elif defined(FFMOVIE_USE_NEON)
+  auto scale = vdupq_n_f32(32767.0f);
+  auto load = [&](const float* src) {
+    auto low = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src), scale));
+    auto high = vcvtnq_s32_f32(vmulq_f32(vld1q_f32(src + 4), scale));
+    return vcombine_s16(vqmovn_s32(low), vqmovn_s32(high));
+  };
+  for (; i + 8 <= frameCount; i += 8) {
+    int16x8x2_t samples = {{load(left + i), load(right + i)}};
+    vst2q_s16(dst + i * 2, samples);
+  }
+#endif
+  for (; i < frameCount; i++) {
+    dst[i * 2] = FloatToS16(left[i]);
+    dst[i * 2 + 1] = FloatToS16(right[i]);
+  }
+}
+
+void InterleaveF32ToS16(const float* const* planes, int channels, int16_t* dst,
+                        size_t frameCount) {
+  switch (channels) {
+    case 1:
+      InterleaveF32ToS16Impl<1>(planes, dst, frameCount);
+      break;
+    case 2:
+      InterleaveF32ToS16Impl<2>(planes, dst, frameCount);
+      break;
+    default:
+      for (size_t i = 0; i < frameCount; i++) {
+        for (int channel = 0; channel < channels; channel++) {
+          dst[i * channels + channel] = FloatToS16(planes[channel][i]);
+        }
+      }
+      break;
+  }
+}
+
+void InterleaveS16(const int16_t* const* planes, int channels, int16_t* dst, size_t frameCount) {
+  if (channels == 2) {
+    auto left = planes[0];
+    auto right = planes[1];
+    for (size_t i = 0; i < frameCount; i++) {
+      dst[i * 2] = left[i];
+      dst[i * 2 + 1] = right[i];
+    }
+    return;
+  }
+  for (size_t i = 0; i < frameCount; i++) {
+    for (int channel = 0; channel < channels; channel++) {
+      dst[i * channels + channel] = planes[channel][i];
+    }
+  }
+}
+
+void DeinterleaveS16ToF32(const int16_t* src, int channels, float* const* planes,
+                          size_t frameCount) {
+  if (channels == 2) {
+    auto left = planes[0];
+    auto right = planes[1];
+    size_t i = 0;
+#if defined(FFMOVIE_DISPATCH_AVX2)
+    if (HasAVX2()) {
+      i = DeinterleaveStereoS16ToF32AVX2(src, left, right, frameCount);
+    }
+#endif
+#if defined(FFMOVIE_USE_SSE2)
+    auto scale = _mm_set1_ps(S16_TO_F32_SCALE);
+    for (; i + 4 <= frameCount; i += 4) {
+      auto frames = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+      auto leftSamples = _mm_srai_epi32(_mm_slli_epi32(frames, 16), 16);
+      auto rightSamples = _mm_srai_epi32(frames, 16);
+      _mm_storeu_ps(left + i, _mm_mul_ps(_mm_cvtepi32_ps(leftSamples), scale));
+      _mm_storeu_ps(right + i, _mm_mul_ps(_mm_cvtepi32_ps(rightSamples), scale));
+    }
+#elif defined(FFMOVIE_USE_NEON)
+    for (; i + 8 <= frameCount; i += 8) {
+      auto samples = vld2q_s16(src + i * 2);
+      vst1q_f32(left + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples.val[0]))),
+                                      S16_TO_F32_SCALE));
+      vst1q_f32(left + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(samples.val[0])),
+                                          S16_TO_F32_SCALE));
+      vst1q_f32(right + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(samples.val[1]))),
+                                       S16_TO_F32_SCALE));
+      vst1q_f32(right + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_high_s16(samples.val[1])),
+                                           S16_TO_F32_SCALE));
+    }
+#endif
+    for (; i < frameCount; i++) {
+      left[i] = src[i * 2] * S16_TO_F32_SCALE;
+      right[i] = src[i * 2 + 1] * S16_TO_F32_SCALE;
+    }
+    return;
+  }
+  for (int channel = 0; channel < channels; channel++) {
+    auto plane = planes[channel];
+    for (size_t i = 0; i < frameCount; i++) {
+      plane[i] = src[i * channels + channel] * S16_TO_F32_SCALE;
+    }
+  }
+}
+
+void DeinterleaveF32(const float* src, int channels, float* const* planes, size_t frameCount) {
+  for (int channel = 0; channel < channels; channel++) {
+    auto plane = planes[channel];
+    for (size_t i = 0; i < frameCount; i++) {
+      plane[i] = src[i * channels + channel];
+    }
+  }
+}
+
+void RemixF32(const float* const* src, int srcChannels, float* const* dst, int dstChannels,
+              const float* matrix, size_t frameCount) {
+  for (int out = 0; out < dstChannels; out++) {
+    auto plane = dst[out];
+    auto weights = matrix + out * srcChannels;
+    // One pass per source plane keeps every inner loop a plain multiply-add the compiler
+    // vectorizes.
+    for (size_t i = 0; i < frameCount; i++) {
+      plane[i] = src[0][i] * weights[0];
+    }
+    for (int in = 1; in < srcChannels; in++) {
+      auto weight = weights[in];
+      if (weight == 0.0f) {
+        continue;
+      }
+      auto source = src[in];
+      for (size_t i = 0; i < frameCount; i++) {
+        plane[i] += source[i] * weight;
+      }
+    }
+  }
+}
+
+#if defined(FFMOVIE_DISPATCH_AVX2)
+__attribute__((target("avx2"))) static float DotProductF32AVX2(const float* a, const float* b,
+                                                               size_t count) {
+  auto sum = _mm256_setzero_ps();
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  }
+  auto half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+  half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+  half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+  auto result = _mm_cvtss_f32(half);
+  for (; i < count; i++) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+#endif
+
+float DotProductF32(const float* a, const float* b, size_t count) {
+#if defined(FFMOVIE_DISPATCH_AVX2)
+  if (HasAVX2()) {
+    return DotProductF32AVX2(a, b, count);
+  }
+#endif
+  size_t i = 0;
+  float result = 0.0f;
+#if defined(FFMOVIE_USE_SSE2)
+  auto sum = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4) {
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  result = _mm_cvtss_f32(sum);
+#elif defined(FFMOVIE_USE_NEON)
+  auto sum = vdupq_n_f32(0.0f);
+  for (; i + 4 <= count; i += 4) {
+    sum = vmlaq_f32(sum, vld1q_f32(a + i), vld1q_f32(b + i));
+  }
+  result = vaddvq_f32(sum);
+#endif
+  for (; i < count; i++) {
+    result += a[i] * b[i];
+  }
+  return result;
+}
+
+/**
+ * Walks the input positions of a polyphase filter. The step is split into whole samples and
+ * phases, so moving to the next output needs no division.
+ */
+class PolyphaseCursor {
+ public:
+  PolyphaseCursor(int upFactor, int downFactor, int inputIndex, int phase)
+      : upFactor(upFactor), stepSamples(downFactor / upFactor), stepPhases(downFactor % upFactor),
+        inputIndex(inputIndex), phase(phase) {
+  }
+
+  void next() {
+    inputIndex += stepSamples;
+    phase += stepPhases;
+    if (phase >= upFactor) {
+      phase -= upFactor;
+      inputIndex++;
+    }
+  }
+
+  int upFactor = 1;
+  int stepSamples = 0;
+  int stepPhases = 0;
+  int inputIndex = 0;
+  int phase = 0;
+};
+
+#if defined(FFMOVIE_DISPATCH_AVX2)
+__attribute__((target("avx2"))) static inline __m256 MultiplyTapsAVX2(const float* src,
+                                                                      const float* filter,
+                                                                      int taps) {
+  auto sum = _mm256_mul_ps(_mm256_loadu_ps(src), _mm256_loadu_ps(filter));
+  for (int i = 8; i < taps; i += 8) {
+    sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(src + i), _mm256_loadu_ps(filter + i)));
+  }
+  return sum;
+}
+
+__attribute__((target("avx2"))) static size_t PolyphaseFilterF32AVX2(
+    const float* src, const float* coefficients, int taps, PolyphaseCursor* cursor, float* dst,
+    size_t count) {
+  size_t i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m256 sums[8];
+    for (int k = 0; k < 8; k++) {
+      sums[k] = MultiplyTapsAVX2(src + cursor->inputIndex,
+                                 coefficients + static_cast<size_t>(cursor->phase) * taps, taps);
+      cursor->next();
+    }
+    // Three rounds of pairwise adds leave the sums of the 128-bit halves of all 8 vectors, which
+    // are added once the halves are lined up.
+    auto sums01 = _mm256_hadd_ps(sums[0], sums[1]);
+    auto sums23 = _mm256_hadd_ps(sums[2], sums[3]);
+    auto sums45 = _mm256_hadd_ps(sums[4], sums[5]);
+    auto sums67 = _mm256_hadd_ps(sums[6], sums[7]);
+    auto sums0123 = _mm256_hadd_ps(sums01, sums23);
+    auto sums4567 = _mm256_hadd_ps(sums45, sums67);
+    auto result = _mm256_add_ps(_mm256_permute2f128_ps(sums0123, sums4567, 0x20),
+                                _mm256_permute2f128_ps(sums0123, sums4567, 0x31));
+    _mm256_storeu_ps(dst + i, result);
+  }
+  return i;
+}
+#endif
+
+void PolyphaseFilterF32(const float* src, const float* coefficients, int taps, int upFactor,
+                        int downFactor, int inputIndex, int phase, float* dst, size_t count) {
+  PolyphaseCursor cursor(upFactor, downFactor, inputIndex, phase);
+  size_t i = 0;
+#if defined(FFMOVIE_DISPATCH_AVX2)
+  if (HasAVX2()) {
+    i = PolyphaseFilterF32AVX2(src, coefficients, taps, &cursor, dst, count);
+  }
+#endif
+#if defined(FFMOVIE_USE_SSE2)
+  for (; i + 4 <= count; i += 4) {
+    __m128 sums[4];
+    for (int k = 0; k < 4; k++) {
+      auto input = src + cursor.inputIndex;
+      auto filter = coefficients + static_cast<size_t>(cursor.phase) * taps;
+      sums[k] = _mm_mul_ps(_mm_loadu_ps(input), _mm_loadu_ps(filter));
+      for (int tap = 4; tap < taps; tap += 4) {
+        sums[k] = _mm_add_ps(sums[k],
+                             _mm_mul_ps(_mm_loadu_ps(input + tap), _mm_loadu_ps(filter + tap)));
+      }
+      cursor.next();
+    }
+    // After the transpose each vector holds one lane of all 4 sums.
+    _MM_TRANSPOSE4_PS(sums[0], sums[1], sums[2], sums[3]);
+    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_add_ps(sums[0], sums[1]), _mm_add_ps(sums[2], sums[3])));
+  }
+#elif defined(FFMOVIE_USE_NEON)
+  for (; i < count; i++) {
+    auto input = src + cursor.inputIndex;
+    auto filter = coefficients + static_cast<size_t>(cursor.phase) * taps;
+    auto sum = vmulq_f32(vld1q_f32(input), vld1q_f32(filter));
+    for (int tap = 4; tap < taps; tap += 4) {
+      sum = vmlaq_f32(sum, vld1q_f32(input + tap), vld1q_f32(filter + tap));
+    }
+    dst[i] = vaddvq_f32(sum);
+    cursor.next();
+  }
+#endif
+  for (; i < count; i++) {
+    auto input = src + cursor.inputIndex;
+    auto filter = coefficients + static_cast<size_t>(cursor.phase) * taps;
+    float sum = 0.0f;
+    for (int tap = 0; tap < taps; tap++) {
+      sum += input[tap] * filter[tap];
+    }
+    dst[i] = sum;
+    cursor.next();
+  }
+}
+
+void ReducePeakS16(const int16_t* src, size_t count, int16_t* minValue, int16_t* maxValue,
+                   uint64_t* sumSquares) {
+  auto minResult = *minValue;
+  auto maxResult = *maxValue;
+  uint64_t sumResult = 0;
+  size_t i = 0;
+#if defined(FFMOVIE_USE_SSE2)
+  if (count >= 8) {
+    auto minVector = _mm_set1_epi16(minResult);
+    auto maxVector = _mm_set1_epi16(maxResult);
+    auto sumVector = _mm_setzero_si128();
+    auto zero = _mm_setzero_si128();
+    for (; i + 8 <= count; i += 8) {
+      auto samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      minVector = _mm_min_epi16(minVector, samples);
+      maxVector = _mm_max_epi16(maxVector, samples);
+      // A pair of squares may reach 2^31, it is widened as unsigned.
+      auto squares = _mm_madd_epi16(samples, samples);
+      sumVector = _mm_add_epi64(sumVector, _mm_unpacklo_epi32(squares, zero));
+      sumVector = _mm_add_epi64(sumVector, _mm_unpackhi_epi32(squares, zero));
+    }
+    int16_t minLanes[8];
+    int16_t maxLanes[8];
+    uint64_t sumLanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(minLanes), minVector);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(maxLanes), maxVector);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sumLanes), sumVector);
+    for (int lane = 0; lane < 8; lane++) {
+      minResult = std::min(minResult, minLanes[lane]);
+      maxResult = std::max(maxResult, maxLanes[lane]);
+    }
+    sumResult = sumLanes[0] + sumLanes[1];
+  }
+#elif defined(FFMOVIE_USE_NEON)
+  if (count >= 8) {
+    auto minVector = vdupq_n_s16(minResult);
+    auto maxVector = vdupq_n_s16(maxResult);
+    auto sumVector = vdupq_n_u64(0);
+    for (; i + 8 <= count; i += 8) {
+      auto samples = vld1q_s16(src + i);
+      minVector = vminq_s16(minVector, samples);
+      maxVector = vmaxq_s16(maxVector, samples);
+      auto low = vget_low_s16(samples);
+      auto high = vget_high_s16(samples);
+      sumVector = vpadalq_u32(sumVector, vreinterpretq_u32_s32(vmull_s16(low, low)));
+      sumVector = vpadalq_u32(sumVector, vreinterpretq_u32_s32(vmull_s16(high, high)));
+    }
+    minResult = vminvq_s16(minVector);
+    maxResult = vmaxvq_s16(maxVector);
+    sumResult = vaddvq_u64(sumVector);
+  }
+#endif
+  for (; i < count; i++) {
+    auto sample = src[i];
+    minResult = std::min(minResult, sample);
+    maxResult = std::max(maxResult, sample);
+    sumResult += static_cast<uint64_t>(static_cast<int32_t>(sample) * sample);
+  }
+  *minValue = minResult;
+  *maxValue = maxResult;
+  *sumSquares += sumResult;
+}
+
+// Below this the filter state is flushed to zero, so long silences do not run on denormals.
+#define BIQUAD_DENORMAL_LIMIT 1e-15
+
+static void FlushBiquadState(double* state, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (std::fabs(state[i]) < BIQUAD_DENORMAL_LIMIT) {
+      state[i] = 0;
+    }
+  }
+}
+
+static void FilterSumSquaresS16Scalar(const int16_t* src, int channels, size_t frameCount,
+                                      const double* coefficients, int stageCount, double* state,
+                                      double* sumSquares) {
+  for (int channel = 0; channel < channels; channel++) {
+    double sum = 0;
+    for (size_t i = 0; i < frameCount; i++) {
+      double value = src[i * channels + channel] * (1.0 / 32768.0);
+      for (int stage = 0; stage < stageCount; stage++) {
+        auto c = coefficients + stage * 5;
+        auto s = state + stage * 2 * channels;
+        auto output = c[0] * value + s[channel];
+        s[channel] = c[1] * value - c[3] * output + s[channels + channel];
+        s[channels + channel] = c[2] * value - c[4] * output;
+        value = output;
+      }
+      sum += value * value;
+    }
+    sumSquares[channel] += sum;
+  }
+}
+
+void FilterSumSquaresS16(const int16_t* src, int channels, size_t frameCount,
+                         const double* coefficients, int stageCount, double* state,
+                         double* sumSquares) {
+#if defined(FFMOVIE_USE_SSE2)
+  if (channels == 2) {
+    auto scale = _mm_set1_pd(1.0 / 32768.0);
+    auto sum = _mm_setzero_pd();
+    for (size_t i = 0; i < frameCount; i++) {
+      auto value = _mm_mul_pd(_mm_set_pd(src[2 * i + 1], src[2 * i]), scale);
+      for (int stage = 0; stage < stageCount; stage++) {
+        auto c = coefficients + stage * 5;
+        auto s = state + stage * 4;
+        auto s1 = _mm_loadu_pd(s);
+        auto s2 = _mm_loadu_pd(s + 2);
+        auto output = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(c[0]), value), s1);
+        s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(_mm_set1_pd(c[1]), value),
+                                   _mm_mul_pd(_mm_set1_pd(c[3]), output)),
+                        s2);
+        s2 = _mm_sub_pd(_mm_mul_pd(_mm_set1_pd(c[2]), value),
+                        _mm_mul_pd(_mm_set1_pd(c[4]), output));
+        _mm_storeu_pd(s, s1);
+        _mm_storeu_pd(s + 2, s2);
+        value = output;
+      }
+      sum = _mm_add_pd(sum, _mm_mul_pd(value, value));
+    }
+    double sumLanes[2];
+    _mm_storeu_pd(sumLanes, sum);
+    sumSquares[0] += sumLanes[0];
+    sumSquares[1] += sumLanes[1];
+    FlushBiquadState(state, static_cast<size_t>(stageCount) * 4);
+    return;
+  }
+#elif defined(FFMOVIE_USE_NEON)
+  if (channels == 2) {
+    auto sum = vdupq_n_f64(0);
+    for (size_t i = 0; i < frameCount; i++) {
+      double samples[2] = {src[2 * i] * (1.0 / 32768.0), src[2 * i + 1] * (1.0 / 32768.0)};
+      auto value = vld1q_f64(samples);
+      for (int stage = 0; stage < stageCount; stage++) {
+        auto c = coefficients + stage * 5;
+        auto s = state + stage * 4;
+        auto output = vfmaq_f64(vld1q_f64(s), value, vdupq_n_f64(c[0]));
+        auto s1 = vfmaq_f64(vld1q_f64(s + 2), value, vdupq_n_f64(c[1]));
+        s1 = vfmsq_f64(s1, output, vdupq_n_f64(c[3]));
+        auto s2 = vfmsq_f64(vmulq_n_f64(value, c[2]), output, vdupq_n_f64(c[4]));
+        vst1q_f64(s, s1);
+        vst1q_f64(s + 2, s2);
+        value = output;
+      }
+      sum = vfmaq_f64(sum, value, value);
+    }
+    sumSquares[0] += vgetq_lane_f64(sum, 0);
+    sumSquares[1] += vgetq_lane_f64(sum, 1);
+    FlushBiquadState(state, static_cast<size_t>(stageCount) * 4);
+    return;
+  }
+#endif
+  FilterSumSquaresS16Scalar(src, channels, frameCount, coefficients, stageCount, state,
+                            sumSquares);
+  FlushBiquadState(state, static_cast<size_t>(stageCount) * 2 * channels);
+}
+}  // namespace ffmovie
@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ffmovie {
+/**
+ * Sample conversion kernels on interleaved PCM. The hot ones use SSE2 or NEON where available,
+ * and on x86-64 switch to AVX2 when the CPU supports it at runtime. The others are plain loops
+ * written for the compiler to vectorize. Counts are in samples of all the channels unless named
+ * frameCount, which counts samples per channel.
+ */
+
+void ConvertU8ToS16(const uint8_t* src, int16_t* dst, size_t count);
+
+/**
+ * Converts packed little-endian 24-bit samples by dropping the lowest byte.
+ */
+void ConvertS24ToS16(const uint8_t* src, int16_t* dst, size_t count);
+
+void ConvertS32ToS16(const int32_t* src, int16_t* dst, size_t count);
+
+/**
+ * Converts float samples in [-1, 1] with rounding, values out of the range are saturated.
+ */
+void ConvertF32ToS16(const float* src, int16_t* dst, size_t count);
+
+void ConvertMonoToStereoS16(const int16_t* src, int16_t* dst, size_t frameCount);
+
+/**
+ * Averages all the channels into one.
+ */
+void ConvertToMonoS16(const int16_t* src, int srcChannels, int16_t* dst, size_t frameCount);
+
+/**
+ * Converts to float samples in [-1, 1).
+ */
+void ConvertS16ToF32(const int16_t* src, float* dst, size_t count);
+
+/**
+ * Clamps float samples to [-1, 1].
+ */
+void ClampF32(const float* src, float* dst, size_t count);
+
+/**
+ * Converts float planes to interleaved s16 with rounding and saturation. Mono and stereo are
+ * specialized with AVX2, SSE2 or NEON, and the same plane may be passed for several channels.
+ */
+void InterleaveF32ToS16(const float* const* planes, int channels, int16_t* dst,
+                        size_t frameCount);
+
+void InterleaveS16(const int16_t* const* planes, int channels, int16_t* dst, size_t frameCount);
+
+/**
+ * Splits interleaved samples into float planes, scaling s16 to [-1, 1).
+ */
+void DeinterleaveS16ToF32(const int16_t* src, int channels, float* const* planes,
+                          size_t frameCount);
+
+void DeinterleaveF32(const float* src, int channels, float* const* planes, size_t frameCount);
+
+/**
+ * Mixes srcChannels float planes into dstChannels planes, where dst[i] is the sum of src[j] *
+ * matrix[i * srcChannels + j].
+ */
+void RemixF32(const float* const* src, int srcChannels, float* const* dst, int dstChannels,
+              const float* matrix, size_t frameCount);
+
+/**
+ * Folds the samples into the running minimum, maximum and sum of squares of a waveform bucket.
+ */
+void ReducePeakS16(const int16_t* src, size_t count, int16_t* minValue, int16_t* maxValue,
+                   uint64_t* sumSquares);
+
+/**
+ * Runs interleaved s16 samples scaled to [-1, 1) through a cascade of biquads in double precision
+ * and adds the squares of the filtered samples to sumSquares, one sum per channel. coefficients
+ * holds b0, b1, b2, a1, a2 of each stage, and state holds 2 * channels values per stage, which
+ * start at zero. Stereo filters both channels in one SSE2 or NEON vector.
+ */
+void FilterSumSquaresS16(const int16_t* src, int channels, size_t frameCount,
+                         const double* coefficients, int stageCount, double* state,
+                         double* sumSquares);
+
+/**
+ * Returns the sum of a[i] * b[i], the inner loop of the FIR filters.
+ */
+float DotProductF32(const float* a, const float* b, size_t count);
+
+/**
+ * Runs a polyphase FIR filter over src into count output samples. Each output is the dot product
+ * of taps input samples with the filter of its phase in coefficients, which holds upFactor filters
+ * of taps coefficients, and the input moves downFactor / upFactor samples per output. The first
+ * output starts at inputIndex with the filter of phase. taps must be a multiple of 8.
+ */
+void PolyphaseFilterF32(const float* src, const float* coefficients, int taps, int upFactor,
+                        int downFactor, int inputIndex, int phase, float* dst, size_t count);
+
+/**
+ * Adds the s16 samples scaled to [-1, 1) and multiplied by a gain to the float accumulator. The
+ * gain starts at startGain and changes by gainStep every frame, so a linear volume ramp costs the
+ * same as a constant volume. Uses AVX2 if the CPU supports it at runtime.
+ */
+void MixS16ToF32(const int16_t* src, float* dst, size_t frameCount, int channels, float startGain,
+                 float gainStep);
+}  // namespace ffmovie
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "PolyphaseResampler.h"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include "audio/process/AudioKernels.h"
+
+namespace ffmovie {
+#define MAX_POLYPHASE_PHASES 512
+#define MAX_DOWNSAMPLE_RATIO 4
+#define RESAMPLE_PI 3.14159265358979323846
+
+struct PolyphaseFilterBank {
+  int upFactor = 1;
+  int downFactor = 1;
+  // The samples each filter spans, padded with zero coefficients to a multiple of 8 for
+  // PolyphaseFilterF32.
+  int taps = 0;
+  // The input samples before the center of the filters.
+  int delay = 0;
+  // upFactor filters of taps coefficients, one per output phase.
+  std::vector<float> coefficients = {};
+};
+
+struct ResampleQualityParams {
+  int taps;
+  double beta;
+  double rolloff;
+};
+
+static ResampleQualityParams GetQualityParams(ResampleQuality quality) {
+  switch (quality) {
+    case ResampleQuality::Low:
+      return {16, 6.0, 0.85};
+    case ResampleQuality::High:
+      return {64, 10.0, 0.96};
+    default:
+      return {32, 8.0, 0.92};
+  }
+}
+
+static double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 50; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1e-12) {
+      break;
+    }
+  }
+  return sum;
+}
+
+static std::shared_ptr<const PolyphaseFilterBank> MakeFilterBank(int upFactor, int downFactor,
+                                                                 ResampleQuality quality) {
+  auto params = GetQualityParams(quality);
+  auto bank = std::make_shared<PolyphaseFilterBank>();
+  bank->upFactor = upFactor;
+  bank->downFactor = downFactor;
+  // Downsampling lowers the cutoff, the filter is stretched to keep the same transition band.
+  auto ratio = std::max(1.0, static_cast<double>(downFactor) / upFactor);
+  auto length = (static_cast<int>(std::ceil(params.taps * ratio)) + 3) & ~3;
+  bank->taps = (length + 7) & ~7;
+  auto taps = bank->taps;
+  auto half = length / 2;
+  bank->delay = half - 1;
+  // The cutoff in cycles per input sample.
+  auto cutoff = 0.5 * params.rolloff / ratio;
+  auto windowScale = 1.0 / BesselI0(params.beta);
+  bank->coefficients.resize(static_cast<size_t>(upFactor) * taps);
+  for (int phase = 0; phase < upFactor; phase++) {
+    auto filter = bank->coefficients.data() + static_cast<size_t>(phase) * taps;
+    double sum = 0.0;
+    for (int i = 0; i < length; i++) {
+      // The distance between the output position and the input sample the coefficient applies to.
+      auto distance = static_cast<double>(phase) / upFactor + half - 1 - i;
+      auto position = distance / half;
+      auto window = position * position < 1.0
+                        ? BesselI0(params.beta * std::sqrt(1.0 - position * position)) * windowScale
+                        : 0.0;
+      auto x = 2.0 * cutoff * distance;
+      auto sinc = x == 0.0 ? 1.0 : std::sin(RESAMPLE_PI * x) / (RESAMPLE_PI * x);
+      auto value = 2.0 * cutoff * sinc * window;
+      filter[i] = static_cast<float>(value);
+      sum += value;
+    }
+    // Normalizes every phase to unity gain at DC.
+    for (int i = 0; i < length; i++) {
+      filter[i] = static_cast<float>(filter[i] / sum);
+    }
+  }
+  return bank;
+}
+
+static std::shared_ptr<const PolyphaseFilterBank> GetFilterBank(int upFactor, int downFactor,
+                                                                ResampleQuality quality) {
+  static std::mutex locker = {};
+  static std::map<std::tuple<int, int, int>, std::weak_ptr<const PolyphaseFilterBank>> banks = {};
+  std::lock_guard<std::mutex> autoLock(locker);
+  auto& entry = banks[std::make_tuple(upFactor, downFactor, static_cast<int>(quality))];
+  auto bank = entry.lock();
+  if (bank == nullptr) {
+    bank = MakeFilterBank(upFactor, downFactor, quality);
+    entry = bank;
+  }
+  return bank;
+}
+
+std::unique_ptr<PolyphaseResampler> PolyphaseResampler::Make(int inputRate, int outputRate,
+                                                             int channels,
+                                                             ResampleQuality quality) {
+  if (inputRate <= 0 || outputRate <= 0 || channels <= 0) {
+    return nullptr;
+  }
+  auto divisor = std::gcd(inputRate, outputRate);
+  auto upFactor = outputRate / divisor;
+  auto downFactor = inputRate / divisor;
+  if (upFactor > MAX_POLYPHASE_PHASES || downFactor > upFactor * MAX_DOWNSAMPLE_RATIO) {
+    return nullptr;
+  }
+  auto resampler = std::unique_ptr<PolyphaseResampler>(new PolyphaseResampler());
+  resampler->bank = GetFilterBank(upFactor, downFactor, quality);
+  resampler->_inputRate = inputRate;
+  resampler->_outputRate = outputRate;
+  resampler->_channels = channels;
+  resampler->history.resize(channels);
+  resampler->reset();
+  return resampler;
+}
+
+void PolyphaseResampler::reset() {
+  // The first output sample is centered on the first input sample, the filter needs half of its
+  // taps before it.
+  bufferedCount = bank->delay;
+  for (auto& buffer : history) {
+    buffer.assign(bufferedCount, 0.0f);
+  }
+  inputIndex = 0;
+  phase = 0;
+  totalInputCount = 0;
+  totalOutputCount = 0;
+}
+
+int PolyphaseResampler::maxOutputCount(int inputCount) const {
+  auto count = static_cast<int64_t>(bufferedCount + inputCount + bank->taps) * bank->upFactor /
+               bank->downFactor;
+  return static_cast<int>(count) + 1;
+}
+
+void PolyphaseResampler::append(const float* const* src, int count) {
+  auto size = static_cast<size_t>(bufferedCount + count);
+  for (int channel = 0; channel < _channels; channel++) {
+    auto& buffer = history[channel];
+    if (buffer.size() < size) {
+      buffer.resize(size);
+    }
+    if (src != nullptr) {
+      memcpy(buffer.data() + bufferedCount, src[channel], count * sizeof(float));
+    } else {
+      memset(buffer.data() + bufferedCount, 0, count * sizeof(float));
+    }
+  }
+  bufferedCount += count;
+}
+
+int PolyphaseResampler::produce(float* const* dst, int64_t maxTotalOutputCount) {
+  auto taps = bank->taps;
+  auto upFactor = bank->upFactor;
+  auto downFactor = bank->downFactor;
+  // Counts the output samples the buffered input covers first, then filters every channel in one
+  // pass from the same position.
+  auto startIndex = inputIndex;
+  auto startPhase = phase;
+  int count = 0;
+  while (inputIndex + taps <= bufferedCount && totalOutputCount < maxTotalOutputCount) {
+    count++;
+    totalOutputCount++;
+    phase += downFactor;
+    while (phase >= upFactor) {
+      phase -= upFactor;
+      inputIndex++;
+    }
+  }
+  for (int channel = 0; channel < _channels; channel++) {
+    PolyphaseFilterF32(history[channel].data(), bank->coefficients.data(), taps, upFactor,
+                       downFactor, startIndex, startPhase, dst[channel], count);
+  }
+  // Keeps only the input the next output samples still need.
+  auto consumed = std::min(inputIndex, bufferedCount);
+  if (consumed > 0) {
+    for (auto& buffer : history) {
+      memmove(buffer.data(), buffer.data() + consumed, (bufferedCount - consumed) * sizeof(float));
+    }
+    bufferedCount -= consumed;
+    inputIndex -= consumed;
+  }
+  return count;
+}
+
+int PolyphaseResampler::process(const float* const* src, int inputCount, float* const* dst) {
+  if (inputCount <= 0) {
+    return 0;
+  }
+  append(src, inputCount);
+  totalInputCount += inputCount;
+  return produce(dst, INT64_MAX);
+}
+
+int PolyphaseResampler::flush(float* const* dst) {
+  // Pads silence after the input and stops at the length of the resampled stream.
+  auto totalCount = (totalInputCount * bank->upFactor + bank->downFactor - 1) / bank->downFactor;
+  append(nullptr, bank->taps);
+  return produce(dst, totalCount);
+}
+}  // namespace ffmovie
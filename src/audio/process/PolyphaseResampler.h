@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "ffmovie/movie.h"
+
+namespace ffmovie {
+struct PolyphaseFilterBank;
+
+/**
+ * Converts float planes between two sample rates with a windowed-sinc polyphase filter. It works
+ * for the ratios that reduce to a small fraction, such as 44.1kHz <-> 48kHz (147:160) or
+ * 22.05kHz -> 44.1kHz (1:2). The filter banks are computed once per ratio and quality and shared
+ * by all the resamplers.
+ */
+class PolyphaseResampler {
+ public:
+  /**
+   * Returns nullptr if the ratio needs more filter phases than allowed, the caller should use
+   * swresample then.
+   */
+  static std::unique_ptr<PolyphaseResampler> Make(int inputRate, int outputRate, int channels,
+                                                  ResampleQuality quality);
+
+  int inputRate() const {
+    return _inputRate;
+  }
+
+  int outputRate() const {
+    return _outputRate;
+  }
+
+  int channels() const {
+    return _channels;
+  }
+
+  /**
+   * Returns the maximum number of samples per channel that process() or flush() outputs for
+   * inputCount more input samples.
+   */
+  int maxOutputCount(int inputCount) const;
+
+  /**
+   * Resamples inputCount samples of every plane in src into the planes in dst, which must have
+   * room for maxOutputCount(inputCount) samples. Returns the number of samples written per
+   * channel.
+   */
+  int process(const float* const* src, int inputCount, float* const* dst);
+
+  /**
+   * Outputs the samples still held back by the filter at the end of the input.
+   */
+  int flush(float* const* dst);
+
+  /**
+   * Drops the buffered input, so the next process() starts a new stream.
+   */
+  void reset();
+
+ private:
+  std::shared_ptr<const PolyphaseFilterBank> bank = nullptr;
+  int _inputRate = 0;
+  int _outputRate = 0;
+  int _channels = 0;
+  std::vector<std::vector<float>> history = {};
+  int bufferedCount = 0;
+  int inputIndex = 0;
+  int phase = 0;
+  int64_t totalInputCount = 0;
+  int64_t totalOutputCount = 0;
+
+  PolyphaseResampler() = default;
+  void append(const float* const* src, int count);
+  int produce(float* const* dst, int64_t maxTotalOutputCount);
+};
+}  // namespace ffmovie
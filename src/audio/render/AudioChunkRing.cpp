@@ -0,0 +1,55 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AudioChunkRing.h"
+#include <algorithm>
+
+namespace ffmovie {
+AudioChunkRing::AudioChunkRing(int chunkCount, size_t chunkSize) {
+  chunks.resize(static_cast<size_t>(std::max(chunkCount, 1)));
+  for (auto& chunk : chunks) {
+    chunk.data.resize(chunkSize);
+  }
+}
+
+AudioChunk* AudioChunkRing::beginWrite() {
+  auto write = writeIndex.load(std::memory_order_relaxed);
+  auto read = readIndex.load(std::memory_order_acquire);
+  if (write - read >= chunks.size()) {
+    return nullptr;
+  }
+  return &chunks[write % chunks.size()];
+}
+
+void AudioChunkRing::endWrite() {
+  writeIndex.store(writeIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const AudioChunk* AudioChunkRing::front() {
+  auto read = readIndex.load(std::memory_order_relaxed);
+  auto write = writeIndex.load(std::memory_order_acquire);
+  if (read == write) {
+    return nullptr;
+  }
+  return &chunks[read % chunks.size()];
+}
+
+void AudioChunkRing::pop() {
+  readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+}  // namespace ffmovie
@@ -0,0 +1,73 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ffmovie {
+/**
+ * A chunk of samples in AudioChunkRing, allocated once with the ring.
+ */
+struct AudioChunk {
+  std::vector<uint8_t> data = {};
+  int frameCount = 0;
+  int64_t time = 0;
+  // The seek the chunk was decoded after, chunks of an older seek are dropped by the consumer.
+  int64_t generation = 0;
+};
+
+/**
+ * A lock-free single-producer single-consumer ring of fixed-size audio chunks. Both sides are
+ * wait-free, each index is written by one side only and published with release ordering.
+ */
+class AudioChunkRing {
+ public:
+  AudioChunkRing(int chunkCount, size_t chunkSize);
+
+  /**
+   * Returns the next free chunk to fill, or nullptr if the ring is full. Producer only.
+   */
+  AudioChunk* beginWrite();
+
+  /**
+   * Publishes the chunk returned by beginWrite() to the consumer. Producer only.
+   */
+  void endWrite();
+
+  /**
+   * Returns the oldest published chunk, or nullptr if the ring is empty. Consumer only.
+   */
+  const AudioChunk* front();
+
+  /**
+   * Releases the chunk returned by front() to the producer. Consumer only.
+   */
+  void pop();
+
+ private:
+  std::vector<AudioChunk> chunks = {};
+  // Both indices only grow, the slot is the index modulo the chunk count. They live on separate
+  // cache lines so the two threads do not invalidate each other on every update.
+  alignas(64) std::atomic<size_t> writeIndex{0};
+  alignas(64) std::atomic<size_t> readIndex{0};
+};
+}  // namespace ffmovie
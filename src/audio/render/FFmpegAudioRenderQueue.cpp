@@ -0,0 +1,188 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegAudioRenderQueue.h"
+#include <cstring>
+
+namespace ffmovie {
+#define MIN_RENDER_QUEUE_CHUNKS 2
+// In microseconds.
+#define MIN_WORKER_POLL_INTERVAL 1000
+
+std::unique_ptr<FFAudioRenderQueue> FFAudioRenderQueue::Make(
+    FFAudioDecoder* decoder, std::shared_ptr<AudioOutputConfig> config, int chunkCount) {
+  if (decoder == nullptr || config == nullptr || config->sampleRate <= 0) {
+    return nullptr;
+  }
+  // Mirrors the output config of FFAudioDecoder.
+  auto outputConfig = std::make_shared<PCMOutputConfig>();
+  outputConfig->sampleRate = config->sampleRate;
+  outputConfig->channels = config->channels;
+  outputConfig->outputSamplesCount =
+      config->outputSamplesCount > 0 ? config->outputSamplesCount : DEFAULT_OUTPUT_SAMPLE_COUNT;
+  auto queue = std::unique_ptr<FFmpegAudioRenderQueue>(new FFmpegAudioRenderQueue(
+      decoder, std::move(outputConfig), std::max(chunkCount, MIN_RENDER_QUEUE_CHUNKS)));
+  queue->worker = std::thread(&FFmpegAudioRenderQueue::workLoop, queue.get());
+  return queue;
+}
+
+FFmpegAudioRenderQueue::FFmpegAudioRenderQueue(FFAudioDecoder* decoder,
+                                               std::shared_ptr<PCMOutputConfig> outputConfig,
+                                               int chunkCount)
+    : decoder(decoder), outputConfig(std::move(outputConfig)), chunkCount(chunkCount) {
+  frameSize = static_cast<size_t>(SampleCountToLength(1, this->outputConfig.get()));
+  ring = std::make_unique<AudioChunkRing>(chunkCount,
+                                          frameSize * this->outputConfig->outputSamplesCount);
+}
+
+FFmpegAudioRenderQueue::~FFmpegAudioRenderQueue() {
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    exiting = true;
+  }
+  condition.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+int FFmpegAudioRenderQueue::read(void* output, int frameCount) {
+  if (output == nullptr || frameCount <= 0) {
+    return 0;
+  }
+  auto currentGeneration = generation.load(std::memory_order_acquire);
+  auto buffer = static_cast<uint8_t*>(output);
+  int copiedCount = 0;
+  while (copiedCount < frameCount) {
+    auto chunk = ring->front();
+    if (chunk == nullptr) {
+      break;
+    }
+    if (chunk->generation != currentGeneration) {
+      ring->pop();
+      readFrameOffset = 0;
+      continue;
+    }
+    auto count = std::min(chunk->frameCount - readFrameOffset, frameCount - copiedCount);
+    memcpy(buffer + copiedCount * frameSize, chunk->data.data() + readFrameOffset * frameSize,
+           count * frameSize);
+    copiedCount += count;
+    readFrameOffset += count;
+    auto offsetTime =
+        static_cast<int64_t>(readFrameOffset) * AV_TIME_BASE / outputConfig->sampleRate;
+    presentationTime.store(chunk->time + offsetTime, std::memory_order_relaxed);
+    presentationGeneration.store(currentGeneration, std::memory_order_release);
+    if (readFrameOffset == chunk->frameCount) {
+      ring->pop();
+      readFrameOffset = 0;
+    }
+  }
+  if (copiedCount < frameCount) {
+    memset(buffer + copiedCount * frameSize, 0, (frameCount - copiedCount) * frameSize);
+    if (readyGeneration.load(std::memory_order_acquire) == currentGeneration &&
+        endedGeneration.load(std::memory_order_acquire) != currentGeneration) {
+      underruns.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  return copiedCount;
+}
+
+void FFmpegAudioRenderQueue::seekTo(int64_t targetTime) {
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    seekTime.store(targetTime, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+  }
+  condition.notify_all();
+}
+
+int64_t FFmpegAudioRenderQueue::currentPresentationTime() {
+  auto currentGeneration = generation.load(std::memory_order_acquire);
+  if (presentationGeneration.load(std::memory_order_acquire) != currentGeneration) {
+    // Nothing of the current seek has been read yet.
+    return seekTime.load(std::memory_order_relaxed);
+  }
+  return presentationTime.load(std::memory_order_relaxed);
+}
+
+int64_t FFmpegAudioRenderQueue::underrunCount() {
+  return underruns.load(std::memory_order_relaxed);
+}
+
+bool FFmpegAudioRenderQueue::isEnded() {
+  auto currentGeneration = generation.load(std::memory_order_acquire);
+  if (endedGeneration.load(std::memory_order_acquire) != currentGeneration) {
+    return false;
+  }
+  // Chunks of older generations left in the ring are dropped by the next read().
+  auto chunk = ring->front();
+  return chunk == nullptr || chunk->generation != currentGeneration;
+}
+
+void FFmpegAudioRenderQueue::workLoop() {
+  // Polls for free chunks at half the duration of a chunk, the real-time thread never signals.
+  auto pollInterval = std::max(static_cast<int64_t>(outputConfig->outputSamplesCount) *
+                                   AV_TIME_BASE / outputConfig->sampleRate / 2,
+                               static_cast<int64_t>(MIN_WORKER_POLL_INTERVAL));
+  int64_t workerGeneration = 0;
+  int generationChunkCount = 0;
+  bool decoderEnded = false;
+  while (true) {
+    auto currentGeneration = generation.load(std::memory_order_acquire);
+    if (currentGeneration != workerGeneration) {
+      workerGeneration = currentGeneration;
+      generationChunkCount = 0;
+      decoder->seekTo(seekTime.load(std::memory_order_relaxed));
+      decoderEnded = false;
+    }
+    // A full ring right after a seek is still holding the chunks of the old generation, so it says
+    // nothing about the new one.
+    auto chunk = decoderEnded ? nullptr : ring->beginWrite();
+    if (chunk == nullptr) {
+      std::unique_lock<std::mutex> autoLock(locker);
+      condition.wait_for(autoLock, std::chrono::microseconds(pollInterval), [&] {
+        return exiting || generation.load(std::memory_order_relaxed) != workerGeneration;
+      });
+      if (exiting) {
+        return;
+      }
+      continue;
+    }
+    auto samples = decoder->readNextChunk();
+    if (samples.empty()) {
+      decoderEnded = true;
+      readyGeneration.store(workerGeneration, std::memory_order_release);
+      endedGeneration.store(workerGeneration, std::memory_order_release);
+      continue;
+    }
+    auto length = std::min(static_cast<size_t>(samples.length), chunk->data.size());
+    memcpy(chunk->data.data(), samples.data, length);
+    chunk->frameCount = static_cast<int>(length / frameSize);
+    chunk->time = decoder->currentPresentationTime();
+    chunk->generation = workerGeneration;
+    ring->endWrite();
+    if (++generationChunkCount == chunkCount) {
+      readyGeneration.store(workerGeneration, std::memory_order_release);
+    }
+    std::lock_guard<std::mutex> autoLock(locker);
+    if (exiting) {
+      return;
+    }
+  }
+}
+}  // namespace ffmovie
@@ -0,0 +1,78 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "audio/AudioUtils.h"
+#include "audio/render/AudioChunkRing.h"
+#include "ffmovie/movie.h"
+
+namespace ffmovie {
+class FFmpegAudioRenderQueue : public FFAudioRenderQueue {
+ public:
+  ~FFmpegAudioRenderQueue() override;
+
+  int read(void* output, int frameCount) override;
+
+  void seekTo(int64_t targetTime) override;
+
+  int64_t currentPresentationTime() override;
+
+  int64_t underrunCount() override;
+
+  bool isEnded() override;
+
+ private:
+  FFAudioDecoder* decoder = nullptr;
+  std::shared_ptr<PCMOutputConfig> outputConfig = nullptr;
+  std::unique_ptr<AudioChunkRing> ring = nullptr;
+  int chunkCount = 0;
+  size_t frameSize = 0;
+  std::thread worker = {};
+  std::mutex locker = {};
+  std::condition_variable condition = {};
+  bool exiting = false;
+
+  // Every seekTo() starts a new generation. The worker seeks the decoder once it sees it, and the
+  // consumer drops the chunks of older generations, so the ring is drained without the worker ever
+  // touching the consumer side.
+  std::atomic<int64_t> generation{0};
+  std::atomic<int64_t> seekTime{0};
+  // The generation the worker wrote a whole ring of chunks in, underruns before that are the queue
+  // filling up and are not counted.
+  std::atomic<int64_t> readyGeneration{-1};
+  // The generation the decoder reached the end of stream in.
+  std::atomic<int64_t> endedGeneration{-1};
+  std::atomic<int64_t> underruns{0};
+
+  // Written by the consumer only.
+  int readFrameOffset = 0;
+  std::atomic<int64_t> presentationTime{0};
+  std::atomic<int64_t> presentationGeneration{0};
+
+  FFmpegAudioRenderQueue(FFAudioDecoder* decoder, std::shared_ptr<PCMOutputConfig> outputConfig,
+                         int chunkCount);
+
+  void workLoop();
+
+  friend FFAudioRenderQueue;
+};
+}  // namespace ffmovie
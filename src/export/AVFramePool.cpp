@@ -0,0 +1,63 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "AVFramePool.h"
+
+namespace ffmovie {
+#define FRAME_BUFFER_ALIGNMENT 32
+
+AVFramePool::~AVFramePool() {
+  for (auto& frame : freeFrames) {
+    av_frame_free(&frame);
+  }
+}
+
+AVFrame* AVFramePool::obtain() {
+  for (auto iter = freeFrames.begin(); iter != freeFrames.end(); ++iter) {
+    if (av_frame_is_writable(*iter)) {
+      auto frame = *iter;
+      freeFrames.erase(iter);
+      return frame;
+    }
+  }
+  auto frame = av_frame_alloc();
+  if (frame == nullptr) {
+    return nullptr;
+  }
+  frame->width = _width;
+  frame->height = _height;
+  frame->format = format;
+  if (av_frame_get_buffer(frame, FRAME_BUFFER_ALIGNMENT) < 0) {
+    av_frame_free(&frame);
+    return nullptr;
+  }
+  return frame;
+}
+
+void AVFramePool::recycle(AVFrame* frame) {
+  if (frame == nullptr) {
+    return;
+  }
+  if (frame->width != _width || frame->height != _height || frame->format != format ||
+      freeFrames.size() >= maxFreeFrames) {
+    av_frame_free(&frame);
+    return;
+  }
+  freeFrames.push_back(frame);
+}
+}  // namespace ffmovie
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <libavutil/frame.h>
+
+#ifdef __cplusplus
+}
+#endif
+
+#include <cstddef>
+#include <vector>
+
+namespace ffmovie {
+/**
+ * AVFramePool recycles the AVFrames sent to an encoder, so the picture buffers are allocated once
+ * instead of per frame. A recycled frame is only handed out again once the codec dropped its own
+ * references to the buffers. The strides of the frames are multiples of 32 bytes. The pool is not
+ * thread-safe.
+ */
+class AVFramePool {
+ public:
+  AVFramePool(int width, int height, AVPixelFormat format, size_t maxFreeFrames)
+      : _width(width), _height(height), format(format), maxFreeFrames(maxFreeFrames) {
+  }
+
+  ~AVFramePool();
+
+  AVFramePool(const AVFramePool&) = delete;
+
+  AVFramePool& operator=(const AVFramePool&) = delete;
+
+  int width() const {
+    return _width;
+  }
+
+  int height() const {
+    return _height;
+  }
+
+  AVPixelFormat pixelFormat() const {
+    return format;
+  }
+
+  /**
+   * Returns a frame whose buffers are not referenced anywhere else, or creates a new one. Returns
+   * nullptr if the buffers can not be allocated.
+   */
+  AVFrame* obtain();
+
+  /**
+   * Returns the frame to the pool. The frame is freed if the pool is full or the frame does not
+   * match the pool.
+   */
+  void recycle(AVFrame* frame);
+
+ private:
+  int _width = 0;
+  int _height = 0;
+  AVPixelFormat format = AV_PIX_FMT_NONE;
+  size_t maxFreeFrames = 0;
+  std::vector<AVFrame*> freeFrames = {};
+};
+}  // namespace ffmovie
@@ -0,0 +1,95 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "EncoderSpeedController.h"
+#include <algorithm>
+
+namespace ffmovie {
+#define CHECK_INTERVAL_FRAMES 15
+// Speeds up once the codec uses more than this share of the frame budget.
+#define SPEED_UP_LOAD 0.95
+// Slows down only below this share, the gap keeps the level from flipping.
+#define SLOW_DOWN_LOAD 0.7
+// Frames the queue may grow by between two checks before the codec is considered behind.
+#define MAX_QUEUE_GROWTH 2
+#define CALM_CHECKS_TO_SLOW_DOWN 2
+// A speed up that shortens the frame time by less than this share is undone.
+#define MIN_SPEED_UP_GAIN 0.05
+
+EncoderSpeedController::EncoderSpeedController(float targetFrameRate, int maxLevel)
+    : maxLevel(std::max(maxLevel, 0)), levelLimit(this->maxLevel) {
+  _stats.frameBudget = targetFrameRate > 0 ? static_cast<int64_t>(1000000 / targetFrameRate) : 0;
+}
+
+SpeedDecision EncoderSpeedController::update(int64_t frameTime, int queueDepth,
+                                             bool pipelineFilled) {
+  _stats.frameCount++;
+  _stats.queueDepth = queueDepth;
+  windowFrameTime += frameTime;
+  decided = ++framesSinceCheck >= CHECK_INTERVAL_FRAMES;
+  if (!decided) {
+    return SpeedDecision::Hold;
+  }
+  // The mean of this window only, a level set at the last check covers all of it, where a moving
+  // average would still carry most of the frames of the level before.
+  auto averageFrameTime = static_cast<double>(windowFrameTime) / framesSinceCheck;
+  _stats.frameTime = static_cast<int64_t>(averageFrameTime);
+  windowFrameTime = 0;
+  framesSinceCheck = 0;
+  // Until the first packet comes out the queue grows by the delay of the codec, its lookahead and
+  // frame threads, which is no backlog. The depth it settles at is the baseline for the growth.
+  int queueGrowth = 0;
+  if (pipelineFilled) {
+    if (hasQueueBaseline) {
+      queueGrowth = queueDepth - lastQueueDepth;
+    }
+    hasQueueBaseline = true;
+    lastQueueDepth = queueDepth;
+  }
+  auto load = _stats.frameBudget > 0 ? averageFrameTime / _stats.frameBudget : 0;
+  auto overloaded = load > SPEED_UP_LOAD || queueGrowth > MAX_QUEUE_GROWTH;
+  auto decision = SpeedDecision::Hold;
+  if (speedUpFrameTime > 0 && overloaded &&
+      averageFrameTime > speedUpFrameTime * (1 - MIN_SPEED_UP_GAIN)) {
+    // The last level lowered the quality without making the codec faster, it is undone and not
+    // tried again until the load drops.
+    calmChecks = 0;
+    decision = SpeedDecision::SlowDown;
+    _stats.speedLevel--;
+    levelLimit = _stats.speedLevel;
+  } else if (overloaded) {
+    calmChecks = 0;
+    if (_stats.speedLevel < levelLimit) {
+      decision = SpeedDecision::SpeedUp;
+      _stats.speedLevel++;
+    }
+  } else if (load < SLOW_DOWN_LOAD && queueGrowth <= 0) {
+    levelLimit = maxLevel;
+    if (++calmChecks >= CALM_CHECKS_TO_SLOW_DOWN && _stats.speedLevel > 0) {
+      calmChecks = 0;
+      decision = SpeedDecision::SlowDown;
+      _stats.speedLevel--;
+    }
+  } else {
+    calmChecks = 0;
+  }
+  speedUpFrameTime = decision == SpeedDecision::SpeedUp ? averageFrameTime : 0;
+  _stats.decision = decision;
+  return decision;
+}
+}  // namespace ffmovie
@@ -0,0 +1,77 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include "ffmovie/movie.h"
+
+namespace ffmovie {
+/**
+ * EncoderSpeedController holds a target frame rate by moving the encoder through speed levels. It
+ * is fed the time the codec spent on each frame and the number of frames queued behind it, and
+ * every few frames decides whether the next level is needed. The thresholds for speeding up and
+ * slowing down are apart, and slowing down needs two calm checks in a row, so it does not flip
+ * between two levels. A level that does not shorten the frame time is undone and not tried again
+ * until the load drops, so a codec that can not go faster keeps its quality. Not thread-safe.
+ */
+class EncoderSpeedController {
+ public:
+  /**
+   * Levels go from 0, the configured settings, to maxLevel, the fastest ones.
+   */
+  EncoderSpeedController(float targetFrameRate, int maxLevel);
+
+  /**
+   * Adds the codec time of one frame in microseconds and the queue depth after it. The growth of
+   * the queue only counts once pipelineFilled is true, that is once the codec output its first
+   * packet. Returns the decision of this frame, which is Hold except once every few frames.
+   */
+  SpeedDecision update(int64_t frameTime, int queueDepth, bool pipelineFilled);
+
+  /**
+   * Returns true if the last update() made a decision and filled the stats.
+   */
+  bool hasDecision() const {
+    return decided;
+  }
+
+  int level() const {
+    return _stats.speedLevel;
+  }
+
+  const VideoEncoderStats& stats() const {
+    return _stats;
+  }
+
+ private:
+  int maxLevel = 0;
+  // Lowered below maxLevel after a level that did not help.
+  int levelLimit = 0;
+  // The codec time of the frames since the last check.
+  int64_t windowFrameTime = 0;
+  // The mean frame time of the window before the last check if it sped up, 0 if it did not.
+  double speedUpFrameTime = 0;
+  int framesSinceCheck = 0;
+  int calmChecks = 0;
+  bool hasQueueBaseline = false;
+  int lastQueueDepth = 0;
+  bool decided = false;
+  VideoEncoderStats _stats = {};
+};
+}  // namespace ffmovie
@@ -17,10 +17,15 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "FFmpegAudioEncoder.h"
+#include <algorithm>
+#include "export/FFmpegParallelAudioEncoder.h"
 #include "utils/StringUtils.h"
 
 namespace ffmovie {
 std::unique_ptr<FFAudioEncoder> FFAudioEncoder::Make(const AudioExportConfig& config) {
+  if (config.parallelEncoding) {
+    return std::unique_ptr<FFmpegParallelAudioEncoder>(new FFmpegParallelAudioEncoder(config));
+  }
   return std::unique_ptr<FFmpegAudioEncoder>(new FFmpegAudioEncoder(config));
 }
 
@@ -37,8 +42,8 @@ FFmpegAudioEncoder::~FFmpegAudioEncoder() {
   if (packet) {
     av_packet_free(&packet);
   }
-  if (srcFrame) {
-    av_frame_free(&srcFrame);
+  if (convertFrame) {
+    av_frame_free(&convertFrame);
   }
 }
 
@@ -69,46 +74,103 @@ bool FFmpegAudioEncoder::initEncoder() {
     return false;
   }
 
-  if (!createSrcFrame()) {
+  if (!createFifos()) {
+    return false;
+  }
+
+  // The input is always interleaved s16 in the rate and the channels of the config.
+  auto needResample = (audioEncoderConfig.channels != codecContext->channels) ||
+                      (audioEncoderConfig.sampleRate != codecContext->sample_rate) ||
+                      (AUDIO_OUT_FORMAT != codecContext->sample_fmt);
+  if (needResample && !initResampleContext()) {
+    msgs.emplace_back("AudioEncoder: initResampleContext failed.");
     return false;
   }
   return true;
 }
 
-CodingResult FFmpegAudioEncoder::onSendData(uint8_t* data, int64_t length, int sampleCount) {
-  srcFrame->data[0] = data;
-  srcFrame->linesize[0] = length;
-  srcFrame->nb_samples = sampleCount;
-  if (srcFrame != nullptr && srcFrame->sample_rate != codecContext->sample_rate) {
-    msgs.emplace_back("AudioEncoder: src Frame invalid.");
+CodingResult FFmpegAudioEncoder::onSendData(uint8_t* data, int64_t, int sampleCount) {
+  if (inputEnded) {
+    msgs.emplace_back("AudioEncoder: data sent after the end of stream.");
     return CodingResult::CodingError;
   }
-
-  needResample = (srcFrame->channels != codecContext->channels) ||
-                 (srcFrame->sample_rate != codecContext->sample_rate) ||
-                 (srcFrame->format != codecContext->sample_fmt);
-  if (needResample && !initResampleContext(srcFrame)) {
-    msgs.emplace_back("AudioEncoder: initResampleContext failed.");
+  if (data == nullptr || sampleCount <= 0) {
+    return CodingResult::CodingSuccess;
+  }
+  // The samples only go into the FIFOs here, onEncodeData() cuts them into codec frames, since the
+  // codec takes no new frame until its packet is received.
+  if (swrContext == nullptr) {
+    return writeToFifos(&data, sampleCount) ? CodingResult::CodingSuccess
+                                            : CodingResult::CodingError;
+  }
+  if (!reserveConvertFrame(swr_get_out_samples(swrContext, sampleCount))) {
     return CodingResult::CodingError;
   }
+  const uint8_t* input[] = {data};
+  int convertedSamples =
+      swr_convert(swrContext, convertFrame->data, convertFrame->nb_samples, input, sampleCount);
+  if (convertedSamples < 0) {
+    msgs.emplace_back("Error while converting");
+    return CodingResult::CodingError;
+  }
+  return writeToFifos(convertFrame->data, convertedSamples) ? CodingResult::CodingSuccess
+                                                            : CodingResult::CodingError;
+}
 
-  if (needResample) {
-    /* convert to destination format */
-    int convertedSamples = swr_convert(swrContext, frame->data, frame->nb_samples,
-                                       (const uint8_t**)(srcFrame->data), srcFrame->nb_samples);
+CodingResult FFmpegAudioEncoder::onEndOfStream() {
+  if (inputEnded) {
+    return CodingResult::CodingSuccess;
+  }
+  inputEnded = true;
+  // Drains the samples still buffered in the resampler, the FIFOs are drained by onEncodeData().
+  while (swrContext != nullptr) {
+    if (!reserveConvertFrame(swr_get_out_samples(swrContext, 0))) {
+      return CodingResult::CodingError;
+    }
+    int convertedSamples =
+        swr_convert(swrContext, convertFrame->data, convertFrame->nb_samples, nullptr, 0);
     if (convertedSamples < 0) {
-      msgs.emplace_back("Error while converting");
+      msgs.emplace_back("Error while flushing the resampler");
+      return CodingResult::CodingError;
+    }
+    if (convertedSamples == 0) {
+      break;
+    }
+    if (!writeToFifos(convertFrame->data, convertedSamples)) {
       return CodingResult::CodingError;
     }
-
-    return sendFrame(frame);
-  } else {
-    return sendFrame(srcFrame);
   }
+  return CodingResult::CodingSuccess;
 }
 
-CodingResult FFmpegAudioEncoder::onEndOfStream() {
-  return sendFrame(nullptr);
+CodingResult FFmpegAudioEncoder::sendPendingFrame() {
+  auto pendingSamples = fifos[0]->size();
+  if (pendingSamples < frameSamples && (!inputEnded || flushSent)) {
+    return CodingResult::TryAgainLater;
+  }
+  if (pendingSamples == 0) {
+    flushSent = true;
+    return sendFrame(nullptr);
+  }
+  frame->nb_samples = frameSamples;
+  if (av_frame_make_writable(frame) < 0) {
+    msgs.emplace_back("AudioEncoder: the frame is not writable.");
+    return CodingResult::CodingError;
+  }
+  auto sampleCount = std::min(pendingSamples, frameSamples);
+  for (size_t plane = 0; plane < fifos.size(); plane++) {
+    fifos[plane]->read(frame->data[plane], sampleCount);
+  }
+  frame->nb_samples = sampleCount;
+  if (sampleCount < frameSamples &&
+      (codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) == 0 &&
+      (codecContext->codec->capabilities & AV_CODEC_CAP_SMALL_LAST_FRAME) == 0) {
+    // The codec takes no short last frame, the remainder is padded with silence.
+    av_samples_set_silence(frame->data, sampleCount, frameSamples - sampleCount,
+                           codecContext->channels, codecContext->sample_fmt);
+    frame->nb_samples = frameSamples;
+  }
+  return sendFrame(frame);
 }
 
 CodingResult FFmpegAudioEncoder::sendFrame(AVFrame* audioFrame) {
@@ -130,24 +192,26 @@ CodingResult FFmpegAudioEncoder::sendFrame(AVFrame* audioFrame) {
 }
 
 CodingResult FFmpegAudioEncoder::onEncodeData(void** encodedPacket) {
-  auto result = avcodec_receive_packet(codecContext, packet);
-  if (result == 0) {
-    *encodedPacket = packet;
-    return CodingResult::CodingSuccess;
-  } else if (result == AVERROR(EAGAIN)) {
-    return CodingResult::TryAgainLater;
-  } else if (result == AVERROR_EOF) {
-    return CodingResult::EndOfStream;
-  } else {
-    return CodingResult::CodingError;
+  while (true) {
+    auto result = avcodec_receive_packet(codecContext, packet);
+    if (result == 0) {
+      *encodedPacket = packet;
+      return CodingResult::CodingSuccess;
+    } else if (result == AVERROR_EOF) {
+      return CodingResult::EndOfStream;
+    } else if (result != AVERROR(EAGAIN)) {
+      return CodingResult::CodingError;
+    }
+    // The codec wants more input, feeds it the next frame from the FIFOs if there is one.
+    auto sendResult = sendPendingFrame();
+    if (sendResult != CodingResult::CodingSuccess) {
+      return sendResult;
+    }
   }
 }
 
 FFmpegAudioEncoder::FFmpegAudioEncoder(const AudioExportConfig& config)
     : audioEncoderConfig(std::move(config)) {
-  lastAudioFrameConfig.channels = -1;
-  lastAudioFrameConfig.sampleRate = -1;
-  lastAudioFormat = AV_SAMPLE_FMT_NONE;
 }
 
 bool FFmpegAudioEncoder::initCodecContext() {
@@ -218,27 +282,16 @@ void FFmpegAudioEncoder::initEncodeChannelLayout() {
   codecContext->channels = av_get_channel_layout_nb_channels(codecContext->channel_layout);
 }
 
-bool FFmpegAudioEncoder::initResampleContext(AVFrame* avFrame) {
-  bool isSameConfigWithLastAudioFrame = (lastAudioFrameConfig.channels == avFrame->channels) &&
-                                        (lastAudioFrameConfig.sampleRate == avFrame->sample_rate) &&
-                                        (lastAudioFormat == avFrame->format);
-  if (isSameConfigWithLastAudioFrame && swrContext) {
-    return true;
-  }
-
-  if (swrContext) {
-    swr_free(&swrContext);
-  }
+bool FFmpegAudioEncoder::initResampleContext() {
   swrContext = swr_alloc();
   if (!swrContext) {
     msgs.emplace_back("Could not allocate resampler context");
     return false;
   }
 
-  av_opt_set_int(swrContext, "in_channel_count", avFrame->channels, 0);
-  av_opt_set_int(swrContext, "in_sample_rate", avFrame->sample_rate, 0);
-  av_opt_set_sample_fmt(swrContext, "in_sample_fmt", static_cast<AVSampleFormat>(avFrame->format),
-                        0);
+  av_opt_set_int(swrContext, "in_channel_count", audioEncoderConfig.channels, 0);
+  av_opt_set_int(swrContext, "in_sample_rate", audioEncoderConfig.sampleRate, 0);
+  av_opt_set_sample_fmt(swrContext, "in_sample_fmt", AUDIO_OUT_FORMAT, 0);
   av_opt_set_int(swrContext, "out_channel_count", codecContext->channels, 0);
   av_opt_set_int(swrContext, "out_sample_rate", codecContext->sample_rate, 0);
   av_opt_set_sample_fmt(swrContext, "out_sample_fmt", codecContext->sample_fmt, 0);
@@ -246,15 +299,58 @@ bool FFmpegAudioEncoder::initResampleContext(AVFrame* avFrame) {
   int ret = swr_init(swrContext);
   if (ret < 0) {
     msgs.emplace_back("Failed to initialize the resampling context");
-    if (swrContext) {
-      swr_free(&swrContext);
-    }
+    swr_free(&swrContext);
+    return false;
+  }
+
+  convertFrame = av_frame_alloc();
+  if (!convertFrame) {
+    msgs.emplace_back("Error allocating an audio frame");
     return false;
   }
+  return reserveConvertFrame(frameSamples);
+}
 
-  lastAudioFormat = avFrame->format;
-  lastAudioFrameConfig.sampleRate = avFrame->sample_rate;
-  lastAudioFrameConfig.channels = avFrame->channels;
+bool FFmpegAudioEncoder::reserveConvertFrame(int sampleCount) {
+  if (sampleCount <= convertFrame->nb_samples) {
+    return true;
+  }
+  av_frame_unref(convertFrame);
+  convertFrame->nb_samples = sampleCount;
+  convertFrame->format = codecContext->sample_fmt;
+  convertFrame->channel_layout = codecContext->channel_layout;
+  convertFrame->channels = codecContext->channels;
+  convertFrame->sample_rate = codecContext->sample_rate;
+  if (av_frame_get_buffer(convertFrame, 0) < 0) {
+    convertFrame->nb_samples = 0;
+    msgs.emplace_back("Error allocating an audio buffer");
+    return false;
+  }
+  return true;
+}
+
+bool FFmpegAudioEncoder::createFifos() {
+  auto bytesPerSample = av_get_bytes_per_sample(codecContext->sample_fmt);
+  auto planar = av_sample_fmt_is_planar(codecContext->sample_fmt) != 0;
+  auto planeCount = planar ? codecContext->channels : 1;
+  auto planeChannels = planar ? 1 : codecContext->channels;
+  if (bytesPerSample <= 0 || planeCount <= 0 || planeCount > AV_NUM_DATA_POINTERS) {
+    msgs.emplace_back("AudioEncoder: unsupported sample format.");
+    return false;
+  }
+  for (int plane = 0; plane < planeCount; plane++) {
+    fifos.push_back(std::make_unique<AudioFifo>(planeChannels, bytesPerSample, frameSamples * 2));
+  }
+  return true;
+}
+
+bool FFmpegAudioEncoder::writeToFifos(uint8_t* const* planes, int sampleCount) {
+  for (size_t plane = 0; plane < fifos.size(); plane++) {
+    if (!fifos[plane]->write(planes[plane], sampleCount)) {
+      msgs.emplace_back("AudioEncoder: growing the audio FIFO failed.");
+      return false;
+    }
+  }
   return true;
 }
 
@@ -265,9 +361,13 @@ bool FFmpegAudioEncoder::createFrame() {
     return false;
   }
 
-  frame->nb_samples = (codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) == 0
-                          ? codecContext->frame_size
-                          : AUDIO_ENCODE_DEFAULT_SAMPLES;
+  frameSamples = (codecContext->codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE) == 0
+                     ? codecContext->frame_size
+                     : AUDIO_ENCODE_DEFAULT_SAMPLES;
+  if (frameSamples <= 0) {
+    frameSamples = AUDIO_ENCODE_DEFAULT_SAMPLES;
+  }
+  frame->nb_samples = frameSamples;
   frame->format = codecContext->sample_fmt;
   frame->channel_layout = codecContext->channel_layout;
   frame->sample_rate = codecContext->sample_rate;
@@ -282,26 +382,6 @@ bool FFmpegAudioEncoder::createFrame() {
   return true;
 }
 
-bool FFmpegAudioEncoder::createSrcFrame() {
-  srcFrame = av_frame_alloc();
-  if (!srcFrame) {
-    msgs.emplace_back("Error allocating an audio frame");
-    return false;
-  }
-  srcFrame->nb_samples = DEFAULT_OUTPUT_SAMPLE_COUNT;
-  srcFrame->channel_layout = av_get_default_channel_layout(audioEncoderConfig.channels);
-  srcFrame->sample_rate = audioEncoderConfig.sampleRate;
-  srcFrame->channels = audioEncoderConfig.channels;
-  srcFrame->format = AUDIO_OUT_FORMAT;
-  int ret = av_frame_get_buffer(srcFrame, 0);
-  if (ret < 0) {
-    msgs.emplace_back(string_format("Error allocating an audio buffer, ret is %d", ret));
-    return false;
-  }
-
-  return true;
-}
-
 std::shared_ptr<MediaFormat> FFmpegAudioEncoder::getMediaFormat() {
   auto trackFormat = std::make_shared<MediaFormat>();
   trackFormat->setInteger(KEY_TRACK_TYPE, AUDIO_TRACK);
@@ -33,6 +33,7 @@ extern "C" {
 
 #include <memory>
 #include "audio/AudioUtils.h"
+#include "audio/process/AudioFifo.h"
 #include "ffmovie/movie.h"
 
 #define AUDIO_OUT_SAMPLES 1024
@@ -56,28 +57,59 @@ class FFmpegAudioEncoder : public FFAudioEncoder {
   std::shared_ptr<MediaFormat> getMediaFormat() override;
   void collectErrorMsgs(std::vector<std::string>* const toMsgs) override;
 
+  /**
+   * Sets the position in samples of the next sample sent, which the pts of the frames and the
+   * packets count from. Must be called before the first onSendData().
+   */
+  void setStartSample(int64_t sampleIndex) {
+    encodedSamplesCount = sampleIndex;
+  }
+
+  /**
+   * Returns the number of samples per channel the codec takes in each frame, available after
+   * initEncoder().
+   */
+  int frameSize() const {
+    return codecContext->frame_size;
+  }
+
+  /**
+   * Returns the number of priming samples the codec outputs before the first input sample.
+   */
+  int encoderDelay() const {
+    return codecContext->initial_padding;
+  }
+
  private:
   bool initCodecContext();
-  bool initResampleContext(AVFrame* avFrame);
+  bool initResampleContext();
   CodingResult sendFrame(AVFrame* audioFrame);
+  CodingResult sendPendingFrame();
   void initEncodeSampleFormat();
   void initEncodeSampleRate();
   void initEncodeChannelLayout();
   bool createFrame();
-  bool createSrcFrame();
+  bool createFifos();
+  bool reserveConvertFrame(int sampleCount);
+  bool writeToFifos(uint8_t* const* planes, int sampleCount);
 
   AudioExportConfig audioEncoderConfig;
   AVCodecID codecID = AVCodecID::AV_CODEC_ID_AAC;
   AVCodecContext* codecContext = nullptr;
   AVCodec* avCodec = nullptr;
+  // Only created if the codec takes another format, rate or channel count than the input.
   struct SwrContext* swrContext = nullptr;
-  PCMOutputConfig lastAudioFrameConfig;
-  int lastAudioFormat = AV_SAMPLE_FMT_NONE;
   AVPacket* packet = nullptr;
+  // The frame sent to the codec, which holds exactly frameSamples samples except for the last.
   AVFrame* frame = nullptr;
-  AVFrame* srcFrame = nullptr;
-  int encodedSamplesCount = 0;
-  bool needResample;
+  // The output of swrContext, grown when a larger input arrives.
+  AVFrame* convertFrame = nullptr;
+  int frameSamples = 0;
+  // One FIFO per plane of the codec sample format, holding the samples not yet sent.
+  std::vector<std::unique_ptr<AudioFifo>> fifos = {};
+  int64_t encodedSamplesCount = 0;
+  bool inputEnded = false;
+  bool flushSent = false;
   std::vector<std::string> msgs;
 };
 }  // namespace ffmovie
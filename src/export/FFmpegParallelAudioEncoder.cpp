@@ -0,0 +1,269 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegParallelAudioEncoder.h"
+#include <algorithm>
+#include <chrono>
+#include "utils/Executor.h"
+
+namespace ffmovie {
+// About 12 seconds at 44.1 kHz for AAC, long enough that the overlap costs about 1%.
+#define PARALLEL_AUDIO_SEGMENT_FRAMES 512
+// Frames encoded before a segment on top of the codec delay, so the MDCT overlap, the window
+// shape and the psychoacoustic state have settled when the first kept packet is produced.
+#define PARALLEL_AUDIO_WARM_UP_FRAMES 2
+// Frames encoded after a segment on top of the codec delay, so its last kept packets never see
+// the zero padding of the final flush.
+#define PARALLEL_AUDIO_LOOK_AHEAD_FRAMES 2
+
+AudioEncodeSegment::~AudioEncodeSegment() {
+  for (auto& packet : packets) {
+    av_packet_free(&packet);
+  }
+}
+
+/**
+ * Moves the packets the encoder has ready into the segment, dropping those outside of its keep
+ * range. Returns false if the encoder fails.
+ */
+static bool ReceivePackets(FFmpegAudioEncoder* encoder, AVRational timeBase, int sampleRate,
+                           AudioEncodeSegment* segment) {
+  while (true) {
+    void* packet = nullptr;
+    auto result = encoder->onEncodeData(&packet);
+    if (result == CodingResult::TryAgainLater || result == CodingResult::EndOfStream) {
+      return true;
+    }
+    if (result != CodingResult::CodingSuccess) {
+      segment->msgs.emplace_back("ParallelAudioEncoder: receiving a packet failed.");
+      return false;
+    }
+    auto avPacket = static_cast<AVPacket*>(packet);
+    auto pts = av_rescale_q(avPacket->pts, timeBase, {1, sampleRate});
+    if (pts >= segment->keepStart && pts < segment->keepEnd) {
+      auto keptPacket = av_packet_alloc();
+      if (keptPacket == nullptr) {
+        segment->msgs.emplace_back("ParallelAudioEncoder: alloc packet failed.");
+        return false;
+      }
+      av_packet_move_ref(keptPacket, avPacket);
+      segment->packets.push_back(keptPacket);
+    } else {
+      av_packet_unref(avPacket);
+    }
+  }
+}
+
+static bool EncodeSegment(const AudioExportConfig& config, AudioEncodeSegment* segment) {
+  FFmpegAudioEncoder encoder(config);
+  if (!encoder.initEncoder()) {
+    encoder.collectErrorMsgs(&segment->msgs);
+    return false;
+  }
+  auto format = encoder.getMediaFormat();
+  AVRational timeBase = {format->getInteger(KEY_TIME_BASE_NUM),
+                         format->getInteger(KEY_TIME_BASE_DEN)};
+  auto sampleRate = format->getInteger(KEY_AUDIO_SAMPLE_RATE);
+  encoder.setStartSample(segment->firstSample);
+  auto frameBytes = static_cast<int64_t>(config.channels) * AUDIO_SAMPLE_BYTE;
+  auto sampleCount = static_cast<int64_t>(segment->pcm.size()) / frameBytes;
+  for (int64_t offset = 0; offset < sampleCount; offset += encoder.frameSize()) {
+    auto count = std::min(static_cast<int64_t>(encoder.frameSize()), sampleCount - offset);
+    auto result = encoder.onSendData(segment->pcm.data() + offset * frameBytes,
+                                     count * frameBytes, static_cast<int>(count));
+    if (result != CodingResult::CodingSuccess ||
+        !ReceivePackets(&encoder, timeBase, sampleRate, segment)) {
+      encoder.collectErrorMsgs(&segment->msgs);
+      return false;
+    }
+  }
+  std::vector<uint8_t>().swap(segment->pcm);
+  if (encoder.onEndOfStream() != CodingResult::CodingSuccess ||
+      !ReceivePackets(&encoder, timeBase, sampleRate, segment)) {
+    encoder.collectErrorMsgs(&segment->msgs);
+    return false;
+  }
+  return true;
+}
+
+FFmpegParallelAudioEncoder::FFmpegParallelAudioEncoder(const AudioExportConfig& config)
+    : audioEncoderConfig(config) {
+}
+
+FFmpegParallelAudioEncoder::~FFmpegParallelAudioEncoder() {
+  // Segments still encoding are owned by their tasks as well and are freed when they finish.
+  segments.clear();
+  if (outputPacket) {
+    av_packet_free(&outputPacket);
+  }
+}
+
+bool FFmpegParallelAudioEncoder::initEncoder() {
+  formatEncoder = std::make_unique<FFmpegAudioEncoder>(audioEncoderConfig);
+  if (!formatEncoder->initEncoder()) {
+    formatEncoder->collectErrorMsgs(&msgs);
+    return false;
+  }
+  // Segments are cut and their packets kept in input samples, which only match the pts of the
+  // codec at the same rate, and the resampler of every segment would restart with its own delay.
+  auto codecSampleRate = formatEncoder->getMediaFormat()->getInteger(KEY_AUDIO_SAMPLE_RATE);
+  if (codecSampleRate != audioEncoderConfig.sampleRate) {
+    sequential = true;
+    return true;
+  }
+  frameSize = formatEncoder->frameSize();
+  if (frameSize <= 0) {
+    msgs.emplace_back("ParallelAudioEncoder: the codec has no fixed frame size.");
+    return false;
+  }
+  encoderDelay = std::max(formatEncoder->encoderDelay(), 0);
+  auto delayFrames = (encoderDelay + frameSize - 1) / frameSize;
+  segmentSamples = static_cast<int64_t>(PARALLEL_AUDIO_SEGMENT_FRAMES) * frameSize;
+  warmUpSamples = static_cast<int64_t>(delayFrames + PARALLEL_AUDIO_WARM_UP_FRAMES) * frameSize;
+  lookAheadSamples =
+      static_cast<int64_t>(delayFrames + PARALLEL_AUDIO_LOOK_AHEAD_FRAMES) * frameSize;
+  frameBytes = audioEncoderConfig.channels * AUDIO_SAMPLE_BYTE;
+  outputPacket = av_packet_alloc();
+  if (!outputPacket) {
+    msgs.emplace_back("ParallelAudioEncoder: alloc packet failed.");
+    return false;
+  }
+  return true;
+}
+
+CodingResult FFmpegParallelAudioEncoder::onSendData(uint8_t* data, int64_t length,
+                                                    int sampleCount) {
+  if (sequential) {
+    return formatEncoder->onSendData(data, length, sampleCount);
+  }
+  if (inputEnded || data == nullptr || sampleCount < 0) {
+    msgs.emplace_back("ParallelAudioEncoder: invalid data.");
+    return CodingResult::CodingError;
+  }
+  pendingPCM.insert(pendingPCM.end(), data, data + static_cast<size_t>(sampleCount) * frameBytes);
+  auto pendingEnd = pendingStart + static_cast<int64_t>(pendingPCM.size()) / frameBytes;
+  while (pendingEnd >= nextSegmentStart + segmentSamples + lookAheadSamples) {
+    submitSegment(nextSegmentStart + segmentSamples, false);
+  }
+  return CodingResult::CodingSuccess;
+}
+
+CodingResult FFmpegParallelAudioEncoder::onEndOfStream() {
+  if (sequential) {
+    return formatEncoder->onEndOfStream();
+  }
+  if (!inputEnded) {
+    inputEnded = true;
+    submitSegment(pendingStart + static_cast<int64_t>(pendingPCM.size()) / frameBytes, true);
+  }
+  return CodingResult::CodingSuccess;
+}
+
+void FFmpegParallelAudioEncoder::submitSegment(int64_t segmentEnd, bool isLast) {
+  auto segment = std::make_shared<AudioEncodeSegment>();
+  // Packets are kept on the pts grid of a single encoder, which lags the input by its delay.
+  segment->firstSample = std::max(nextSegmentStart - warmUpSamples, pendingStart);
+  segment->keepStart = nextSegmentStart == 0 ? INT64_MIN : nextSegmentStart - encoderDelay;
+  segment->keepEnd = isLast ? INT64_MAX : segmentEnd - encoderDelay;
+  auto pendingEnd = pendingStart + static_cast<int64_t>(pendingPCM.size()) / frameBytes;
+  auto copyEnd = isLast ? pendingEnd : segmentEnd + lookAheadSamples;
+  auto copyBegin = pendingPCM.begin() + (segment->firstSample - pendingStart) * frameBytes;
+  segment->pcm.assign(copyBegin, copyBegin + (copyEnd - segment->firstSample) * frameBytes);
+  waitForFreeWorker();
+  auto config = audioEncoderConfig;
+  segment->result = Executor::Shared()->submit(
+      [config, segment]() { return EncodeSegment(config, segment.get()); });
+  segments.push_back(segment);
+
+  nextSegmentStart = segmentEnd;
+  auto dropEnd = std::max(nextSegmentStart - warmUpSamples, pendingStart);
+  pendingPCM.erase(pendingPCM.begin(),
+                   pendingPCM.begin() + (dropEnd - pendingStart) * frameBytes);
+  pendingStart = dropEnd;
+}
+
+void FFmpegParallelAudioEncoder::waitForFreeWorker() {
+  // Bounds the PCM held by segments when the caller produces audio faster than it is encoded.
+  int runningCount = 0;
+  AudioEncodeSegment* oldestRunning = nullptr;
+  for (auto& segment : segments) {
+    if (segment->result.valid() &&
+        segment->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      runningCount++;
+      if (oldestRunning == nullptr) {
+        oldestRunning = segment.get();
+      }
+    }
+  }
+  // One thread of the shared executor is left to the short tasks of the video encoder, such as
+  // the per-frame pixel conversions, which would otherwise queue behind seconds of audio.
+  auto maxRunningCount = std::max(Executor::Shared()->threadCount() - 1, 1);
+  if (oldestRunning != nullptr && runningCount >= maxRunningCount) {
+    oldestRunning->result.wait();
+  }
+}
+
+CodingResult FFmpegParallelAudioEncoder::onEncodeData(void** packet) {
+  if (sequential) {
+    return formatEncoder->onEncodeData(packet);
+  }
+  if (outputPacket == nullptr) {
+    return CodingResult::CodingError;
+  }
+  av_packet_unref(outputPacket);
+  while (!segments.empty()) {
+    auto segment = segments.front();
+    if (segment->result.valid()) {
+      // Once the input ended the remaining segments are the tail of the export, so this blocks.
+      if (!inputEnded &&
+          segment->result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return CodingResult::TryAgainLater;
+      }
+      if (!segment->result.get()) {
+        msgs.insert(msgs.end(), segment->msgs.begin(), segment->msgs.end());
+        segments.pop_front();
+        return CodingResult::CodingError;
+      }
+    }
+    if (!segment->packets.empty()) {
+      auto segmentPacket = segment->packets.front();
+      segment->packets.pop_front();
+      av_packet_move_ref(outputPacket, segmentPacket);
+      av_packet_free(&segmentPacket);
+      *packet = outputPacket;
+      return CodingResult::CodingSuccess;
+    }
+    segments.pop_front();
+  }
+  return inputEnded ? CodingResult::EndOfStream : CodingResult::TryAgainLater;
+}
+
+std::shared_ptr<MediaFormat> FFmpegParallelAudioEncoder::getMediaFormat() {
+  return formatEncoder->getMediaFormat();
+}
+
+void FFmpegParallelAudioEncoder::collectErrorMsgs(std::vector<std::string>* const toMsgs) {
+  if (toMsgs == nullptr) {
+    return;
+  }
+  toMsgs->insert(toMsgs->end(), msgs.begin(), msgs.end());
+  if (sequential) {
+    formatEncoder->collectErrorMsgs(toMsgs);
+  }
+}
+}  // namespace ffmovie
@@ -0,0 +1,86 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <deque>
+#include <future>
+#include "FFmpegAudioEncoder.h"
+
+namespace ffmovie {
+/**
+ * A segment of the PCM stream encoded by its own FFmpegAudioEncoder on the shared executor.
+ */
+struct AudioEncodeSegment {
+  // The position in samples of the first sample in pcm, warm-up samples included.
+  int64_t firstSample = 0;
+  // Only the packets with pts in [keepStart, keepEnd), in samples, are output.
+  int64_t keepStart = INT64_MIN;
+  int64_t keepEnd = INT64_MAX;
+  std::vector<uint8_t> pcm = {};
+  std::deque<AVPacket*> packets = {};
+  std::vector<std::string> msgs = {};
+  std::future<bool> result = {};
+
+  ~AudioEncodeSegment();
+};
+
+/**
+ * FFmpegParallelAudioEncoder splits the PCM stream into segments and encodes them on many AAC
+ * encoders at once. Each encoder starts a few frames before its segment, so the priming samples
+ * and the MDCT overlap are rebuilt from the real signal, and runs a few frames past it. Only the
+ * packets of its own segment are kept, on the timeline of a single encoder, so the stitched
+ * stream decodes without seams and muxes like the output of FFmpegAudioEncoder.
+ */
+class FFmpegParallelAudioEncoder : public FFAudioEncoder {
+ public:
+  explicit FFmpegParallelAudioEncoder(const AudioExportConfig& config);
+  ~FFmpegParallelAudioEncoder() override;
+  bool initEncoder() override;
+  CodingResult onSendData(uint8_t* data, int64_t length, int sampleCount) override;
+  CodingResult onEncodeData(void** packet) override;
+  CodingResult onEndOfStream() override;
+  std::shared_ptr<MediaFormat> getMediaFormat() override;
+  void collectErrorMsgs(std::vector<std::string>* const toMsgs) override;
+
+ private:
+  AudioExportConfig audioEncoderConfig;
+  // Opened for the media format and the codec parameters, it only encodes if sequential is true.
+  std::unique_ptr<FFmpegAudioEncoder> formatEncoder = nullptr;
+  // Set when the codec does not take the sample rate of the input, formatEncoder then encodes the
+  // whole stream by itself.
+  bool sequential = false;
+  int frameSize = 0;
+  int encoderDelay = 0;
+  int64_t segmentSamples = 0;
+  int64_t warmUpSamples = 0;
+  int64_t lookAheadSamples = 0;
+  int frameBytes = 0;
+  // The samples not yet sent to a segment, pendingPCM starts at pendingStart.
+  std::vector<uint8_t> pendingPCM = {};
+  int64_t pendingStart = 0;
+  int64_t nextSegmentStart = 0;
+  std::deque<std::shared_ptr<AudioEncodeSegment>> segments = {};
+  AVPacket* outputPacket = nullptr;
+  bool inputEnded = false;
+  std::vector<std::string> msgs;
+
+  void submitSegment(int64_t segmentEnd, bool isLast);
+  void waitForFreeWorker();
+};
+}  // namespace ffmovie
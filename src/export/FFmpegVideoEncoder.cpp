@@ -17,16 +17,41 @@
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "FFmpegVideoEncoder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include "libyuv/convert.h"
+#include "utils/Executor.h"
 #include "utils/StringUtils.h"
 
 namespace ffmovie {
+#define VIDEO_FRAME_POOL_SIZE 4
+// Bands shorter than this cost more in scheduling than they save.
+#define MIN_CONVERT_BAND_ROWS 64
+#define MAX_H264_QUALITY 51
+// Each speed level raises the CRF or the QP by this much, or scales the bitrate by this factor.
+#define QUALITY_LEVEL_STEP 2
+#define BITRATE_LEVEL_SCALE 0.85
+#define MAX_SPEED_LEVEL 6
 
 std::unique_ptr<FFVideoEncoder> FFVideoEncoder::Make(const VideoExportConfig& config) {
   return std::unique_ptr<FFmpegVideoEncoder>(new FFmpegVideoEncoder(config));
 }
 
 FFmpegVideoEncoder::~FFmpegVideoEncoder() {
+  for (auto& pending : pendingFrames) {
+    for (auto& band : pending.bands) {
+      band.wait();
+    }
+    av_frame_free(&pending.frame);
+    av_frame_free(&pending.source);
+  }
+  for (auto& item : dequeuedFrames) {
+    av_frame_free(&item.second);
+  }
+  for (auto& frame : wrapperFrames) {
+    av_frame_free(&frame);
+  }
   if (codecContext) {
     avcodec_close(codecContext);
     avcodec_free_context(&codecContext);
@@ -61,48 +86,409 @@ bool FFmpegVideoEncoder::initEncoder() {
         string_format("FFmpegVideoEncoder: open codec failed, ret = %d, msg = %s", ret, errorbuf));
     return false;
   }
+  if (videoEncoderConfig.targetFrameRate > 0) {
+    speedController = std::make_unique<EncoderSpeedController>(videoEncoderConfig.targetFrameRate,
+                                                               getMaxSpeedLevel());
+  }
+  return true;
+}
+
+void FFmpegVideoEncoder::setStatsCallback(StatsCallback callback) {
+  statsCallback = std::move(callback);
+}
+
+static int64_t GetTimeUs() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static AVPixelFormat ToAVPixelFormat(VideoPixelFormat format) {
+  switch (format) {
+    case VideoPixelFormat::NV12:
+      return AV_PIX_FMT_NV12;
+    case VideoPixelFormat::RGBA:
+      return AV_PIX_FMT_RGBA;
+    case VideoPixelFormat::BGRA:
+      return AV_PIX_FMT_BGRA;
+    default:
+      return STREAM_PIX_FMT;
+  }
+}
+
+static VideoPixelFormat ToVideoPixelFormat(int format) {
+  switch (format) {
+    case AV_PIX_FMT_NV12:
+      return VideoPixelFormat::NV12;
+    case AV_PIX_FMT_RGBA:
+      return VideoPixelFormat::RGBA;
+    case AV_PIX_FMT_BGRA:
+      return VideoPixelFormat::BGRA;
+    default:
+      return VideoPixelFormat::I420;
+  }
+}
+
+static int GetPlaneCount(VideoPixelFormat format) {
+  switch (format) {
+    case VideoPixelFormat::I420:
+      return 3;
+    case VideoPixelFormat::NV12:
+      return 2;
+    default:
+      return 1;
+  }
+}
+
+static bool CheckPixels(const VideoFramePixels& pixels) {
+  if (pixels.width <= 0 || pixels.height <= 0) {
+    return false;
+  }
+  // The chroma planes of I420 and NV12 cover 2x2 pixel blocks, odd sizes have no whole layout.
+  if ((pixels.format == VideoPixelFormat::I420 || pixels.format == VideoPixelFormat::NV12) &&
+      (pixels.width % 2 != 0 || pixels.height % 2 != 0)) {
+    return false;
+  }
+  for (int plane = 0; plane < GetPlaneCount(pixels.format); plane++) {
+    if (pixels.planes[plane] == nullptr || pixels.rowBytes[plane] <= 0) {
+      return false;
+    }
+  }
   return true;
 }
 
+/**
+ * Converts the rows [top, top + rows) of the pixels into the I420 frame, top must be even.
+ */
+static void ConvertRows(const VideoFramePixels& pixels, AVFrame* frame, int top, int rows) {
+  auto src = pixels.planes;
+  auto srcStride = pixels.rowBytes;
+  auto dstY = frame->data[0] + top * frame->linesize[0];
+  auto dstU = frame->data[1] + top / 2 * frame->linesize[1];
+  auto dstV = frame->data[2] + top / 2 * frame->linesize[2];
+  auto dstStride = frame->linesize;
+  switch (pixels.format) {
+    case VideoPixelFormat::I420:
+      libyuv::I420Copy(src[0] + top * srcStride[0], srcStride[0],
+                       src[1] + top / 2 * srcStride[1], srcStride[1],
+                       src[2] + top / 2 * srcStride[2], srcStride[2], dstY, dstStride[0], dstU,
+                       dstStride[1], dstV, dstStride[2], pixels.width, rows);
+      break;
+    case VideoPixelFormat::NV12:
+      libyuv::NV12ToI420(src[0] + top * srcStride[0], srcStride[0],
+                         src[1] + top / 2 * srcStride[1], srcStride[1], dstY, dstStride[0], dstU,
+                         dstStride[1], dstV, dstStride[2], pixels.width, rows);
+      break;
+    case VideoPixelFormat::RGBA:
+      // RGBAToI420, 内存顺序是RGBA,所以用方法得反过来ARGB
+      libyuv::ABGRToI420(src[0] + top * srcStride[0], srcStride[0], dstY, dstStride[0], dstU,
+                         dstStride[1], dstV, dstStride[2], pixels.width, rows);
+      break;
+    case VideoPixelFormat::BGRA:
+      // libyuv 的 ARGB 是小端序，内存顺序正好是BGRA
+      libyuv::ARGBToI420(src[0] + top * srcStride[0], srcStride[0], dstY, dstStride[0], dstU,
+                         dstStride[1], dstV, dstStride[2], pixels.width, rows);
+      break;
+  }
+}
+
+static void ReleasePixelsOwner(void* opaque, uint8_t*) {
+  delete static_cast<std::shared_ptr<void>*>(opaque);
+}
+
 CodingResult FFmpegVideoEncoder::onSendData(std::unique_ptr<ByteData> rgbaData, int width,
                                             int height, int rowBytes, int64_t pts) {
-  AVFrame* encodeFrame = av_frame_alloc();
-  encodeFrame->width = width;
-  encodeFrame->height = height;
-  encodeFrame->format = AV_PIX_FMT_YUV420P;
-  int ret = av_frame_get_buffer(encodeFrame, 0);
-  if (ret < 0) {
+  if (rgbaData == nullptr) {
+    msgs.emplace_back("FFmpegVideoEncoder: invalid frame.");
     return CodingResult::CodingError;
   }
-  // convert
-  // RGBAToI420, 内存顺序是RGBA,所以用方法得反过来ARGB
-  libyuv::ABGRToI420(rgbaData->data(), rowBytes, encodeFrame->data[0], encodeFrame->linesize[0],
-                     encodeFrame->data[1], encodeFrame->linesize[1], encodeFrame->data[2],
-                     encodeFrame->linesize[2], width, height);
-  ret = av_frame_make_writable(encodeFrame);
-  if (ret < 0) {
+  VideoFramePixels pixels = {};
+  pixels.format = VideoPixelFormat::RGBA;
+  pixels.width = width;
+  pixels.height = height;
+  pixels.planes[0] = rgbaData->data();
+  pixels.rowBytes[0] = rowBytes;
+  pixels.owner = std::shared_ptr<ByteData>(std::move(rgbaData));
+  return onSendData(pixels, pts);
+}
+
+CodingResult FFmpegVideoEncoder::onSendData(const VideoFramePixels& pixels, int64_t pts) {
+  if (inputEnded || codecContext == nullptr || !CheckPixels(pixels)) {
+    msgs.emplace_back("FFmpegVideoEncoder: invalid frame.");
+    return CodingResult::CodingError;
+  }
+  // The codec does not scale, and a frame of another size would also rebuild the I420 frame pool.
+  if (pixels.width != codecContext->width || pixels.height != codecContext->height) {
+    msgs.emplace_back(string_format("FFmpegVideoEncoder: the frame is %dx%d, the encoder %dx%d.",
+                                    pixels.width, pixels.height, codecContext->width,
+                                    codecContext->height));
+    return CodingResult::CodingError;
+  }
+  PendingVideoFrame pending = {};
+  if (pixels.format == VideoPixelFormat::I420 && pixels.owner != nullptr) {
+    // Already in the layout of the codec, the planes are sent as they are.
+    pending.frame = wrapPlanes(pixels);
+    pending.wrapped = true;
+  } else {
+    pending.frame = getFramePool(VideoPixelFormat::I420, pixels.width, pixels.height)->obtain();
+  }
+  if (pending.frame == nullptr) {
+    msgs.emplace_back("FFmpegVideoEncoder: allocating a frame failed.");
     return CodingResult::CodingError;
   }
-  encodeFrame->pts = pts;
-  return sendFrame(encodeFrame);
+  pending.frame->pts = pts;
+  if (!pending.wrapped) {
+    auto planes = pixels;
+    planes.owner = nullptr;
+    auto frame = pending.frame;
+    startConversion(&pending, pixels.height, [planes, frame](int top, int rows) {
+      ConvertRows(planes, frame, top, rows);
+    });
+    pending.owner = pixels.owner;
+    if (pending.owner == nullptr) {
+      // Nothing keeps the planes alive once this returns.
+      for (auto& band : pending.bands) {
+        band.wait();
+      }
+    }
+  }
+  return queueFrame(std::move(pending));
+}
+
+AVFrame* FFmpegVideoEncoder::wrapPlanes(const VideoFramePixels& pixels) {
+  AVFrame* frame = nullptr;
+  if (!wrapperFrames.empty()) {
+    frame = wrapperFrames.back();
+    wrapperFrames.pop_back();
+  } else {
+    frame = av_frame_alloc();
+    if (frame == nullptr) {
+      return nullptr;
+    }
+  }
+  // The buffer holds a reference to the owner, so the planes outlive any reference the codec
+  // takes to the frame.
+  auto owner = new std::shared_ptr<void>(pixels.owner);
+  frame->buf[0] = av_buffer_create(const_cast<uint8_t*>(pixels.planes[0]),
+                                   pixels.rowBytes[0] * pixels.height, ReleasePixelsOwner, owner,
+                                   AV_BUFFER_FLAG_READONLY);
+  if (frame->buf[0] == nullptr) {
+    delete owner;
+    wrapperFrames.push_back(frame);
+    return nullptr;
+  }
+  frame->format = STREAM_PIX_FMT;
+  frame->width = pixels.width;
+  frame->height = pixels.height;
+  for (int plane = 0; plane < 3; plane++) {
+    frame->data[plane] = const_cast<uint8_t*>(pixels.planes[plane]);
+    frame->linesize[plane] = pixels.rowBytes[plane];
+  }
+  return frame;
+}
+
+VideoPixelFormat FFmpegVideoEncoder::preferredInputFormat() {
+  return VideoPixelFormat::I420;
+}
+
+bool FFmpegVideoEncoder::dequeueInputBuffer(VideoPixelFormat format, VideoInputBuffer* buffer) {
+  if (buffer == nullptr || codecContext == nullptr) {
+    return false;
+  }
+  auto frame = getFramePool(format, codecContext->width, codecContext->height)->obtain();
+  if (frame == nullptr) {
+    msgs.emplace_back("FFmpegVideoEncoder: allocating an input buffer failed.");
+    return false;
+  }
+  *buffer = {};
+  buffer->index = nextInputBufferIndex++;
+  buffer->format = format;
+  buffer->width = frame->width;
+  buffer->height = frame->height;
+  for (int plane = 0; plane < 3 && frame->data[plane] != nullptr; plane++) {
+    buffer->planes[plane] = frame->data[plane];
+    buffer->rowBytes[plane] = frame->linesize[plane];
+    buffer->planeCount++;
+  }
+  dequeuedFrames[buffer->index] = frame;
+  return true;
+}
+
+CodingResult FFmpegVideoEncoder::queueInputBuffer(const VideoInputBuffer& buffer, int64_t pts) {
+  auto result = dequeuedFrames.find(buffer.index);
+  if (result == dequeuedFrames.end()) {
+    msgs.emplace_back("FFmpegVideoEncoder: queued an unknown input buffer.");
+    return CodingResult::CodingError;
+  }
+  auto source = result->second;
+  dequeuedFrames.erase(result);
+  if (inputEnded) {
+    recycleFrame(source);
+    msgs.emplace_back("FFmpegVideoEncoder: input buffer queued after the end of stream.");
+    return CodingResult::CodingError;
+  }
+  PendingVideoFrame pending = {};
+  if (source->format == STREAM_PIX_FMT) {
+    // Rendered in the layout of the codec, the buffer is sent as is.
+    pending.frame = source;
+  } else {
+    pending.frame = getFramePool(VideoPixelFormat::I420, source->width, source->height)->obtain();
+    if (pending.frame == nullptr) {
+      recycleFrame(source);
+      msgs.emplace_back("FFmpegVideoEncoder: allocating a frame failed.");
+      return CodingResult::CodingError;
+    }
+    pending.source = source;
+    VideoFramePixels planes = {};
+    planes.format = ToVideoPixelFormat(source->format);
+    planes.width = source->width;
+    planes.height = source->height;
+    for (int plane = 0; plane < 3; plane++) {
+      planes.planes[plane] = source->data[plane];
+      planes.rowBytes[plane] = source->linesize[plane];
+    }
+    auto frame = pending.frame;
+    startConversion(&pending, source->height, [planes, frame](int top, int rows) {
+      ConvertRows(planes, frame, top, rows);
+    });
+  }
+  pending.frame->pts = pts;
+  return queueFrame(std::move(pending));
+}
+
+CodingResult FFmpegVideoEncoder::queueFrame(PendingVideoFrame pending) {
+  pendingFrames.push_back(std::move(pending));
+  // The codec may still hold a packet, the frames left are sent by onEncodeData() then.
+  auto result = sendPendingInput();
+  return result == CodingResult::TryAgainLater ? CodingResult::CodingSuccess : result;
+}
+
+AVFramePool* FFmpegVideoEncoder::getFramePool(VideoPixelFormat format, int width, int height) {
+  auto& pool = framePools[static_cast<int>(format)];
+  if (pool == nullptr || pool->width() != width || pool->height() != height) {
+    pool = std::make_unique<AVFramePool>(width, height, ToAVPixelFormat(format),
+                                         VIDEO_FRAME_POOL_SIZE);
+  }
+  return pool.get();
+}
+
+void FFmpegVideoEncoder::recycleFrame(AVFrame* frame) {
+  for (auto& pool : framePools) {
+    if (pool != nullptr && pool->pixelFormat() == frame->format) {
+      pool->recycle(frame);
+      return;
+    }
+  }
+  av_frame_free(&frame);
 }
 
 CodingResult FFmpegVideoEncoder::onEndOfStream() {
-  return sendFrame(nullptr);
+  inputEnded = true;
+  auto result = sendPendingInput();
+  return result == CodingResult::TryAgainLater ? CodingResult::CodingSuccess : result;
 }
 
 CodingResult FFmpegVideoEncoder::onEncodeData(void** encodedPacket) {
-  auto result = avcodec_receive_packet(codecContext, packet);
-  if (result == 0) {
-    *encodedPacket = packet;
-    return CodingResult::CodingSuccess;
-  } else if (result == AVERROR(EAGAIN)) {
-    return CodingResult::TryAgainLater;
-  } else if (result == AVERROR_EOF) {
-    return CodingResult::EndOfStream;
+  while (true) {
+    auto startTime = GetTimeUs();
+    auto result = avcodec_receive_packet(codecContext, packet);
+    codecTime += GetTimeUs() - startTime;
+    if (result == 0) {
+      receivedPacketCount++;
+      *encodedPacket = packet;
+      return CodingResult::CodingSuccess;
+    } else if (result == AVERROR_EOF) {
+      return CodingResult::EndOfStream;
+    } else if (result != AVERROR(EAGAIN)) {
+      return CodingResult::CodingError;
+    }
+    // The codec wants more input, sends what was queued while its packets were pending.
+    auto pendingCount = pendingFrames.size();
+    auto flushed = flushSent;
+    if (sendPendingInput() == CodingResult::CodingError) {
+      return CodingResult::CodingError;
+    }
+    if (pendingFrames.size() == pendingCount && flushSent == flushed) {
+      return CodingResult::TryAgainLater;
+    }
+  }
+}
+
+void FFmpegVideoEncoder::startConversion(PendingVideoFrame* pending, int height,
+                                         std::function<void(int top, int rows)> convertRows) {
+  auto executor = Executor::Shared();
+  auto bandCount = std::max(1, std::min(executor->threadCount(), height / MIN_CONVERT_BAND_ROWS));
+  // Bands start on even rows, so each one owns whole rows of the subsampled chroma planes.
+  auto bandRows = ((height + bandCount - 1) / bandCount + 1) & ~1;
+  for (int top = 0; top < height; top += bandRows) {
+    auto rows = std::min(bandRows, height - top);
+    pending->bands.push_back(
+        executor->submit([convertRows, top, rows]() { convertRows(top, rows); }));
+  }
+}
+
+CodingResult FFmpegVideoEncoder::sendPendingFrame() {
+  auto& pending = pendingFrames.front();
+  for (auto& band : pending.bands) {
+    band.wait();
+  }
+  pending.bands.clear();
+  pending.owner = nullptr;
+  if (pending.source != nullptr) {
+    recycleFrame(pending.source);
+    pending.source = nullptr;
+  }
+  auto result = sendFrame(pending.frame);
+  if (result == CodingResult::TryAgainLater) {
+    return result;
+  }
+  // The codec holds its own reference if it still needs the pixels, the pool checks for it.
+  if (pending.wrapped) {
+    av_frame_unref(pending.frame);
+    wrapperFrames.push_back(pending.frame);
   } else {
-    return CodingResult::CodingError;
+    recycleFrame(pending.frame);
+  }
+  pendingFrames.pop_front();
+  sentFrameCount++;
+  updateSpeed();
+  return result;
+}
+
+void FFmpegVideoEncoder::updateSpeed() {
+  auto frameTime = codecTime;
+  codecTime = 0;
+  if (speedController == nullptr) {
+    return;
+  }
+  auto queueDepth = static_cast<int>(sentFrameCount - receivedPacketCount) +
+                    static_cast<int>(pendingFrames.size());
+  if (speedController->update(frameTime, queueDepth, receivedPacketCount > 0) !=
+      SpeedDecision::Hold) {
+    applySpeedLevel(speedController->level());
+  }
+  if (speedController->hasDecision() && statsCallback != nullptr) {
+    auto stats = speedController->stats();
+    stats.rateControlValue = getRateControlValue(stats.speedLevel);
+    statsCallback(stats);
+  }
+}
+
+CodingResult FFmpegVideoEncoder::sendPendingInput() {
+  while (pendingFrames.size() > (inputEnded ? 0 : 1)) {
+    auto result = sendPendingFrame();
+    if (result != CodingResult::CodingSuccess) {
+      return result;
+    }
   }
+  if (inputEnded && !flushSent) {
+    auto result = sendFrame(nullptr);
+    if (result != CodingResult::CodingSuccess) {
+      return result;
+    }
+    flushSent = true;
+  }
+  return CodingResult::CodingSuccess;
 }
 
 FFmpegVideoEncoder::FFmpegVideoEncoder(const VideoExportConfig& config)
@@ -127,23 +513,139 @@ bool FFmpegVideoEncoder::initCodecContext() {
   codecContext->width = videoEncoderConfig.width;
   codecContext->height = videoEncoderConfig.height;
   codecContext->bit_rate = videoEncoderConfig.videoBitrate;
-  codecContext->thread_count = VIDEO_ENCODE_THREAD_COUNT;
+  codecContext->thread_count = std::max(videoEncoderConfig.threadCount, 0);
   codecContext->pix_fmt = STREAM_PIX_FMT;
   codecContext->codec_id = codecId;
   codecContext->time_base = {1, static_cast<int>(videoEncoderConfig.frameRate)};
   codecContext->framerate = {static_cast<int>(videoEncoderConfig.frameRate), 1};
-  codecContext->gop_size = VIDEO_GOP_SIZE;
+  codecContext->gop_size = std::max(videoEncoderConfig.gopSize, 1);
   codecContext->colorspace = AVCOL_SPC_BT470BG;
-  codecContext->max_b_frames = 0;
+  // The baseline profile has no B-frames.
+  codecContext->max_b_frames = videoEncoderConfig.profile == VideoProfile::BASELINE
+                                   ? 0
+                                   : std::max(videoEncoderConfig.maxBFrames, 0);
   codecContext->profile = videoEncoderConfig.profile == VideoProfile::BASELINE
                               ? FF_PROFILE_H264_BASELINE
                               : FF_PROFILE_H264_HIGH;
+  if (videoEncoderConfig.maxBitrate > 0) {
+    codecContext->rc_max_rate = videoEncoderConfig.maxBitrate;
+  }
+  if (videoEncoderConfig.bufferSize > 0) {
+    codecContext->rc_buffer_size = videoEncoderConfig.bufferSize;
+  }
+  if (videoEncoderConfig.rateControl != VideoRateControl::Bitrate) {
+    codecContext->bit_rate = 0;
+  }
+  // The same codec id may be served by different encoders depending on how FFmpeg was built.
+  encoderName = avCodec->name;
+  if (encoderName == "libx264") {
+    setX264Options();
+  } else if (encoderName == "libopenh264") {
+    setOpenH264Options();
+  } else {
+    setQScaleOptions();
+  }
   return true;
 }
 
+/**
+ * Maps an H.264 quality in 0~51 to the 1~31 quantizer scale of the native encoders.
+ */
+static int ToQScale(int quality) {
+  return std::min(std::max(quality * 31 / MAX_H264_QUALITY, 1), 31);
+}
+
+static const char* GetPresetName(VideoPreset preset) {
+  static const char* names[] = {"ultrafast", "superfast", "veryfast", "faster",  "fast",
+                                "medium",    "slow",      "slower",   "veryslow"};
+  return names[static_cast<int>(preset)];
+}
+
+static const char* GetTuneName(VideoTune tune) {
+  static const char* names[] = {nullptr,      "film",       "animation",  "grain",
+                                "stillimage", "fastdecode", "zerolatency"};
+  return names[static_cast<int>(tune)];
+}
+
+void FFmpegVideoEncoder::setX264Options() {
+  auto options = codecContext->priv_data;
+  av_opt_set(options, "preset", GetPresetName(videoEncoderConfig.preset), 0);
+  auto tune = GetTuneName(videoEncoderConfig.tune);
+  if (tune != nullptr) {
+    av_opt_set(options, "tune", tune, 0);
+  }
+  if (videoEncoderConfig.rateControl == VideoRateControl::CRF) {
+    av_opt_set_double(options, "crf", videoEncoderConfig.quality, 0);
+  } else if (videoEncoderConfig.rateControl == VideoRateControl::CQP) {
+    av_opt_set_int(options, "qp", videoEncoderConfig.quality, 0);
+  }
+  if (videoEncoderConfig.lookaheadFrames >= 0) {
+    av_opt_set_int(options, "rc-lookahead", videoEncoderConfig.lookaheadFrames, 0);
+  }
+}
+
+void FFmpegVideoEncoder::setOpenH264Options() {
+  // OpenH264 has neither presets nor lookahead, a constant quality is its quality mode bounded to
+  // a single quantizer.
+  if (videoEncoderConfig.rateControl != VideoRateControl::Bitrate) {
+    av_opt_set(codecContext->priv_data, "rc_mode", "quality", 0);
+    codecContext->qmin = videoEncoderConfig.quality;
+    codecContext->qmax = videoEncoderConfig.quality;
+  }
+}
+
+void FFmpegVideoEncoder::setQScaleOptions() {
+  // The native encoders such as mpeg4 only know a fixed quantizer, in their own 1~31 scale.
+  if (videoEncoderConfig.rateControl != VideoRateControl::Bitrate) {
+    codecContext->flags |= AV_CODEC_FLAG_QSCALE;
+    codecContext->global_quality = FF_QP2LAMBDA * ToQScale(videoEncoderConfig.quality);
+    // These encoders take the quantizer of each frame from the frame itself.
+    frameQuality = codecContext->global_quality;
+  }
+}
+
+int FFmpegVideoEncoder::getMaxSpeedLevel() const {
+  // Presets can not change once the parameter sets are out, only the rate control can, and only
+  // libx264 and the fixed quantizer of the native encoders take a new one mid-stream. The libx264
+  // wrapper reconfigures the bitrate, crf, qp, VBV and aspect ratio only, not subme, me or trellis,
+  // so the levels save the entropy coding of fewer bits and little of the analysis.
+  if (encoderName == "libx264" || frameQuality > 0) {
+    return MAX_SPEED_LEVEL;
+  }
+  return 0;
+}
+
+int64_t FFmpegVideoEncoder::getRateControlValue(int level) const {
+  if (videoEncoderConfig.rateControl == VideoRateControl::Bitrate) {
+    return static_cast<int64_t>(videoEncoderConfig.videoBitrate *
+                                std::pow(BITRATE_LEVEL_SCALE, level));
+  }
+  return std::min(videoEncoderConfig.quality + level * QUALITY_LEVEL_STEP, MAX_H264_QUALITY);
+}
+
+void FFmpegVideoEncoder::applySpeedLevel(int level) {
+  auto value = getRateControlValue(level);
+  if (encoderName == "libx264") {
+    // libx264 compares these with its parameters before each frame and reconfigures itself.
+    if (videoEncoderConfig.rateControl == VideoRateControl::CRF) {
+      av_opt_set_double(codecContext->priv_data, "crf", static_cast<double>(value), 0);
+    } else if (videoEncoderConfig.rateControl == VideoRateControl::CQP) {
+      av_opt_set_int(codecContext->priv_data, "qp", value, 0);
+    } else {
+      codecContext->bit_rate = value;
+    }
+  } else if (frameQuality > 0) {
+    frameQuality = FF_QP2LAMBDA * ToQScale(static_cast<int>(value));
+  }
+}
+
 CodingResult FFmpegVideoEncoder::sendFrame(AVFrame* videoFrame) {
+  if (videoFrame != nullptr && frameQuality > 0) {
+    videoFrame->quality = frameQuality;
+  }
+  auto startTime = GetTimeUs();
   int ret = avcodec_send_frame(codecContext, videoFrame);
-  av_frame_free(&videoFrame);
+  codecTime += GetTimeUs() - startTime;
   if (ret >= 0) {
     return CodingResult::CodingSuccess;
   } else if (ret == AVERROR(EAGAIN)) {
@@ -32,18 +32,35 @@ extern "C" {
 }
 #endif
 
+#include <deque>
+#include <functional>
+#include <future>
 #include <memory>
+#include <unordered_map>
+#include "export/AVFramePool.h"
+#include "export/EncoderSpeedController.h"
 #include "ffmovie/movie.h"
 
 #define VIDEO_BIT_RATE_BPS 8000000
 #define VIDEO_FRAME_RATE 30
 #define VIDEO_WIDTH 1280
 #define VIDEO_HEIGHT 720
-#define VIDEO_ENCODE_THREAD_COUNT 5
 #define STREAM_PIX_FMT AV_PIX_FMT_YUV420P
-#define VIDEO_GOP_SIZE 120
 
 namespace ffmovie {
+/**
+ * A frame whose pixels are being converted into frame over row bands on the shared executor.
+ */
+struct PendingVideoFrame {
+  AVFrame* frame = nullptr;
+  // True if frame wraps the planes passed to onSendData() instead of owning pooled buffers.
+  bool wrapped = false;
+  // The owner of the pixels or the input buffer the frame is converted from, kept alive until the
+  // conversion finished.
+  std::shared_ptr<void> owner = nullptr;
+  AVFrame* source = nullptr;
+  std::vector<std::future<void>> bands = {};
+};
 
 class FFmpegVideoEncoder : public FFVideoEncoder {
  public:
@@ -52,21 +69,63 @@ class FFmpegVideoEncoder : public FFVideoEncoder {
   bool initEncoder() override;
   CodingResult onSendData(std::unique_ptr<ByteData> rgbaData, int width, int height, int rowBytes,
                           int64_t pts) override;
+  CodingResult onSendData(const VideoFramePixels& pixels, int64_t pts) override;
   CodingResult onEndOfStream() override;
   CodingResult onEncodeData(void** packet) override;
   std::shared_ptr<MediaFormat> getMediaFormat() override;
   void collectErrorMsgs(std::vector<std::string>* const toMsgs) override;
+  VideoPixelFormat preferredInputFormat() override;
+  bool dequeueInputBuffer(VideoPixelFormat format, VideoInputBuffer* buffer) override;
+  CodingResult queueInputBuffer(const VideoInputBuffer& buffer, int64_t pts) override;
+  void setStatsCallback(StatsCallback callback) override;
 
  private:
   bool initCodec();
   bool initCodecContext();
+  AVFramePool* getFramePool(VideoPixelFormat format, int width, int height);
+  AVFrame* wrapPlanes(const VideoFramePixels& pixels);
+  void recycleFrame(AVFrame* frame);
+  void startConversion(PendingVideoFrame* pending, int height,
+                       std::function<void(int top, int rows)> convertRows);
+  CodingResult queueFrame(PendingVideoFrame pending);
+  CodingResult sendPendingFrame();
+  CodingResult sendPendingInput();
 
   CodingResult sendFrame(AVFrame* videoFrame);
+  void setX264Options();
+  void setOpenH264Options();
+  void setQScaleOptions();
+  int getMaxSpeedLevel() const;
+  int64_t getRateControlValue(int level) const;
+  void applySpeedLevel(int level);
+  void updateSpeed();
   VideoExportConfig videoEncoderConfig;
   AVCodecID codecId = AVCodecID::AV_CODEC_ID_H264;
   AVCodecContext* codecContext = nullptr;
   AVCodec* avCodec = nullptr;
   AVPacket* packet = nullptr;
+  std::string encoderName = {};
+  // The quality of the frames sent to the encoders with a fixed quantizer, 0 for the others.
+  int frameQuality = 0;
+  // Created if the config has a target frame rate.
+  std::unique_ptr<EncoderSpeedController> speedController = nullptr;
+  StatsCallback statsCallback = nullptr;
+  // The time spent in the codec since the last frame was sent, in microseconds.
+  int64_t codecTime = 0;
+  int64_t sentFrameCount = 0;
+  int64_t receivedPacketCount = 0;
+  // One pool per VideoPixelFormat, the I420 one holds the frames sent to the codec.
+  std::unique_ptr<AVFramePool> framePools[4] = {};
+  // Empty frames reused to wrap the I420 planes passed to onSendData().
+  std::vector<AVFrame*> wrapperFrames = {};
+  // The input buffers handed out by dequeueInputBuffer(), by index.
+  std::unordered_map<int, AVFrame*> dequeuedFrames = {};
+  int nextInputBufferIndex = 0;
+  // The newest frame is only sent by the next onSendData() or by onEndOfStream(), so its
+  // conversion overlaps with the encoding of the previous frame.
+  std::deque<PendingVideoFrame> pendingFrames = {};
+  bool inputEnded = false;
+  bool flushSent = false;
   std::vector<std::string> msgs;
 
   friend class FFmpegVideoExport;
@@ -0,0 +1,82 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "Executor.h"
+#include <algorithm>
+
+namespace ffmovie {
+#define DEFAULT_EXECUTOR_THREAD_COUNT 4
+
+Executor* Executor::Shared() {
+  static auto executor = [] {
+    auto threadCount = static_cast<int>(std::thread::hardware_concurrency());
+    if (threadCount <= 0) {
+      threadCount = DEFAULT_EXECUTOR_THREAD_COUNT;
+    }
+    return new Executor(threadCount);
+  }();
+  return executor;
+}
+
+Executor::Executor(int threadCount) {
+  threadCount = std::max(threadCount, 1);
+  for (int i = 0; i < threadCount; i++) {
+    threads.emplace_back(&Executor::workLoop, this);
+  }
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    exiting = true;
+  }
+  condition.notify_all();
+  for (auto& thread : threads) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+void Executor::run(std::function<void()> task) {
+  if (task == nullptr) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    tasks.push_back(std::move(task));
+  }
+  condition.notify_one();
+}
+
+void Executor::workLoop() {
+  while (true) {
+    std::function<void()> task = nullptr;
+    {
+      std::unique_lock<std::mutex> autoLock(locker);
+      condition.wait(autoLock, [this] { return exiting || !tasks.empty(); });
+      if (tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+  }
+}
+}  // namespace ffmovie
@@ -0,0 +1,80 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ffmovie {
+
+/**
+ * A fixed-size pool of worker threads that runs tasks in FIFO order.
+ */
+class Executor {
+ public:
+  /**
+   * Returns the executor shared by the whole library, which has one thread per CPU core.
+   */
+  static Executor* Shared();
+
+  explicit Executor(int threadCount);
+
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+
+  Executor& operator=(const Executor&) = delete;
+
+  int threadCount() const {
+    return static_cast<int>(threads.size());
+  }
+
+  /**
+   * Queues the task to run on one of the worker threads.
+   */
+  void run(std::function<void()> task);
+
+  /**
+   * Queues the task and returns a future holding its result.
+   */
+  template <typename Task>
+  auto submit(Task task) -> std::future<decltype(task())> {
+    using Result = decltype(task());
+    auto packagedTask = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+    auto future = packagedTask->get_future();
+    run([packagedTask]() { (*packagedTask)(); });
+    return future;
+  }
+
+ private:
+  std::mutex locker = {};
+  std::condition_variable condition = {};
+  std::deque<std::function<void()>> tasks = {};
+  std::vector<std::thread> threads = {};
+  bool exiting = false;
+
+  void workLoop();
+};
+}  // namespace ffmovie
@@ -184,4 +184,16 @@ AVPacket* CreateAVPacket(EncodePacket* encodePacket) {
   memcpy(packet->data, encodePacket->data->data(), encodePacket->data->length());
   return packet;
 }
+
+static int CheckCancelled(void* opaque) {
+  auto cancelToken = static_cast<CancelToken*>(opaque);
+  return cancelToken->isCancelled() ? 1 : 0;
+}
+
+AVIOInterruptCB MakeInterruptCallback(CancelToken* cancelToken) {
+  if (cancelToken == nullptr) {
+    return {nullptr, nullptr};
+  }
+  return {CheckCancelled, cancelToken};
+}
 }  // namespace ffmovie
\ No newline at end of file
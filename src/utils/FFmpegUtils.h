@@ -43,4 +43,9 @@ AVCodecID MineStringToAudioAVCodecID(const std::string& mime);
 
 AVPacket* CreateAVPacket(EncodePacket* packet);
 
+/**
+ * Returns an interrupt callback that aborts the blocking I/O of FFmpeg once the token is cancelled.
+ */
+AVIOInterruptCB MakeInterruptCallback(CancelToken* cancelToken);
+
 }  // namespace ffmovie
\ No newline at end of file
@@ -0,0 +1,60 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FileInfo.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace ffmovie {
+#ifdef _WIN32
+
+bool GetFileInfo(const std::string& path, FileInfo* info) {
+  WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+  if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) {
+    return false;
+  }
+  info->size = (static_cast<int64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+  // In 100-nanosecond intervals.
+  info->modifiedTime = (static_cast<int64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+                       attributes.ftLastWriteTime.dwLowDateTime;
+  return true;
+}
+
+#else
+
+bool GetFileInfo(const std::string& path, FileInfo* info) {
+  struct stat fileStat = {};
+  if (stat(path.c_str(), &fileStat) != 0) {
+    return false;
+  }
+  info->size = static_cast<int64_t>(fileStat.st_size);
+  // In nanoseconds, two writes in the same second still tell apart.
+#ifdef __APPLE__
+  auto& time = fileStat.st_mtimespec;
+#else
+  auto& time = fileStat.st_mtim;
+#endif
+  info->modifiedTime = static_cast<int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+  return true;
+}
+
+#endif
+}  // namespace ffmovie
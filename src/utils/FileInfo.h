@@ -0,0 +1,39 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace ffmovie {
+struct FileInfo {
+  int64_t size = 0;
+  /**
+   * The last modification time in the platform's own unit, only good for comparing with another
+   * FileInfo of the same file.
+   */
+  int64_t modifiedTime = 0;
+};
+
+/**
+ * Reads the size and the last modification time of the file at the path, returns false if it does
+ * not exist. A cached result derived from the file is stale once either of them changes.
+ */
+bool GetFileInfo(const std::string& path, FileInfo* info);
+}  // namespace ffmovie
@@ -0,0 +1,163 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace ffmovie {
+#ifdef _WIN32
+
+std::unique_ptr<MappedFile> MappedFile::Make(const std::string& path) {
+  auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+  LARGE_INTEGER fileSize = {};
+  if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0) {
+    CloseHandle(file);
+    return nullptr;
+  }
+  auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return nullptr;
+  }
+  auto data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return nullptr;
+  }
+  auto mappedFile = std::unique_ptr<MappedFile>(new MappedFile());
+  mappedFile->_data = static_cast<uint8_t*>(data);
+  mappedFile->_size = static_cast<size_t>(fileSize.QuadPart);
+  mappedFile->fileHandle = file;
+  mappedFile->mappingHandle = mapping;
+  return mappedFile;
+}
+
+std::unique_ptr<MappedFile> MappedFile::MakeWritable(const std::string& path, size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  auto file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                          CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+  auto fileSize = static_cast<uint64_t>(size);
+  // The mapping extends the file to its size.
+  auto mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(fileSize >> 32),
+                         static_cast<DWORD>(fileSize & 0xFFFFFFFF), nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return nullptr;
+  }
+  auto data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return nullptr;
+  }
+  auto mappedFile = std::unique_ptr<MappedFile>(new MappedFile());
+  mappedFile->_data = static_cast<uint8_t*>(data);
+  mappedFile->_size = size;
+  mappedFile->writable = true;
+  mappedFile->fileHandle = file;
+  mappedFile->mappingHandle = mapping;
+  return mappedFile;
+}
+
+MappedFile::~MappedFile() {
+  if (_data != nullptr) {
+    UnmapViewOfFile(_data);
+  }
+  if (mappingHandle != nullptr) {
+    CloseHandle(mappingHandle);
+  }
+  if (fileHandle != nullptr) {
+    CloseHandle(fileHandle);
+  }
+}
+
+#else
+
+std::unique_ptr<MappedFile> MappedFile::Make(const std::string& path) {
+  auto fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat fileStat = {};
+  if (fstat(fd, &fileStat) != 0 || fileStat.st_size <= 0) {
+    close(fd);
+    return nullptr;
+  }
+  auto size = static_cast<size_t>(fileStat.st_size);
+  auto data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  auto mappedFile = std::unique_ptr<MappedFile>(new MappedFile());
+  mappedFile->_data = static_cast<uint8_t*>(data);
+  mappedFile->_size = size;
+  return mappedFile;
+}
+
+std::unique_ptr<MappedFile> MappedFile::MakeWritable(const std::string& path, size_t size) {
+  if (size == 0) {
+    return nullptr;
+  }
+  auto fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return nullptr;
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    close(fd);
+    return nullptr;
+  }
+  auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  auto mappedFile = std::unique_ptr<MappedFile>(new MappedFile());
+  mappedFile->_data = static_cast<uint8_t*>(data);
+  mappedFile->_size = size;
+  mappedFile->writable = true;
+  return mappedFile;
+}
+
+MappedFile::~MappedFile() {
+  if (_data != nullptr) {
+    munmap(_data, _size);
+  }
+}
+
+#endif
+}  // namespace ffmovie
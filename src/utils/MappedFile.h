@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace ffmovie {
+/**
+ * A memory mapping of a whole file. Pages are loaded by the OS on first access, so opening a large
+ * file costs nothing until its data is read.
+ */
+class MappedFile {
+ public:
+  /**
+   * Maps the file at the path, returns nullptr if it does not exist or is empty.
+   */
+  static std::unique_ptr<MappedFile> Make(const std::string& path);
+
+  /**
+   * Creates or truncates the file at the path to size bytes and maps it for writing, the written
+   * data is flushed to the file by the OS. Returns nullptr if size is 0 or the file can not be
+   * created.
+   */
+  static std::unique_ptr<MappedFile> MakeWritable(const std::string& path, size_t size);
+
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  const uint8_t* data() const {
+    return _data;
+  }
+
+  /**
+   * Returns nullptr if the file was not mapped by MakeWritable().
+   */
+  uint8_t* writableData() const {
+    return writable ? _data : nullptr;
+  }
+
+  size_t size() const {
+    return _size;
+  }
+
+ private:
+  uint8_t* _data = nullptr;
+  size_t _size = 0;
+  bool writable = false;
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mappingHandle = nullptr;
+#endif
+
+  MappedFile() = default;
+};
+}  // namespace ffmovie
@@ -91,12 +91,13 @@ void FFAVCDecoder::closeDecoder() {
   }
 }
 
-pag::DecoderResult FFAVCDecoder::onSendBytes(void* bytes, size_t length, int64_t) {
+pag::DecoderResult FFAVCDecoder::onSendBytes(void* bytes, size_t length, int64_t timestamp) {
   if (context == nullptr) {
     return pag::DecoderResult::Error;
   }
   packet->data = static_cast<uint8_t*>(bytes);
   packet->size = static_cast<int>(length);
+  packet->pts = timestamp;
   auto result = avcodec_send_packet(context, packet);
   if (result >= 0 || result == AVERROR_EOF) {
     return pag::DecoderResult::Success;
@@ -135,6 +136,13 @@ std::unique_ptr<pag::YUVBuffer> FFAVCDecoder::onRenderFrame() {
   return buffer;
 }
 
+int64_t FFAVCDecoder::currentPresentationTime() const {
+  if (frame == nullptr) {
+    return -1;
+  }
+  return frame->pts;
+}
+
 void* DecoderFactory::GetHandle() {
   static auto factory = FFAVCDecoderFactory();
   return &factory;
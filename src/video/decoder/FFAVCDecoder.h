@@ -48,6 +48,11 @@ class FFAVCDecoder : public pag::SoftwareDecoder {
 
   std::unique_ptr<pag::YUVBuffer> onRenderFrame() override;
 
+  /**
+   * Returns the timestamp passed to onSendBytes() for the frame that was last decoded.
+   */
+  int64_t currentPresentationTime() const;
+
  private:
   const AVCodec* codec = nullptr;
   AVCodecContext* context = nullptr;
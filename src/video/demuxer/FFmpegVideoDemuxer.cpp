@@ -20,6 +20,7 @@
 #include <list>
 #include "h264_sps_parser.h"
 #include "hevc_vps_parser.h"
+#include "utils/Executor.h"
 #include "utils/FFmpegUtils.h"
 
 namespace ffmovie {
@@ -121,16 +122,35 @@ int PTSDetail::findFrameIndex(int64_t targetTime) const {
                       [this, targetTime](int mid) { return ptsVector[mid] <= targetTime; });
 }
 
-std::unique_ptr<FFVideoDemuxer> FFVideoDemuxer::Make(const std::string& path,
-                                                     NALUType startCodeType) {
+std::unique_ptr<FFVideoDemuxer> FFmpegVideoDemuxer::Make(const std::string& path,
+                                                         NALUType startCodeType,
+                                                         CancelToken* cancelToken) {
+  if (cancelToken != nullptr && cancelToken->isCancelled()) {
+    return nullptr;
+  }
   auto demuxer = std::unique_ptr<FFmpegVideoDemuxer>(new FFmpegVideoDemuxer());
-  if (!demuxer->open(path)) {
+  if (!demuxer->open(path, cancelToken)) {
+    return nullptr;
+  }
+  if (cancelToken != nullptr && cancelToken->isCancelled()) {
     return nullptr;
   }
   demuxer->naluStartCodeType = startCodeType;
   return demuxer;
 }
 
+std::unique_ptr<FFVideoDemuxer> FFVideoDemuxer::Make(const std::string& path,
+                                                     NALUType startCodeType) {
+  return FFmpegVideoDemuxer::Make(path, startCodeType, nullptr);
+}
+
+std::future<std::unique_ptr<FFVideoDemuxer>> FFVideoDemuxer::MakeAsync(
+    const std::string& path, NALUType startCodeType, std::shared_ptr<CancelToken> cancelToken) {
+  return Executor::Shared()->submit([path, startCodeType, cancelToken]() {
+    return FFmpegVideoDemuxer::Make(path, startCodeType, cancelToken.get());
+  });
+}
+
 FFmpegVideoDemuxer::~FFmpegVideoDemuxer() {
   av_packet_unref(&avPacket);
   if (formatContext != nullptr) {
@@ -308,12 +328,20 @@ void FFmpegVideoDemuxer::reset() {
   currentKeyframeIndex = -1;
 }
 
-bool FFmpegVideoDemuxer::open(const std::string& filePath) {
+bool FFmpegVideoDemuxer::open(const std::string& filePath, CancelToken* cancelToken) {
   auto path = static_cast<const char*>(filePath.data());
+  formatContext = avformat_alloc_context();
+  if (formatContext == nullptr) {
+    return false;
+  }
+  formatContext->interrupt_callback = MakeInterruptCallback(cancelToken);
   if (avformat_open_input(&formatContext, path, nullptr, nullptr) < 0) {
     return false;
   }
-  if (avformat_find_stream_info(formatContext, nullptr) < 0) {
+  auto result = avformat_find_stream_info(formatContext, nullptr);
+  // 只在打开过程中响应取消，避免之后的读取被中断
+  formatContext->interrupt_callback = {nullptr, nullptr};
+  if (result < 0) {
     return false;
   }
   auto numStreams = static_cast<int>(formatContext->nb_streams);
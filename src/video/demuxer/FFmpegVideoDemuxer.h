@@ -115,7 +115,22 @@ class FFmpegVideoDemuxer : public FFVideoDemuxer {
 
   FFmpegVideoDemuxer() = default;
 
-  bool open(const std::string& filePath);
+  /**
+   * 打开文件并创建 demuxer，Make() 和 MakeAsync() 共用。打开前后都会检查 cancelToken，被取消时返回
+   * nullptr
+   */
+  static std::unique_ptr<FFVideoDemuxer> Make(const std::string& path, NALUType startCodeType,
+                                              CancelToken* cancelToken);
+
+  /**
+   * 打开文件，cancelToken 被取消时会中断打开过程中阻塞的 I/O
+   */
+  bool open(const std::string& filePath, CancelToken* cancelToken = nullptr);
+
+  /**
+   * 获取按 pts 排序的帧时间表和关键帧位置，首次调用时从索引中创建
+   */
+  PTSDetail* getPTSDetail();
 
  private:
   NALUType naluStartCodeType = NALUType::AVCC;
@@ -129,7 +144,6 @@ class FFmpegVideoDemuxer : public FFVideoDemuxer {
   int64_t sampleTime = INT64_MIN;
   std::unordered_map<int, MediaFormat*> formats;
 
-  PTSDetail* getPTSDetail();
   std::vector<std::shared_ptr<ByteData>> createHeaders(AVStream* avStream);
   friend FFVideoDemuxer;
 };
@@ -0,0 +1,157 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegFrameExtractor.h"
+#include <algorithm>
+#include "utils/Executor.h"
+
+namespace ffmovie {
+std::unique_ptr<FFFrameExtractor> FFFrameExtractor::Make(const std::string& path) {
+  auto reader = VideoFrameReader::Make(path);
+  if (reader == nullptr) {
+    return nullptr;
+  }
+  return std::unique_ptr<FFmpegFrameExtractor>(new FFmpegFrameExtractor(path, std::move(reader)));
+}
+
+std::vector<ExtractGroup> FFmpegFrameExtractor::MakePlan(const PTSDetail* ptsDetail,
+                                                         const std::vector<int64_t>& timestamps,
+                                                         std::vector<int64_t>* invalidTimestamps) {
+  std::vector<std::pair<int64_t, int64_t>> samples = {};
+  samples.reserve(timestamps.size());
+  for (auto timestamp : timestamps) {
+    auto sampleTime = ptsDetail->getSampleTimeAt(timestamp);
+    if (sampleTime == INT64_MIN || sampleTime == INT64_MAX) {
+      invalidTimestamps->push_back(timestamp);
+      continue;
+    }
+    samples.emplace_back(sampleTime, timestamp);
+  }
+  std::sort(samples.begin(), samples.end());
+  std::vector<ExtractGroup> groups = {};
+  auto& ptsVector = ptsDetail->ptsVector;
+  for (auto& sample : samples) {
+    auto keyframeIndex = ptsDetail->findKeyframeIndex(sample.first);
+    if (groups.empty() || groups.back().keyframeIndex != keyframeIndex) {
+      ExtractGroup group = {};
+      group.keyframeIndex = keyframeIndex;
+      groups.push_back(std::move(group));
+    }
+    auto& group = groups.back();
+    if (group.targets.empty() || group.targets.back().sampleTime != sample.first) {
+      ExtractTarget target = {};
+      target.sampleTime = sample.first;
+      group.targets.push_back(std::move(target));
+      auto frameIndex = std::lower_bound(ptsVector.begin(), ptsVector.end(), sample.first) -
+                        ptsVector.begin();
+      group.decodeCount = static_cast<int>(frameIndex) -
+                          ptsDetail->keyframeIndexVector[keyframeIndex] + 1;
+    }
+    group.targets.back().timestamps.push_back(sample.second);
+  }
+  return groups;
+}
+
+bool FFmpegFrameExtractor::extract(const std::vector<int64_t>& timestamps,
+                                   const FrameCallback& callback, int threadCount) {
+  if (callback == nullptr) {
+    return false;
+  }
+  std::vector<int64_t> invalidTimestamps = {};
+  auto groups = MakePlan(reader->ptsDetail(), timestamps, &invalidTimestamps);
+  for (auto timestamp : invalidTimestamps) {
+    ExtractTarget target = {};
+    target.timestamps.push_back(timestamp);
+    emit(callback, target, nullptr);
+  }
+  if (groups.empty()) {
+    return invalidTimestamps.empty();
+  }
+  threadCount = std::max(1, std::min(threadCount, static_cast<int>(groups.size())));
+  if (threadCount == 1) {
+    return extractGroups(reader.get(), groups, 0, groups.size(), callback);
+  }
+  // Splits the groups into contiguous ranges of roughly the same number of frames to decode.
+  int64_t totalCount = 0;
+  for (auto& group : groups) {
+    totalCount += group.decodeCount;
+  }
+  std::vector<size_t> boundaries = {0};
+  int64_t count = 0;
+  for (size_t i = 0; i < groups.size(); i++) {
+    count += groups[i].decodeCount;
+    auto rangeIndex = static_cast<int64_t>(boundaries.size());
+    if (count * threadCount >= totalCount * rangeIndex && rangeIndex < threadCount) {
+      boundaries.push_back(i + 1);
+    }
+  }
+  if (boundaries.back() != groups.size()) {
+    boundaries.push_back(groups.size());
+  }
+  std::vector<std::future<bool>> futures = {};
+  for (size_t i = 1; i + 1 < boundaries.size(); i++) {
+    auto begin = boundaries[i];
+    auto end = boundaries[i + 1];
+    futures.push_back(Executor::Shared()->submit([this, &groups, &callback, begin, end]() {
+      auto frameReader = VideoFrameReader::Make(filePath);
+      if (frameReader == nullptr) {
+        for (auto index = begin; index < end; index++) {
+          for (auto& target : groups[index].targets) {
+            emit(callback, target, nullptr);
+          }
+        }
+        return false;
+      }
+      return extractGroups(frameReader.get(), groups, begin, end, callback);
+    }));
+  }
+  auto success = extractGroups(reader.get(), groups, boundaries[0], boundaries[1], callback);
+  for (auto& future : futures) {
+    success = future.get() && success;
+  }
+  return success;
+}
+
+bool FFmpegFrameExtractor::extractGroups(VideoFrameReader* frameReader,
+                                         const std::vector<ExtractGroup>& groups, size_t begin,
+                                         size_t end, const FrameCallback& callback) {
+  auto success = true;
+  for (auto index = begin; index < end; index++) {
+    auto& group = groups[index];
+    auto decodeSuccess = frameReader->seekToKeyframe(group.keyframeIndex);
+    for (auto& target : group.targets) {
+      std::shared_ptr<VideoFrame> frame = nullptr;
+      decodeSuccess = decodeSuccess && frameReader->decodeUntil(target.sampleTime);
+      if (decodeSuccess) {
+        frame = frameReader->copyCurrentFrame();
+      }
+      emit(callback, target, frame);
+    }
+    success = success && decodeSuccess;
+  }
+  return success;
+}
+
+void FFmpegFrameExtractor::emit(const FrameCallback& callback, const ExtractTarget& target,
+                                const std::shared_ptr<VideoFrame>& frame) {
+  std::lock_guard<std::mutex> autoLock(callbackLocker);
+  for (auto timestamp : target.timestamps) {
+    callback(timestamp, frame);
+  }
+}
+}  // namespace ffmovie
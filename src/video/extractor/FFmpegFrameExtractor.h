@@ -0,0 +1,76 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <mutex>
+#include "ffmovie/movie.h"
+#include "video/reader/VideoFrameReader.h"
+
+namespace ffmovie {
+struct ExtractTarget {
+  /**
+   * The presentation time of the frame to extract.
+   */
+  int64_t sampleTime = 0;
+  /**
+   * All the requested timestamps that are displayed with this frame.
+   */
+  std::vector<int64_t> timestamps = {};
+};
+
+struct ExtractGroup {
+  int keyframeIndex = 0;
+  /**
+   * The number of frames to decode from the keyframe to the last target.
+   */
+  int decodeCount = 0;
+  std::vector<ExtractTarget> targets = {};
+};
+
+class FFmpegFrameExtractor : public FFFrameExtractor {
+ public:
+  /**
+   * Groups the timestamps by the GOP they fall in, sorted by presentation time. Timestamps out of
+   * the video range are returned in invalidTimestamps.
+   */
+  static std::vector<ExtractGroup> MakePlan(const PTSDetail* ptsDetail,
+                                            const std::vector<int64_t>& timestamps,
+                                            std::vector<int64_t>* invalidTimestamps);
+
+  bool extract(const std::vector<int64_t>& timestamps, const FrameCallback& callback,
+               int threadCount) override;
+
+ private:
+  std::string filePath;
+  std::unique_ptr<VideoFrameReader> reader = nullptr;
+  std::mutex callbackLocker = {};
+
+  FFmpegFrameExtractor(std::string filePath, std::unique_ptr<VideoFrameReader> reader)
+      : filePath(std::move(filePath)), reader(std::move(reader)) {
+  }
+
+  bool extractGroups(VideoFrameReader* frameReader, const std::vector<ExtractGroup>& groups,
+                     size_t begin, size_t end, const FrameCallback& callback);
+
+  void emit(const FrameCallback& callback, const ExtractTarget& target,
+            const std::shared_ptr<VideoFrame>& frame);
+
+  friend FFFrameExtractor;
+};
+}  // namespace ffmovie
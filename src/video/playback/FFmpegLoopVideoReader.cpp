@@ -0,0 +1,151 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegLoopVideoReader.h"
+#include <algorithm>
+#include "utils/Executor.h"
+
+namespace ffmovie {
+#define LOOP_FREE_FRAME_COUNT 2
+
+std::unique_ptr<FFLoopVideoReader> FFLoopVideoReader::Make(const std::string& path,
+                                                           size_t maxHeadBytes) {
+  auto reader = VideoFrameReader::Make(path);
+  if (reader == nullptr) {
+    return nullptr;
+  }
+  auto standbyReader = VideoFrameReader::Make(path);
+  if (standbyReader == nullptr) {
+    return nullptr;
+  }
+  return std::unique_ptr<FFmpegLoopVideoReader>(
+      new FFmpegLoopVideoReader(std::move(reader), std::move(standbyReader), maxHeadBytes));
+}
+
+FFmpegLoopVideoReader::FFmpegLoopVideoReader(std::unique_ptr<VideoFrameReader> reader,
+                                             std::unique_ptr<VideoFrameReader> standbyReader,
+                                             size_t maxHeadBytes)
+    : reader(std::move(reader)), standbyReader(std::move(standbyReader)) {
+  auto ptsDetail = this->reader->ptsDetail();
+  auto& ptsVector = ptsDetail->ptsVector;
+  loopDuration = ptsDetail->duration;
+  if (loopDuration <= ptsVector.back()) {
+    // The stream duration is missing, extends the last frame by the interval before it.
+    auto lastInterval = ptsVector.size() > 1 ? ptsVector.back() - ptsVector[ptsVector.size() - 2]
+                                             : static_cast<int64_t>(1);
+    loopDuration = ptsVector.back() + lastInterval;
+  }
+  int gopFirstFrame = 0;
+  int gopLastFrame = 0;
+  this->reader->getGOPRange(0, &gopFirstFrame, &gopLastFrame);
+  auto maxHeadFrames = static_cast<int>(maxHeadBytes / this->reader->frameByteSize());
+  headSegment.firstFrame = gopFirstFrame;
+  headSegment.lastFrame = std::min(gopLastFrame, gopFirstFrame + std::max(maxHeadFrames, 1) - 1);
+  pool = std::make_unique<VideoFramePool>(this->reader->width(), this->reader->height(),
+                                          LOOP_FREE_FRAME_COUNT);
+  schedulePrime();
+}
+
+FFmpegLoopVideoReader::~FFmpegLoopVideoReader() {
+  // The prime task uses standbyReader, pool and headSegment, wait for it before they are released.
+  if (primeTask.valid()) {
+    primeTask.wait();
+  }
+}
+
+std::shared_ptr<VideoFrame> FFmpegLoopVideoReader::readFrameAt(int64_t targetTime) {
+  auto localTime = targetTime % loopDuration;
+  if (localTime < 0) {
+    localTime += loopDuration;
+  }
+  auto frameIndex = reader->frameIndexAt(localTime);
+  if (frameIndex < 0) {
+    return nullptr;
+  }
+  if (frameIndex == lastFrameIndex) {
+    return lastFrame;
+  }
+  if (isHeadReady() && headSegment.contains(frameIndex) &&
+      headSegment.frames[frameIndex - headSegment.firstFrame] != nullptr) {
+    if (isWrapping(frameIndex) && waitStandbyPrimed()) {
+      // Wraps around the loop boundary. The standby reader is positioned right after the head
+      // segment, so it takes over and the previous reader is primed for the next lap.
+      std::swap(reader, standbyReader);
+      standbyPrimed = false;
+      readerAtHead = true;
+      schedulePrime();
+    }
+    setLastFrame(frameIndex, headSegment.frames[frameIndex - headSegment.firstFrame], true);
+    return lastFrame;
+  }
+  std::shared_ptr<VideoFrame> frame = nullptr;
+  readerAtHead = false;
+  if (reader->moveToFrame(frameIndex)) {
+    frame = pool->obtain();
+    if (frame != nullptr && !reader->copyCurrentFrameTo(frame.get())) {
+      frame = nullptr;
+    }
+  }
+  setLastFrame(frameIndex, frame, false);
+  return lastFrame;
+}
+
+bool FFmpegLoopVideoReader::isWrapping(int frameIndex) const {
+  return !readerAtHead && reader->needSeeking(frameIndex);
+}
+
+void FFmpegLoopVideoReader::schedulePrime() {
+  auto frameReader = standbyReader.get();
+  auto segment = headPrepared ? nullptr : &headSegment;
+  auto framePool = pool.get();
+  auto headLastTime = reader->ptsDetail()->ptsVector[headSegment.lastFrame];
+  primeTask = Executor::Shared()->submit([frameReader, segment, framePool, headLastTime]() {
+    if (segment != nullptr) {
+      return frameReader->readFrames(segment->firstFrame, segment->lastFrame, framePool,
+                                     &segment->frames);
+    }
+    return frameReader->seekToKeyframe(0) && frameReader->decodeUntil(headLastTime);
+  });
+}
+
+bool FFmpegLoopVideoReader::isHeadReady() {
+  if (!headPrepared && primeTask.valid() &&
+      primeTask.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    standbyPrimed = primeTask.get();
+    headPrepared = true;
+  }
+  return headPrepared;
+}
+
+bool FFmpegLoopVideoReader::waitStandbyPrimed() {
+  if (primeTask.valid()) {
+    standbyPrimed = primeTask.get();
+  }
+  return standbyPrimed;
+}
+
+void FFmpegLoopVideoReader::setLastFrame(int frameIndex, std::shared_ptr<VideoFrame> frame,
+                                         bool fromHead) {
+  if (!lastFrameFromHead) {
+    pool->recycle(std::move(lastFrame));
+  }
+  lastFrameIndex = frame != nullptr ? frameIndex : -1;
+  lastFrame = std::move(frame);
+  lastFrameFromHead = fromHead;
+}
+}  // namespace ffmovie
@@ -0,0 +1,84 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <future>
+#include "ffmovie/movie.h"
+#include "video/reader/VideoFrameReader.h"
+
+namespace ffmovie {
+class FFmpegLoopVideoReader : public FFLoopVideoReader {
+ public:
+  ~FFmpegLoopVideoReader() override;
+
+  int64_t duration() const override {
+    return loopDuration;
+  }
+
+  std::shared_ptr<VideoFrame> readFrameAt(int64_t targetTime) override;
+
+ private:
+  std::unique_ptr<VideoFrameReader> reader = nullptr;
+  std::unique_ptr<VideoFrameReader> standbyReader = nullptr;
+  std::unique_ptr<VideoFramePool> pool = nullptr;
+  int64_t loopDuration = 0;
+  /**
+   * The frames kept from the start of the video, decoded once by the standby reader.
+   */
+  FrameSegment headSegment = {};
+  /**
+   * Positions the standby reader right after the head segment on a background thread.
+   */
+  std::future<bool> primeTask = {};
+  bool headPrepared = false;
+  bool standbyPrimed = false;
+  /**
+   * True while the active reader is the standby reader that took over at the last wrap and has
+   * not decoded past the head segment yet. The rest of the head is then served from headSegment.
+   */
+  bool readerAtHead = false;
+  int lastFrameIndex = -1;
+  std::shared_ptr<VideoFrame> lastFrame = nullptr;
+  bool lastFrameFromHead = false;
+
+  FFmpegLoopVideoReader(std::unique_ptr<VideoFrameReader> reader,
+                        std::unique_ptr<VideoFrameReader> standbyReader, size_t maxHeadBytes);
+
+  /**
+   * Returns true if reading the head frame at frameIndex wraps around the loop boundary, that is,
+   * the active reader has left the head segment and can not reach frameIndex by decoding forward.
+   * The wrap is served by the head segment and the standby reader instead of a seek.
+   */
+  bool isWrapping(int frameIndex) const;
+
+  /**
+   * Decodes the head segment with the standby reader the first time, and positions the standby
+   * reader right after it again afterwards.
+   */
+  void schedulePrime();
+
+  bool isHeadReady();
+
+  bool waitStandbyPrimed();
+
+  void setLastFrame(int frameIndex, std::shared_ptr<VideoFrame> frame, bool fromHead);
+
+  friend FFLoopVideoReader;
+};
+}  // namespace ffmovie
@@ -0,0 +1,136 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegReverseVideoReader.h"
+#include <algorithm>
+#include "utils/Executor.h"
+
+namespace ffmovie {
+std::unique_ptr<FFReverseVideoReader> FFReverseVideoReader::Make(const std::string& path,
+                                                                 size_t maxCacheBytes) {
+  auto reader = VideoFrameReader::Make(path);
+  if (reader == nullptr) {
+    return nullptr;
+  }
+  return std::unique_ptr<FFmpegReverseVideoReader>(
+      new FFmpegReverseVideoReader(path, std::move(reader), maxCacheBytes));
+}
+
+FFmpegReverseVideoReader::FFmpegReverseVideoReader(std::string filePath,
+                                                   std::unique_ptr<VideoFrameReader> reader,
+                                                   size_t maxCacheBytes)
+    : filePath(std::move(filePath)), reader(std::move(reader)) {
+  // The cap is shared by the current segment and the prefetched one.
+  auto frameByteSize = this->reader->frameByteSize();
+  maxSegmentFrames = std::max(1, static_cast<int>(maxCacheBytes / frameByteSize / 2));
+  pool = std::make_unique<VideoFramePool>(this->reader->width(), this->reader->height(),
+                                          static_cast<size_t>(maxSegmentFrames) * 2);
+}
+
+FFmpegReverseVideoReader::~FFmpegReverseVideoReader() {
+  // The prefetch task uses prefetchReader and pool, wait for it before they are released.
+  if (prefetchTask.valid()) {
+    prefetchCancelled = true;
+    prefetchTask.wait();
+  }
+}
+
+std::shared_ptr<VideoFrame> FFmpegReverseVideoReader::readFrameAt(int64_t targetTime) {
+  auto frameIndex = reader->frameIndexAt(targetTime);
+  if (frameIndex < 0) {
+    return nullptr;
+  }
+  if (currentSegment == nullptr || !currentSegment->contains(frameIndex)) {
+    auto segment = takePrefetchedSegment(frameIndex);
+    if (segment == nullptr) {
+      segment = decodeSegment(reader.get(), frameIndex, nullptr);
+    }
+    recycleSegment(std::move(currentSegment));
+    currentSegment = std::move(segment);
+    // Backward playback moves to the segment right before the current one next.
+    schedulePrefetch(currentSegment->firstFrame - 1);
+  }
+  return currentSegment->frames[frameIndex - currentSegment->firstFrame];
+}
+
+void FFmpegReverseVideoReader::getSegmentRange(int frameIndex, int* firstFrame,
+                                               int* lastFrame) const {
+  auto ptsDetail = reader->ptsDetail();
+  auto keyframeIndex = ptsDetail->findKeyframeIndex(ptsDetail->ptsVector[frameIndex]);
+  int gopFirstFrame = 0;
+  int gopLastFrame = 0;
+  reader->getGOPRange(keyframeIndex, &gopFirstFrame, &gopLastFrame);
+  *firstFrame =
+      gopFirstFrame + (frameIndex - gopFirstFrame) / maxSegmentFrames * maxSegmentFrames;
+  *lastFrame = std::min(*firstFrame + maxSegmentFrames - 1, gopLastFrame);
+}
+
+std::shared_ptr<FrameSegment> FFmpegReverseVideoReader::decodeSegment(
+    VideoFrameReader* frameReader, int frameIndex, const std::atomic<bool>* cancelled) {
+  auto segment = std::make_shared<FrameSegment>();
+  getSegmentRange(frameIndex, &segment->firstFrame, &segment->lastFrame);
+  frameReader->readFrames(segment->firstFrame, segment->lastFrame, pool.get(), &segment->frames,
+                          cancelled);
+  return segment;
+}
+
+std::shared_ptr<FrameSegment> FFmpegReverseVideoReader::takePrefetchedSegment(int frameIndex) {
+  if (!prefetchTask.valid()) {
+    return nullptr;
+  }
+  auto wanted = prefetchFirstFrame <= frameIndex && frameIndex <= prefetchLastFrame;
+  if (!wanted) {
+    prefetchCancelled = true;
+  }
+  // Waits for the prefetch task even if it is not needed, since it still uses the pool.
+  auto segment = prefetchTask.get();
+  if (wanted && segment != nullptr) {
+    return segment;
+  }
+  recycleSegment(std::move(segment));
+  return nullptr;
+}
+
+void FFmpegReverseVideoReader::schedulePrefetch(int frameIndex) {
+  if (frameIndex < 0) {
+    return;
+  }
+  getSegmentRange(frameIndex, &prefetchFirstFrame, &prefetchLastFrame);
+  prefetchCancelled = false;
+  // The prefetch reader is opened by the first task, opening a file blocks for the probing. Only
+  // one task runs at a time, so it is never opened twice.
+  prefetchTask = Executor::Shared()->submit([this, frameIndex]() -> std::shared_ptr<FrameSegment> {
+    if (prefetchReader == nullptr) {
+      prefetchReader = VideoFrameReader::Make(filePath);
+      if (prefetchReader == nullptr) {
+        return nullptr;
+      }
+    }
+    return decodeSegment(prefetchReader.get(), frameIndex, &prefetchCancelled);
+  });
+}
+
+void FFmpegReverseVideoReader::recycleSegment(std::shared_ptr<FrameSegment> segment) {
+  if (segment == nullptr) {
+    return;
+  }
+  for (auto& frame : segment->frames) {
+    pool->recycle(std::move(frame));
+  }
+}
+}  // namespace ffmovie
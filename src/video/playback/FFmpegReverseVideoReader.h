@@ -0,0 +1,70 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <future>
+#include "ffmovie/movie.h"
+#include "video/reader/VideoFrameReader.h"
+
+namespace ffmovie {
+class FFmpegReverseVideoReader : public FFReverseVideoReader {
+ public:
+  ~FFmpegReverseVideoReader() override;
+
+  std::shared_ptr<VideoFrame> readFrameAt(int64_t targetTime) override;
+
+ private:
+  std::string filePath;
+  std::unique_ptr<VideoFrameReader> reader = nullptr;
+  std::unique_ptr<VideoFrameReader> prefetchReader = nullptr;
+  std::unique_ptr<VideoFramePool> pool = nullptr;
+  int maxSegmentFrames = 1;
+  std::shared_ptr<FrameSegment> currentSegment = nullptr;
+  // The range of the segment the prefetch task decodes.
+  int prefetchFirstFrame = 0;
+  int prefetchLastFrame = -1;
+  std::future<std::shared_ptr<FrameSegment>> prefetchTask = {};
+  std::atomic<bool> prefetchCancelled{false};
+
+  FFmpegReverseVideoReader(std::string filePath, std::unique_ptr<VideoFrameReader> reader,
+                           size_t maxCacheBytes);
+
+  /**
+   * Returns the segment of the GOP containing frameIndex. Segments are counted from the keyframe,
+   * so decoding any of them only needs the frames before it in the same GOP.
+   */
+  void getSegmentRange(int frameIndex, int* firstFrame, int* lastFrame) const;
+
+  std::shared_ptr<FrameSegment> decodeSegment(VideoFrameReader* frameReader, int frameIndex,
+                                              const std::atomic<bool>* cancelled);
+
+  /**
+   * Returns the prefetched segment if it contains frameIndex, otherwise cancels the prefetch task
+   * before waiting for it, so a jump elsewhere does not wait out the decoding of an unused GOP.
+   */
+  std::shared_ptr<FrameSegment> takePrefetchedSegment(int frameIndex);
+
+  void schedulePrefetch(int frameIndex);
+
+  void recycleSegment(std::shared_ptr<FrameSegment> segment);
+
+  friend FFReverseVideoReader;
+};
+}  // namespace ffmovie
@@ -0,0 +1,265 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegTimeRemapVideoReader.h"
+#include <algorithm>
+#include "utils/Executor.h"
+
+namespace ffmovie {
+std::unique_ptr<FFTimeRemapVideoReader> FFTimeRemapVideoReader::Make(const std::string& path,
+                                                                     int maxCacheFrames,
+                                                                     size_t maxCacheBytes) {
+  auto reader = VideoFrameReader::Make(path);
+  if (reader == nullptr) {
+    return nullptr;
+  }
+  return std::unique_ptr<FFmpegTimeRemapVideoReader>(
+      new FFmpegTimeRemapVideoReader(path, std::move(reader), maxCacheFrames, maxCacheBytes));
+}
+
+FFmpegTimeRemapVideoReader::FFmpegTimeRemapVideoReader(std::string filePath,
+                                                       std::unique_ptr<VideoFrameReader> reader,
+                                                       int maxCacheFrames, size_t maxCacheBytes)
+    : filePath(std::move(filePath)), reader(std::move(reader)) {
+  auto framesInBytes = maxCacheBytes / this->reader->frameByteSize();
+  this->maxCacheFrames =
+      std::max(std::min(static_cast<size_t>(std::max(maxCacheFrames, 1)), framesInBytes),
+               static_cast<size_t>(1));
+  pool = std::make_unique<VideoFramePool>(this->reader->width(), this->reader->height(),
+                                          this->maxCacheFrames);
+}
+
+FFmpegTimeRemapVideoReader::~FFmpegTimeRemapVideoReader() {
+  // The prefetch task uses prefetchReader, pool and the cache, wait for it before they are
+  // released.
+  stopPrefetch();
+}
+
+void FFmpegTimeRemapVideoReader::setTimeMap(const std::vector<int64_t>& sourceTimes) {
+  stopPrefetch();
+  window.clear();
+  usePositions.clear();
+  for (auto sourceTime : sourceTimes) {
+    auto frameIndex = reader->frameIndexAt(sourceTime);
+    if (frameIndex < 0) {
+      continue;
+    }
+    usePositions[frameIndex].push_back(static_cast<int>(window.size()));
+    window.push_back(frameIndex);
+  }
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    windowPosition = 0;
+    for (auto iter = cache.begin(); iter != cache.end();) {
+      if (nextUseOf(iter->first) == SIZE_MAX) {
+        pool->recycle(std::move(iter->second));
+        iter = cache.erase(iter);
+      } else {
+        iter++;
+      }
+    }
+  }
+  schedulePrefetch();
+}
+
+std::shared_ptr<VideoFrame> FFmpegTimeRemapVideoReader::readFrameAt(int64_t sourceTime) {
+  auto frameIndex = reader->frameIndexAt(sourceTime);
+  if (frameIndex < 0) {
+    return nullptr;
+  }
+  std::shared_ptr<VideoFrame> frame = nullptr;
+  {
+    std::unique_lock<std::mutex> autoLock(locker);
+    auto nextUse = nextUseOf(frameIndex);
+    if (nextUse != SIZE_MAX) {
+      windowPosition = nextUse;
+    }
+    // The frame is about to be prefetched, waiting is cheaper than decoding it twice.
+    condition.wait(autoLock, [this, frameIndex] {
+      return pendingPrefetchFrames.count(frameIndex) == 0 || cache.count(frameIndex) > 0;
+    });
+    auto iter = cache.find(frameIndex);
+    if (iter != cache.end()) {
+      frame = iter->second;
+    }
+  }
+  if (frame == nullptr) {
+    frame = decodeFrame(reader.get(), frameIndex, nullptr);
+    if (frame != nullptr) {
+      cacheFrame(frameIndex, frame);
+    }
+  }
+  schedulePrefetch();
+  return frame;
+}
+
+size_t FFmpegTimeRemapVideoReader::nextUseOf(int frameIndex) const {
+  auto iter = usePositions.find(frameIndex);
+  if (iter == usePositions.end()) {
+    return SIZE_MAX;
+  }
+  auto& positions = iter->second;
+  auto position = std::lower_bound(positions.begin(), positions.end(),
+                                   static_cast<int>(windowPosition));
+  if (position == positions.end()) {
+    return SIZE_MAX;
+  }
+  return static_cast<size_t>(*position);
+}
+
+bool FFmpegTimeRemapVideoReader::shouldCache(int frameIndex) {
+  std::lock_guard<std::mutex> autoLock(locker);
+  auto nextUse = nextUseOf(frameIndex);
+  if (nextUse == SIZE_MAX || cache.count(frameIndex) > 0) {
+    return false;
+  }
+  if (cache.size() < maxCacheFrames) {
+    return true;
+  }
+  for (auto& item : cache) {
+    if (nextUseOf(item.first) > nextUse) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FFmpegTimeRemapVideoReader::cacheFrame(int frameIndex, std::shared_ptr<VideoFrame> frame) {
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    if (cache.count(frameIndex) == 0) {
+      auto nextUse = nextUseOf(frameIndex);
+      if (cache.size() >= maxCacheFrames) {
+        // Evicts the frame requested furthest in the future, which is optimal for a known window.
+        auto victim = cache.end();
+        auto victimNextUse = nextUse;
+        for (auto iter = cache.begin(); iter != cache.end(); iter++) {
+          auto itemNextUse = nextUseOf(iter->first);
+          if (itemNextUse > victimNextUse) {
+            victim = iter;
+            victimNextUse = itemNextUse;
+          }
+        }
+        if (victim != cache.end()) {
+          pool->recycle(std::move(victim->second));
+          cache.erase(victim);
+        }
+      }
+      if (cache.size() < maxCacheFrames) {
+        cache[frameIndex] = frame;
+        frame = nullptr;
+      }
+    }
+  }
+  pool->recycle(std::move(frame));
+}
+
+std::shared_ptr<VideoFrame> FFmpegTimeRemapVideoReader::decodeFrame(
+    VideoFrameReader* frameReader, int frameIndex, const std::atomic<bool>* cancelled) {
+  auto ptsDetail = frameReader->ptsDetail();
+  auto targetTime = ptsDetail->ptsVector[frameIndex];
+  if (frameReader->needSeeking(frameIndex) &&
+      !frameReader->seekToKeyframe(ptsDetail->findKeyframeIndex(targetTime))) {
+    return nullptr;
+  }
+  while (frameReader->currentFrameTime() < targetTime) {
+    if ((cancelled != nullptr && *cancelled) || !frameReader->decodeNextFrame()) {
+      return nullptr;
+    }
+    auto currentFrame = frameReader->frameIndexAt(frameReader->currentFrameTime());
+    if (currentFrame >= 0 && currentFrame != frameIndex && shouldCache(currentFrame)) {
+      auto frame = pool->obtain();
+      if (frame != nullptr && frameReader->copyCurrentFrameTo(frame.get())) {
+        cacheFrame(currentFrame, std::move(frame));
+      }
+    }
+  }
+  if (frameReader->currentFrameTime() != targetTime) {
+    return nullptr;
+  }
+  auto frame = pool->obtain();
+  if (frame == nullptr || !frameReader->copyCurrentFrameTo(frame.get())) {
+    return nullptr;
+  }
+  return frame;
+}
+
+void FFmpegTimeRemapVideoReader::schedulePrefetch() {
+  if (prefetchTask.valid()) {
+    if (prefetchTask.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      return;
+    }
+    prefetchTask.get();
+  }
+  // Half of the cache is left to the frames that are kept for reuse.
+  auto maxPrefetchFrames = std::max(maxCacheFrames / 2, static_cast<size_t>(1));
+  std::vector<int> frameIndices = {};
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    for (auto position = windowPosition;
+         position < window.size() && frameIndices.size() < maxPrefetchFrames; position++) {
+      auto frameIndex = window[position];
+      if (cache.count(frameIndex) == 0 && pendingPrefetchFrames.count(frameIndex) == 0) {
+        pendingPrefetchFrames.insert(frameIndex);
+        frameIndices.push_back(frameIndex);
+      }
+    }
+  }
+  if (frameIndices.empty()) {
+    return;
+  }
+  if (prefetchReader == nullptr) {
+    prefetchReader = VideoFrameReader::Make(filePath);
+    if (prefetchReader == nullptr) {
+      std::lock_guard<std::mutex> autoLock(locker);
+      pendingPrefetchFrames.clear();
+      return;
+    }
+  }
+  // Frames in presentation order decode every GOP in one forward pass, however the time map
+  // jumps back and forth inside the window.
+  std::sort(frameIndices.begin(), frameIndices.end());
+  prefetchCancelled = false;
+  prefetchTask = Executor::Shared()->submit(
+      [this, frameIndices]() { prefetchFrames(frameIndices); });
+}
+
+void FFmpegTimeRemapVideoReader::prefetchFrames(const std::vector<int>& frameIndices) {
+  for (auto frameIndex : frameIndices) {
+    if (!prefetchCancelled && shouldCache(frameIndex)) {
+      auto frame = decodeFrame(prefetchReader.get(), frameIndex, &prefetchCancelled);
+      if (frame != nullptr) {
+        cacheFrame(frameIndex, std::move(frame));
+      }
+    }
+    {
+      std::lock_guard<std::mutex> autoLock(locker);
+      pendingPrefetchFrames.erase(frameIndex);
+    }
+    condition.notify_all();
+  }
+}
+
+void FFmpegTimeRemapVideoReader::stopPrefetch() {
+  if (!prefetchTask.valid()) {
+    return;
+  }
+  prefetchCancelled = true;
+  prefetchTask.get();
+}
+}  // namespace ffmovie
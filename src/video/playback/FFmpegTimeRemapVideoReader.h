@@ -0,0 +1,93 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <unordered_map>
+#include <unordered_set>
+#include "ffmovie/movie.h"
+#include "video/reader/VideoFrameReader.h"
+
+namespace ffmovie {
+class FFmpegTimeRemapVideoReader : public FFTimeRemapVideoReader {
+ public:
+  ~FFmpegTimeRemapVideoReader() override;
+
+  void setTimeMap(const std::vector<int64_t>& sourceTimes) override;
+
+  std::shared_ptr<VideoFrame> readFrameAt(int64_t sourceTime) override;
+
+ private:
+  std::string filePath;
+  std::unique_ptr<VideoFrameReader> reader = nullptr;
+  std::unique_ptr<VideoFrameReader> prefetchReader = nullptr;
+  std::unique_ptr<VideoFramePool> pool = nullptr;
+  size_t maxCacheFrames = 1;
+  // The frame indices of the time map in request order, and the sorted positions of each frame in
+  // it. Both are only changed while no prefetch task is running.
+  std::vector<int> window = {};
+  std::unordered_map<int, std::vector<int>> usePositions = {};
+
+  std::mutex locker = {};
+  std::condition_variable condition = {};
+  // The position in the window of the latest request.
+  size_t windowPosition = 0;
+  std::unordered_map<int, std::shared_ptr<VideoFrame>> cache = {};
+  std::unordered_set<int> pendingPrefetchFrames = {};
+  std::future<void> prefetchTask = {};
+  std::atomic<bool> prefetchCancelled{false};
+
+  FFmpegTimeRemapVideoReader(std::string filePath, std::unique_ptr<VideoFrameReader> reader,
+                             int maxCacheFrames, size_t maxCacheBytes);
+
+  /**
+   * Returns the position in the window of the next request for frameIndex, counting the latest
+   * request, or SIZE_MAX if the window does not request it anymore. Must be called with the lock.
+   */
+  size_t nextUseOf(int frameIndex) const;
+
+  /**
+   * Returns true if a decoded frame at frameIndex would be kept by the cache.
+   */
+  bool shouldCache(int frameIndex);
+
+  /**
+   * Puts the frame into the cache, evicting the frame used furthest in the future if the cache is
+   * full. The frame itself is dropped if it is the one used furthest.
+   */
+  void cacheFrame(int frameIndex, std::shared_ptr<VideoFrame> frame);
+
+  /**
+   * Decodes forward to the frame at frameIndex, seeking only if frameReader can not reach it from
+   * its current frame. Frames passed on the way are cached if the window requests them later.
+   */
+  std::shared_ptr<VideoFrame> decodeFrame(VideoFrameReader* frameReader, int frameIndex,
+                                          const std::atomic<bool>* cancelled);
+
+  void schedulePrefetch();
+
+  void prefetchFrames(const std::vector<int>& frameIndices);
+
+  void stopPrefetch();
+
+  friend FFTimeRemapVideoReader;
+};
+}  // namespace ffmovie
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "FFmpegVideoSequencePlayer.h"
+#include <algorithm>
+#include "utils/Executor.h"
+
+namespace ffmovie {
+#define CLIP_FREE_FRAME_COUNT 2
+
+std::unique_ptr<ClipReader> ClipReader::Open(int clipIndex, const VideoClip& clip) {
+  auto clipReader = std::unique_ptr<ClipReader>(new ClipReader());
+  clipReader->_clipIndex = clipIndex;
+  clipReader->reader = VideoFrameReader::Make(clip.path);
+  if (clipReader->reader != nullptr) {
+    clipReader->pool = std::make_unique<VideoFramePool>(
+        clipReader->reader->width(), clipReader->reader->height(), CLIP_FREE_FRAME_COUNT);
+    clipReader->readFrameAt(clip.sourceRange.start);
+  }
+  return clipReader;
+}
+
+std::shared_ptr<VideoFrame> ClipReader::readFrameAt(int64_t sourceTime) {
+  if (reader == nullptr) {
+    return nullptr;
+  }
+  auto frameIndex = reader->frameIndexAt(sourceTime);
+  if (frameIndex < 0) {
+    return nullptr;
+  }
+  if (frameIndex == lastFrameIndex) {
+    return lastFrame;
+  }
+  std::shared_ptr<VideoFrame> frame = nullptr;
+  if (reader->moveToFrame(frameIndex)) {
+    frame = pool->obtain();
+    if (frame != nullptr && !reader->copyCurrentFrameTo(frame.get())) {
+      frame = nullptr;
+    }
+  }
+  pool->recycle(std::move(lastFrame));
+  lastFrameIndex = frame != nullptr ? frameIndex : -1;
+  lastFrame = frame;
+  return frame;
+}
+
+std::unique_ptr<FFVideoSequencePlayer> FFVideoSequencePlayer::Make(std::vector<VideoClip> clips,
+                                                                   int64_t leadTime) {
+  for (auto& clip : clips) {
+    if (!clip.sourceRange.isValid() || clip.sourceRange.duration() <= 0) {
+      return nullptr;
+    }
+  }
+  if (clips.empty()) {
+    return nullptr;
+  }
+  return std::unique_ptr<FFmpegVideoSequencePlayer>(
+      new FFmpegVideoSequencePlayer(std::move(clips), leadTime));
+}
+
+FFmpegVideoSequencePlayer::FFmpegVideoSequencePlayer(std::vector<VideoClip> clips,
+                                                     int64_t leadTime)
+    : clips(std::move(clips)), leadTime(std::max(leadTime, static_cast<int64_t>(0))) {
+  for (auto& clip : this->clips) {
+    clipStartTimes.push_back(totalDuration);
+    totalDuration += clip.sourceRange.duration();
+  }
+  // The first clip is prepared in the background right away.
+  schedulePrepare(0);
+}
+
+std::shared_ptr<VideoFrame> FFmpegVideoSequencePlayer::readFrameAt(int64_t timelineTime) {
+  auto clipIndex = findClip(timelineTime);
+  if (clipIndex < 0) {
+    return nullptr;
+  }
+  if (activeClip == nullptr || activeClip->clipIndex() != clipIndex) {
+    activateClip(clipIndex);
+  }
+  auto& clip = clips[clipIndex];
+  auto frame = activeClip->readFrameAt(clip.sourceRange.start + timelineTime -
+                                       clipStartTimes[clipIndex]);
+  auto nextClipIndex = clipIndex + 1;
+  auto cutTime = clipStartTimes[clipIndex] + clip.sourceRange.duration();
+  if (nextClipIndex < static_cast<int>(clips.size()) && timelineTime >= cutTime - leadTime) {
+    schedulePrepare(nextClipIndex);
+  }
+  return frame;
+}
+
+int FFmpegVideoSequencePlayer::findClip(int64_t timelineTime) const {
+  if (timelineTime < 0 || timelineTime >= totalDuration) {
+    return -1;
+  }
+  auto iter = std::upper_bound(clipStartTimes.begin(), clipStartTimes.end(), timelineTime);
+  return static_cast<int>(iter - clipStartTimes.begin()) - 1;
+}
+
+void FFmpegVideoSequencePlayer::activateClip(int clipIndex) {
+  activeClip = nullptr;
+  if (preparingClipIndex == clipIndex && prepareTask.valid()) {
+    activeClip = prepareTask.get();
+    preparingClipIndex = -1;
+  }
+  if (activeClip == nullptr) {
+    activeClip = ClipReader::Open(clipIndex, clips[clipIndex]);
+  }
+}
+
+void FFmpegVideoSequencePlayer::schedulePrepare(int clipIndex) {
+  if (preparingClipIndex == clipIndex) {
+    return;
+  }
+  // A pending task of another clip owns everything it uses, so it is simply abandoned.
+  preparingClipIndex = clipIndex;
+  auto clip = clips[clipIndex];
+  prepareTask = Executor::Shared()->submit(
+      [clipIndex, clip]() { return ClipReader::Open(clipIndex, clip); });
+}
+}  // namespace ffmovie
@@ -0,0 +1,79 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <future>
+#include "ffmovie/movie.h"
+#include "video/reader/VideoFrameReader.h"
+
+namespace ffmovie {
+/**
+ * The reader of one clip and the last frame it returned.
+ */
+class ClipReader {
+ public:
+  /**
+   * Opens the clip and decodes the frame at its in point.
+   */
+  static std::unique_ptr<ClipReader> Open(int clipIndex, const VideoClip& clip);
+
+  int clipIndex() const {
+    return _clipIndex;
+  }
+
+  std::shared_ptr<VideoFrame> readFrameAt(int64_t sourceTime);
+
+ private:
+  int _clipIndex = -1;
+  std::unique_ptr<VideoFrameReader> reader = nullptr;
+  std::unique_ptr<VideoFramePool> pool = nullptr;
+  int lastFrameIndex = -1;
+  std::shared_ptr<VideoFrame> lastFrame = nullptr;
+
+  ClipReader() = default;
+};
+
+class FFmpegVideoSequencePlayer : public FFVideoSequencePlayer {
+ public:
+  int64_t duration() const override {
+    return totalDuration;
+  }
+
+  std::shared_ptr<VideoFrame> readFrameAt(int64_t timelineTime) override;
+
+ private:
+  std::vector<VideoClip> clips = {};
+  std::vector<int64_t> clipStartTimes = {};
+  int64_t totalDuration = 0;
+  int64_t leadTime = 0;
+  std::unique_ptr<ClipReader> activeClip = nullptr;
+  int preparingClipIndex = -1;
+  std::future<std::unique_ptr<ClipReader>> prepareTask = {};
+
+  FFmpegVideoSequencePlayer(std::vector<VideoClip> clips, int64_t leadTime);
+
+  int findClip(int64_t timelineTime) const;
+
+  void activateClip(int clipIndex);
+
+  void schedulePrepare(int clipIndex);
+
+  friend FFVideoSequencePlayer;
+};
+}  // namespace ffmovie
@@ -0,0 +1,45 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "VideoFramePool.h"
+
+namespace ffmovie {
+std::shared_ptr<VideoFrame> VideoFramePool::obtain() {
+  {
+    std::lock_guard<std::mutex> autoLock(locker);
+    for (auto iter = freeFrames.begin(); iter != freeFrames.end(); ++iter) {
+      if (iter->use_count() == 1) {
+        auto frame = std::move(*iter);
+        freeFrames.erase(iter);
+        return frame;
+      }
+    }
+  }
+  return VideoFrame::Make(width, height);
+}
+
+void VideoFramePool::recycle(std::shared_ptr<VideoFrame> frame) {
+  if (frame == nullptr || frame->width != width || frame->height != height) {
+    return;
+  }
+  std::lock_guard<std::mutex> autoLock(locker);
+  if (freeFrames.size() < maxFreeFrames) {
+    freeFrames.push_back(std::move(frame));
+  }
+}
+}  // namespace ffmovie
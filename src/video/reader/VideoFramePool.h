@@ -0,0 +1,53 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <mutex>
+#include "ffmovie/movie.h"
+
+namespace ffmovie {
+
+/**
+ * VideoFramePool recycles VideoFrames of one size, so frame caches do not allocate per frame. A
+ * recycled frame is only handed out again once no one outside the pool holds it anymore.
+ */
+class VideoFramePool {
+ public:
+  VideoFramePool(int width, int height, size_t maxFreeFrames)
+      : width(width), height(height), maxFreeFrames(maxFreeFrames) {
+  }
+
+  /**
+   * Returns a frame that is not referenced anywhere else, or creates a new one.
+   */
+  std::shared_ptr<VideoFrame> obtain();
+
+  /**
+   * Returns the frame to the pool. The frame is dropped if the pool is full.
+   */
+  void recycle(std::shared_ptr<VideoFrame> frame);
+
+ private:
+  int width = 0;
+  int height = 0;
+  size_t maxFreeFrames = 0;
+  std::mutex locker = {};
+  std::vector<std::shared_ptr<VideoFrame>> freeFrames = {};
+};
+}  // namespace ffmovie
@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "VideoFrameReader.h"
+#include <algorithm>
+
+namespace ffmovie {
+std::unique_ptr<VideoFrameReader> VideoFrameReader::Make(const std::string& filePath) {
+  auto reader = std::unique_ptr<VideoFrameReader>(new VideoFrameReader());
+  if (!reader->open(filePath)) {
+    return nullptr;
+  }
+  return reader;
+}
+
+bool VideoFrameReader::open(const std::string& filePath) {
+  // FFAVCDecoder only accepts annex-b samples.
+  demuxerHolder = FFVideoDemuxer::Make(filePath, NALUType::AnnexB);
+  if (demuxerHolder == nullptr) {
+    return false;
+  }
+  demuxer = static_cast<FFmpegVideoDemuxer*>(demuxerHolder.get());
+  auto trackIndex = demuxer->getCurrentTrackIndex();
+  auto format = demuxer->getTrackFormat(trackIndex);
+  if (format == nullptr) {
+    return false;
+  }
+  _ptsDetail = demuxer->getPTSDetail();
+  if (_ptsDetail->ptsVector.empty() || _ptsDetail->keyframeIndexVector.empty()) {
+    return false;
+  }
+  _width = format->getInteger(KEY_WIDTH);
+  _height = format->getInteger(KEY_HEIGHT);
+  std::vector<pag::HeaderData> headers = {};
+  for (auto& header : format->headers()) {
+    headers.push_back({header->data(), header->length()});
+  }
+  if (!decoder.onConfigure(headers, format->getString(KEY_MIME), _width, _height)) {
+    return false;
+  }
+  // Reading the track format consumes the first sample, so the reader always starts from a seek.
+  return seekToKeyframe(0);
+}
+
+size_t VideoFrameReader::frameByteSize() const {
+  auto chromaSize = static_cast<size_t>((_width + 1) / 2) * ((_height + 1) / 2);
+  return static_cast<size_t>(_width) * _height + chromaSize * 2;
+}
+
+int VideoFrameReader::frameIndexAt(int64_t targetTime) const {
+  auto sampleTime = _ptsDetail->getSampleTimeAt(targetTime);
+  if (sampleTime == INT64_MIN || sampleTime == INT64_MAX) {
+    return -1;
+  }
+  auto& ptsVector = _ptsDetail->ptsVector;
+  return static_cast<int>(std::lower_bound(ptsVector.begin(), ptsVector.end(), sampleTime) -
+                          ptsVector.begin());
+}
+
+void VideoFrameReader::getGOPRange(int keyframeIndex, int* firstFrame, int* lastFrame) const {
+  auto& keyframeIndexVector = _ptsDetail->keyframeIndexVector;
+  *firstFrame = keyframeIndexVector[keyframeIndex];
+  if (keyframeIndex + 1 < static_cast<int>(keyframeIndexVector.size())) {
+    *lastFrame = keyframeIndexVector[keyframeIndex + 1] - 1;
+  } else {
+    *lastFrame = static_cast<int>(_ptsDetail->ptsVector.size()) - 1;
+  }
+}
+
+bool VideoFrameReader::needSeeking(int frameIndex) const {
+  auto targetTime = _ptsDetail->ptsVector[frameIndex];
+  if (frameTime == INT64_MIN || targetTime < frameTime) {
+    return true;
+  }
+  // Decoding into the next GOP is what continuous playback does at every GOP boundary.
+  auto targetKeyframeIndex = _ptsDetail->findKeyframeIndex(targetTime);
+  return targetKeyframeIndex > currentKeyframeIndex() + 1;
+}
+
+bool VideoFrameReader::moveToFrame(int frameIndex) {
+  auto targetTime = _ptsDetail->ptsVector[frameIndex];
+  if (needSeeking(frameIndex) &&
+      !seekToKeyframe(_ptsDetail->findKeyframeIndex(targetTime))) {
+    return false;
+  }
+  return decodeUntil(targetTime);
+}
+
+bool VideoFrameReader::seekToKeyframe(int keyframeIndex) {
+  auto keyframeTime = _ptsDetail->getKeyframeTime(keyframeIndex);
+  if (keyframeTime == INT64_MIN || keyframeTime == INT64_MAX) {
+    return false;
+  }
+  if (!demuxer->seekTo(keyframeTime)) {
+    return false;
+  }
+  demuxer->reset();
+  decoder.onFlush();
+  inputEnded = false;
+  hasPendingSample = false;
+  frameTime = INT64_MIN;
+  return true;
+}
+
+bool VideoFrameReader::sendNextSample() {
+  if (!hasPendingSample) {
+    if (!demuxer->advance()) {
+      decoder.onEndOfStream();
+      inputEnded = true;
+      return true;
+    }
+    hasPendingSample = true;
+  }
+  auto sample = demuxer->readSampleData();
+  auto result = decoder.onSendBytes(sample.data, sample.length, demuxer->getSampleTime());
+  if (result == pag::DecoderResult::TryAgainLater) {
+    // The decoder has frames to output first, resend the same sample next time.
+    return true;
+  }
+  hasPendingSample = false;
+  return result == pag::DecoderResult::Success;
+}
+
+bool VideoFrameReader::decodeNextFrame() {
+  while (true) {
+    auto result = decoder.onDecodeFrame();
+    if (result == pag::DecoderResult::Success) {
+      frameTime = decoder.currentPresentationTime();
+      return true;
+    }
+    if (result == pag::DecoderResult::Error || inputEnded) {
+      // All the pending frames are drained after the end of stream.
+      return false;
+    }
+    if (!sendNextSample()) {
+      return false;
+    }
+  }
+}
+
+bool VideoFrameReader::decodeUntil(int64_t sampleTime) {
+  while (frameTime == INT64_MIN || frameTime < sampleTime) {
+    if (!decodeNextFrame()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int VideoFrameReader::currentKeyframeIndex() const {
+  if (frameTime == INT64_MIN) {
+    return -1;
+  }
+  return _ptsDetail->findKeyframeIndex(frameTime);
+}
+
+bool VideoFrameReader::readFrames(int firstFrame, int lastFrame, VideoFramePool* pool,
+                                  std::vector<std::shared_ptr<VideoFrame>>* frames,
+                                  const std::atomic<bool>* cancelled) {
+  auto& ptsVector = _ptsDetail->ptsVector;
+  frames->assign(lastFrame - firstFrame + 1, nullptr);
+  auto keyframeIndex = _ptsDetail->findKeyframeIndex(ptsVector[firstFrame]);
+  auto positioned = currentKeyframeIndex() == keyframeIndex && frameTime < ptsVector[firstFrame];
+  if (!positioned && !seekToKeyframe(keyframeIndex)) {
+    return false;
+  }
+  auto lastTime = ptsVector[lastFrame];
+  auto count = 0;
+  while ((frameTime == INT64_MIN || frameTime < lastTime) &&
+         (cancelled == nullptr || !*cancelled) && decodeNextFrame()) {
+    auto frameIndex = static_cast<int>(
+        std::lower_bound(ptsVector.begin(), ptsVector.end(), frameTime) - ptsVector.begin());
+    if (frameIndex < firstFrame || frameIndex > lastFrame || ptsVector[frameIndex] != frameTime) {
+      continue;
+    }
+    auto frame = pool->obtain();
+    if (frame != nullptr && copyCurrentFrameTo(frame.get())) {
+      (*frames)[frameIndex - firstFrame] = std::move(frame);
+      count++;
+    }
+  }
+  return count == lastFrame - firstFrame + 1;
+}
+
+std::shared_ptr<VideoFrame> VideoFrameReader::copyCurrentFrame() {
+  auto videoFrame = VideoFrame::Make(_width, _height);
+  if (videoFrame == nullptr || !copyCurrentFrameTo(videoFrame.get())) {
+    return nullptr;
+  }
+  return videoFrame;
+}
+
+bool VideoFrameReader::copyCurrentFrameTo(VideoFrame* videoFrame) {
+  if (frameTime == INT64_MIN || videoFrame == nullptr || videoFrame->width != _width ||
+      videoFrame->height != _height) {
+    return false;
+  }
+  auto yuvBuffer = decoder.onRenderFrame();
+  for (int plane = 0; plane < 3; plane++) {
+    auto planeWidth = plane == 0 ? _width : (_width + 1) / 2;
+    auto planeHeight = plane == 0 ? _height : (_height + 1) / 2;
+    auto src = yuvBuffer->data[plane];
+    auto dst = videoFrame->buffer.data[plane];
+    for (int row = 0; row < planeHeight; row++) {
+      memcpy(dst, src, planeWidth);
+      src += yuvBuffer->lineSize[plane];
+      dst += videoFrame->buffer.lineSize[plane];
+    }
+  }
+  videoFrame->timestamp = frameTime;
+  return true;
+}
+}  // namespace ffmovie
@@ -0,0 +1,158 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  Copyright (c) 2023 Tencent. All rights reserved.
+//
+//  This library is free software; you can redistribute it and/or modify it under the terms of the
+//  GNU Lesser General Public License as published by the Free Software Foundation; either
+//  version 2.1 of the License, or (at your option) any later version.
+//
+//  This library is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+//  without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+//  the GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public License along with this
+//  library; if not, write to the Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+//  Boston, MA  02110-1301  USA
+//
+///////////////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include "ffmovie/movie.h"
+#include "video/decoder/FFAVCDecoder.h"
+#include "video/demuxer/FFmpegVideoDemuxer.h"
+#include "video/reader/VideoFramePool.h"
+
+namespace ffmovie {
+/**
+ * The decoded frames at positions [firstFrame, lastFrame] in PTSDetail::ptsVector.
+ */
+struct FrameSegment {
+  int firstFrame = 0;
+  int lastFrame = -1;
+  std::vector<std::shared_ptr<VideoFrame>> frames = {};
+
+  bool contains(int frameIndex) const {
+    return firstFrame <= frameIndex && frameIndex <= lastFrame;
+  }
+};
+
+/**
+ * VideoFrameReader pairs an FFmpegVideoDemuxer with an FFAVCDecoder and decodes frames forward
+ * from a keyframe. It is the building block of all the frame access strategies that need to plan
+ * seeks with the PTSDetail keyframe table. A reader is not thread-safe, use one reader per thread.
+ */
+class VideoFrameReader {
+ public:
+  static std::unique_ptr<VideoFrameReader> Make(const std::string& filePath);
+
+  int width() const {
+    return _width;
+  }
+
+  int height() const {
+    return _height;
+  }
+
+  /**
+   * Returns the size in bytes of one frame copied by copyCurrentFrame().
+   */
+  size_t frameByteSize() const;
+
+  const PTSDetail* ptsDetail() const {
+    return _ptsDetail;
+  }
+
+  /**
+   * Returns the position in PTSDetail::ptsVector of the frame displayed at targetTime, or -1 if
+   * targetTime is out of the video range.
+   */
+  int frameIndexAt(int64_t targetTime) const;
+
+  /**
+   * Returns the positions in PTSDetail::ptsVector of the first and the last frame of the GOP at
+   * keyframeIndex.
+   */
+  void getGOPRange(int keyframeIndex, int* firstFrame, int* lastFrame) const;
+
+  /**
+   * Returns true if the frame at frameIndex can not be reached by decoding forward from the current
+   * frame, that is, it is before the current frame or more than one GOP ahead of it.
+   */
+  bool needSeeking(int frameIndex) const;
+
+  /**
+   * Seeks only if needSeeking() says so, then decodes until the frame at frameIndex.
+   */
+  bool moveToFrame(int frameIndex);
+
+  /**
+   * Seeks to the keyframe at keyframeIndex in PTSDetail::keyframeIndexVector and flushes all the
+   * pending frames of the decoder.
+   */
+  bool seekToKeyframe(int keyframeIndex);
+
+  /**
+   * Decodes the next frame in presentation order. Returns false if the end of stream is reached or
+   * an error occurs.
+   */
+  bool decodeNextFrame();
+
+  /**
+   * Decodes forward until the current frame is the one at sampleTime or later. Returns false if
+   * the end of stream is reached before that.
+   */
+  bool decodeUntil(int64_t sampleTime);
+
+  /**
+   * Returns the presentation time of the last decoded frame, or INT64_MIN if there is none since
+   * the last seek.
+   */
+  int64_t currentFrameTime() const {
+    return frameTime;
+  }
+
+  /**
+   * Returns the index of the GOP in PTSDetail::keyframeIndexVector that the last decoded frame
+   * belongs to, or -1 if there is none since the last seek.
+   */
+  int currentKeyframeIndex() const;
+
+  /**
+   * Decodes the frames at positions [firstFrame, lastFrame] in PTSDetail::ptsVector, which must
+   * belong to the same GOP, into frames obtained from the pool. Seeking is skipped if the decoder
+   * is already positioned before firstFrame in that GOP. Decoding stops early once cancelled is
+   * set. Frames that could not be decoded are left nullptr, in which case false is returned.
+   */
+  bool readFrames(int firstFrame, int lastFrame, VideoFramePool* pool,
+                  std::vector<std::shared_ptr<VideoFrame>>* frames,
+                  const std::atomic<bool>* cancelled = nullptr);
+
+  /**
+   * Copies the last decoded frame into a new VideoFrame that owns its pixels.
+   */
+  std::shared_ptr<VideoFrame> copyCurrentFrame();
+
+  /**
+   * Copies the last decoded frame into an existing VideoFrame of the same size, so callers that
+   * keep a pool of frames do not allocate per frame. Returns false if the sizes do not match.
+   */
+  bool copyCurrentFrameTo(VideoFrame* videoFrame);
+
+ private:
+  std::unique_ptr<FFVideoDemuxer> demuxerHolder = nullptr;
+  FFmpegVideoDemuxer* demuxer = nullptr;
+  ffavc::FFAVCDecoder decoder = {};
+  const PTSDetail* _ptsDetail = nullptr;
+  int _width = 0;
+  int _height = 0;
+  bool inputEnded = false;
+  bool hasPendingSample = false;
+  int64_t frameTime = INT64_MIN;
+
+  VideoFrameReader() = default;
+  bool open(const std::string& filePath);
+  bool sendNextSample();
+};
+}  // namespace ffmovie